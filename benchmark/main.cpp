@@ -0,0 +1,447 @@
+// huffman_bench: 在固定的语料上测量压缩/解压吞吐量、压缩率与编码表开销, 以 JSON 输出到标准输出。
+// 用法: huffman_bench [--size MiB] [--iterations N] [--threads N] [文件...]
+// 不指定文件时使用内置的确定性语料; 指定文件时只测量这些文件
+// 输出中的 peak_rss_kb 是单个用例执行期间的峰值常驻内存 (Linux 上每个用例前重置 VmHWM), 包含用例开始时已驻留的语料;
+// 无法重置时退回到进程启动以来的峰值, 此时 peak_rss_scope 为 "process"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include "AnsCodec.h"
+#include "HuffmanCompressor.h"
+#include "HuffmanDecompressor.h"
+#include "HuffmanTreeBuilder.h"
+#include "HuffmanContextModel.h"
+#include "LzCodec.h"
+#include "HuffmanFormat.h"
+#include "Histogram.h"
+
+struct Corpus {
+    std::string name;
+    std::vector<unsigned char> data;
+};
+
+struct BenchConfig {
+    std::string name;
+    CompressionOptions options;
+};
+
+struct BenchResult {
+    std::string corpus;
+    std::string config;
+    size_t input_bytes = 0;
+    size_t compressed_bytes = 0;
+    size_t payload_bytes = 0; // 各块哈夫曼位流按字节向上取整后的理论大小
+    double entropy_bits = 0.0;
+    double compress_mb_s = 0.0;
+    double decompress_mb_s = 0.0;
+    long peak_rss_kb = 0;
+    bool peak_rss_per_case = false; // false 表示 peak_rss_kb 是进程启动以来的峰值, 包含此前的用例
+};
+
+// xorshift64*, 保证各平台生成的语料完全一致
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed) {}
+    uint64_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 0x2545F4914F6CDD1DULL;
+    }
+    double uniform() { return static_cast<double>(next() >> 11) / 9007199254740992.0; }
+private:
+    uint64_t state_;
+};
+
+static std::vector<unsigned char> makeText(size_t size) {
+    static const char* const kWords[] = {
+        "the", "of", "and", "to", "in", "a", "is", "that", "for", "it", "as", "was", "with", "be",
+        "by", "on", "not", "he", "this", "are", "or", "his", "from", "at", "which", "but", "have",
+        "an", "had", "they", "you", "were", "their", "one", "all", "we", "can", "her", "has",
+        "there", "been", "if", "more", "when", "will", "would", "who", "so", "no", "huffman",
+        "compression", "symbol", "frequency", "table", "stream", "block", "decoder", "encoder",
+    };
+    const size_t num_words = sizeof(kWords) / sizeof(kWords[0]);
+    Random random(1);
+    std::vector<unsigned char> out;
+    out.reserve(size + 16);
+    size_t words_in_line = 0;
+    while (out.size() < size) {
+        // 近似 Zipf 分布: 排名靠前的单词出现得更频繁
+        size_t rank = static_cast<size_t>(std::pow(random.uniform(), 2.5) * num_words);
+        const char* word = kWords[std::min(rank, num_words - 1)];
+        out.insert(out.end(), word, word + std::strlen(word));
+        if (++words_in_line >= 12 && random.next() % 4 == 0) {
+            out.push_back('.');
+            out.push_back('\n');
+            words_in_line = 0;
+        } else {
+            out.push_back(random.next() % 16 == 0 ? ',' : ' ');
+        }
+    }
+    out.resize(size);
+    return out;
+}
+
+static std::vector<unsigned char> makeRandom(size_t size) {
+    Random random(2);
+    std::vector<unsigned char> out(size);
+    for (size_t i = 0; i < size; ++i) {
+        out[i] = static_cast<unsigned char>(random.next() >> 56);
+    }
+    return out;
+}
+
+// JSON 格式的日志行: 字段名与取值大量重复, 逐字节的哈夫曼编码无法利用
+static std::vector<unsigned char> makeLog(size_t size) {
+    static const char* const kLevels[] = {"INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"};
+    static const char* const kServices[] = {"gateway", "auth", "storage", "scheduler", "billing"};
+    static const char* const kMessages[] = {
+        "request completed", "cache miss", "token refreshed", "retrying upstream call", "connection reset by peer",
+        "block written", "queue is full", "user not found",
+    };
+    Random random(4);
+    std::vector<unsigned char> out;
+    out.reserve(size + 256);
+    uint64_t timestamp = 1700000000000ULL;
+    while (out.size() < size) {
+        timestamp += random.next() % 50;
+        char line[256];
+        int n = std::snprintf(line, sizeof(line),
+                              "{\"ts\":%llu,\"level\":\"%s\",\"service\":\"%s\",\"msg\":\"%s\",\"latency_ms\":%u,\"request_id\":\"%08x\"}\n",
+                              static_cast<unsigned long long>(timestamp), kLevels[random.next() % 6], kServices[random.next() % 5],
+                              kMessages[random.next() % 8], static_cast<unsigned>(random.next() % 2000), static_cast<unsigned>(random.next()));
+        out.insert(out.end(), line, line + n);
+    }
+    out.resize(size);
+    return out;
+}
+
+// 几何分布的字节值: 少数字符占绝大多数, 编码长度跨度很大
+static std::vector<unsigned char> makeSkewed(size_t size) {
+    Random random(3);
+    std::vector<unsigned char> out(size);
+    for (size_t i = 0; i < size; ++i) {
+        int value = 0;
+        while (value < 255 && random.next() % 3 == 0) {
+            value++;
+        }
+        out[i] = static_cast<unsigned char>(value);
+    }
+    return out;
+}
+
+// 稀疏的遥测数据: 绝大多数字节为0, 偶尔是一个小的读数; 哈夫曼编码每个字节至少1位, 远高于熵
+static std::vector<unsigned char> makeSparse(size_t size) {
+    Random random(5);
+    std::vector<unsigned char> out(size);
+    for (size_t i = 0; i < size; ++i) {
+        uint64_t r = random.next();
+        out[i] = (r % 32 == 0) ? static_cast<unsigned char>(1 + (r >> 56) % 16) : 0;
+    }
+    return out;
+}
+
+static std::vector<Corpus> makeCorpora(size_t size) {
+    std::vector<Corpus> corpora;
+    corpora.push_back({"text", makeText(size)});
+    corpora.push_back({"log", makeLog(size)});
+    corpora.push_back({"random", makeRandom(size)});
+    corpora.push_back({"skewed", makeSkewed(size)});
+    corpora.push_back({"sparse", makeSparse(size)});
+    corpora.push_back({"one_symbol", std::vector<unsigned char>(size, 'a')});
+    corpora.push_back({"tiny", makeText(64)});
+    return corpora;
+}
+
+static std::vector<BenchConfig> makeConfigs(unsigned threads) {
+    std::vector<BenchConfig> configs;
+    CompressionOptions legacy;
+    legacy.threads = threads;
+    legacy.quiet = true;
+    configs.push_back({"legacy", legacy});
+
+    CompressionOptions chunked = legacy;
+    chunked.format = ContainerFormat::Chunked;
+    configs.push_back({"chunked", chunked});
+
+    CompressionOptions limited = chunked;
+    limited.max_code_length = 11;
+    configs.push_back({"chunked_maxlen11", limited});
+
+    // 1阶上下文模式, 与上面的0阶分块格式比较压缩率与吞吐
+    CompressionOptions order1 = chunked;
+    order1.context_tables = 16;
+    configs.push_back({"chunked_order1", order1});
+
+    // LZ77 前端的快速与高压缩率两档
+    CompressionOptions lz_fast = chunked;
+    lz_fast.lz_level = 1;
+    configs.push_back({"chunked_lz1", lz_fast});
+    CompressionOptions lz_best = chunked;
+    lz_best.lz_level = 9;
+    configs.push_back({"chunked_lz9", lz_best});
+
+    // tANS 与哈夫曼编码按块择优
+    CompressionOptions ans = chunked;
+    ans.ans_coding = true;
+    configs.push_back({"chunked_ans", ans});
+    return configs;
+}
+
+static double entropyBits(const unsigned char* data, size_t size) {
+    uint64_t counts[256] = {0};
+    countBytes(data, size, counts);
+    double bits = 0.0;
+    for (int c = 0; c < 256; ++c) {
+        if (counts[c] > 0) {
+            double p = static_cast<double>(counts[c]) / static_cast<double>(size);
+            bits -= static_cast<double>(counts[c]) * std::log2(p);
+        }
+    }
+    return bits;
+}
+
+// 按与压缩器相同的分块求各块的最优编码长度, 得到不含头部与编码表的位流大小
+static size_t payloadBytes(const unsigned char* data, size_t size, const CompressionOptions& options) {
+    size_t block_size = options.format == ContainerFormat::Chunked ? options.block_size : size;
+    HuffmanTreeBuilder builder;
+    HuffmanCodeword codewords[256];
+    size_t total = 0;
+    for (size_t pos = 0; pos < size; pos += block_size) {
+        size_t n = std::min(block_size, size - pos);
+        uint64_t counts[256] = {0};
+        countBytes(data + pos, n, counts);
+        size_t num_symbols = builder.buildCodewords(counts, static_cast<int>(options.max_code_length), codewords);
+        uint64_t bits = 0;
+        for (size_t i = 0; i < num_symbols; ++i) {
+            bits += counts[codewords[i].symbol] * codewords[i].length;
+        }
+        // 上下文模式的块取两种编码中较短的一种, 这里忽略交错位流的分段
+        if (options.context_tables > 1 && n >= HuffmanFormat::kMinContextBlockSize) {
+            static HuffmanContextEncoder model;
+            size_t starts[2] = {0, n};
+            bits = std::min(bits, model.build(data + pos, starts, 1, options.context_tables, options.max_code_length));
+        }
+        if (options.ans_coding) {
+            static AnsEncoder ans;
+            bits = std::min(bits, ans.build(counts, n));
+        }
+        // LZ 块计字面量与序列两部分位流
+        if (options.lz_level > 0 && n >= HuffmanFormat::kMinLzBlockSize) {
+            static LzMatchFinder finder;
+            static LzSequenceEncoder sequence_encoder;
+            std::vector<LzSequence> sequences;
+            size_t trailing = finder.parse(data + pos, n, static_cast<int>(options.lz_level), sequences);
+            uint64_t literal_counts[256] = {0};
+            size_t offset = 0;
+            for (const LzSequence& s : sequences) {
+                countBytes(data + pos + offset, s.literals, literal_counts);
+                offset += s.literals + s.match_length;
+            }
+            countBytes(data + pos + offset, trailing, literal_counts);
+            uint64_t lz_bits = sequence_encoder.build(sequences.data(), sequences.size());
+            size_t num_literal_symbols = builder.buildCodewords(literal_counts, static_cast<int>(options.max_code_length), codewords);
+            for (size_t i = 0; i < num_literal_symbols; ++i) {
+                lz_bits += literal_counts[codewords[i].symbol] * codewords[i].length;
+            }
+            bits = std::min(bits, lz_bits);
+        }
+        total += static_cast<size_t>((bits + 7) / 8);
+    }
+    return total;
+}
+
+// 把 VmHWM 重置为当前常驻内存 (写 "5" 到 /proc/self/clear_refs, Linux 4.0 起支持), 失败时返回 false
+static bool resetPeakRss() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+    clear_refs.flush();
+    return static_cast<bool>(clear_refs);
+}
+
+// 上次重置以来的峰值常驻内存 (KB); 没有 /proc/self/status 时退回到 ru_maxrss
+static long peakRssKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::strtol(line.c_str() + 6, nullptr, 10);
+        }
+    }
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return usage.ru_maxrss; // Linux 上单位为 KB
+}
+
+// 重复执行 fn 直到单轮耗时可以可靠测量, 返回每次调用的平均秒数
+template <typename Fn>
+static double timeOnce(size_t input_size, Fn fn) {
+    size_t reps = std::max<size_t>(1, (static_cast<size_t>(1) << 20) / std::max<size_t>(input_size, 1));
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < reps; ++r) {
+        fn();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / static_cast<double>(reps);
+}
+
+static BenchResult runCase(const Corpus& corpus, const BenchConfig& config, int iterations) {
+    const bool peak_rss_per_case = resetPeakRss();
+    const std::vector<unsigned char>& input = corpus.data;
+    HuffmanCompressor compressor(config.options);
+    DecompressionOptions decompression_options;
+    decompression_options.threads = config.options.threads;
+    decompression_options.quiet = true;
+    HuffmanDecompressor decompressor(decompression_options);
+
+    std::vector<unsigned char> compressed(HuffmanCompressor::compressBound(input.size(), config.options));
+    std::vector<unsigned char> restored(input.size());
+    size_t compressed_size = 0;
+
+    double best_compress = 1e30;
+    double best_decompress = 1e30;
+    for (int it = 0; it < iterations; ++it) {
+        best_compress = std::min(best_compress, timeOnce(input.size(), [&]() {
+            compressed_size = compressor.compress(input.data(), input.size(), compressed.data(), compressed.size());
+        }));
+        best_decompress = std::min(best_decompress, timeOnce(input.size(), [&]() {
+            decompressor.decompress(compressed.data(), compressed_size, restored.data(), restored.size());
+        }));
+    }
+    if (restored != input) {
+        throw std::runtime_error("round trip mismatch: " + corpus.name + " / " + config.name);
+    }
+
+    BenchResult result;
+    result.corpus = corpus.name;
+    result.config = config.name;
+    result.input_bytes = input.size();
+    result.compressed_bytes = compressed_size;
+    result.payload_bytes = payloadBytes(input.data(), input.size(), config.options);
+    result.entropy_bits = entropyBits(input.data(), input.size());
+    result.compress_mb_s = static_cast<double>(input.size()) / 1e6 / best_compress;
+    result.decompress_mb_s = static_cast<double>(input.size()) / 1e6 / best_decompress;
+    result.peak_rss_kb = peakRssKb();
+    result.peak_rss_per_case = peak_rss_per_case;
+    return result;
+}
+
+static std::string jsonEscape(const std::string& s) {
+    std::string out;
+    for (char ch : s) {
+        unsigned char c = static_cast<unsigned char>(ch);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += ch;
+        } else if (c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += ch;
+        }
+    }
+    return out;
+}
+
+static void printJson(std::ostream& out, const std::vector<BenchResult>& results, int iterations, unsigned threads) {
+    out << "{\n  \"benchmark\": \"huffman_bench\",\n";
+    out << "  \"iterations\": " << iterations << ",\n";
+    out << "  \"threads\": " << threads << ",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        double ratio = r.input_bytes > 0 ? static_cast<double>(r.compressed_bytes) / static_cast<double>(r.input_bytes) : 0.0;
+        double bits_per_symbol = r.input_bytes > 0 ? 8.0 * static_cast<double>(r.compressed_bytes) / static_cast<double>(r.input_bytes) : 0.0;
+        double entropy_per_symbol = r.input_bytes > 0 ? r.entropy_bits / static_cast<double>(r.input_bytes) : 0.0;
+        long long overhead = static_cast<long long>(r.compressed_bytes) - static_cast<long long>(r.payload_bytes);
+        out << "    {\"corpus\": \"" << jsonEscape(r.corpus) << "\""
+            << ", \"config\": \"" << jsonEscape(r.config) << "\""
+            << ", \"input_bytes\": " << r.input_bytes
+            << ", \"compressed_bytes\": " << r.compressed_bytes
+            << ", \"ratio\": " << ratio
+            << ", \"bits_per_symbol\": " << bits_per_symbol
+            << ", \"entropy_bits_per_symbol\": " << entropy_per_symbol
+            << ", \"table_overhead_bytes\": " << overhead
+            << ", \"compress_mb_s\": " << r.compress_mb_s
+            << ", \"decompress_mb_s\": " << r.decompress_mb_s
+            << ", \"peak_rss_kb\": " << r.peak_rss_kb
+            << ", \"peak_rss_scope\": \"" << (r.peak_rss_per_case ? "case" : "process") << "\"}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+static std::vector<unsigned char> readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+int main(int argc, char** argv) {
+    size_t size_mib = 8;
+    int iterations = 3;
+    unsigned threads = 0;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "--size" || arg == "--iterations" || arg == "--threads") && i + 1 < argc) {
+            long value = std::strtol(argv[++i], nullptr, 10);
+            if (value <= 0 && arg != "--threads") {
+                std::cerr << "invalid value for " << arg << std::endl;
+                return 2;
+            }
+            if (arg == "--size") {
+                size_mib = static_cast<size_t>(value);
+            } else if (arg == "--iterations") {
+                iterations = static_cast<int>(value);
+            } else {
+                threads = static_cast<unsigned>(std::max(0L, value));
+            }
+        } else if (arg == "--help" || arg == "-h") {
+            std::cerr << "usage: huffman_bench [--size MiB] [--iterations N] [--threads N] [file...]" << std::endl;
+            return 0;
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    try {
+        std::vector<Corpus> corpora;
+        if (files.empty()) {
+            corpora = makeCorpora(size_mib << 20);
+        } else {
+            for (const std::string& file : files) {
+                corpora.push_back({file, readFile(file)});
+            }
+        }
+
+        std::vector<BenchResult> results;
+        for (const Corpus& corpus : corpora) {
+            for (const BenchConfig& config : makeConfigs(threads)) {
+                results.push_back(runCase(corpus, config, iterations));
+            }
+        }
+        printJson(std::cout, results, iterations, threads);
+    } catch (const std::exception& e) {
+        std::cerr << "huffman_bench: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,607 @@
+// torosamy-huff: 命令行压缩工具, 支持标准输入输出与批量处理。
+// 用法: torosamy-huff <compress|decompress|verify|bench> [选项] [文件...]
+// 不指定文件 (或文件为 "-") 时从标准输入读取并写到标准输出; 指定多个文件或 --files-from 时进入批量模式,
+// 各文件由工作线程池并行处理, 单个文件失败不影响其余文件
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "HuffmanCompressor.h"
+#include "HuffmanDecompressor.h"
+#include "HuffmanDictionary.h"
+#include "ThreadPool.h"
+
+static const char* const kUsage =
+    "usage: torosamy-huff <command> [options] [file...]\n"
+    "\n"
+    "commands:\n"
+    "  compress, c      compress files (FILE -> FILE.torosamy)\n"
+    "  decompress, d    decompress files (FILE.torosamy -> FILE)\n"
+    "  verify, v        check archives without writing any output\n"
+    "  bench, b         measure in-memory compress/decompress throughput of files\n"
+    "\n"
+    "With no file, or with \"-\", data is read from stdin and written to stdout.\n"
+    "Several files (or --files-from) are processed in parallel by a worker pool.\n"
+    "Set TOROSAMY_HUFFMAN_QUIET=1 to hide the library banner.\n"
+    "\n"
+    "options:\n"
+    "  -o FILE              output file (single input only; \"-\" for stdout)\n"
+    "  -c, --stdout         write to stdout\n"
+    "  -d DIR               write outputs into DIR instead of next to the inputs\n"
+    "  -f, --force          overwrite existing outputs\n"
+    "  -T N, --threads N    threads; 0 uses all hardware threads (default)\n"
+    "  -b SIZE              block size of the chunked format, e.g. 256K, 4M (default 1M)\n"
+    "  --legacy             use the legacy single-stream format for file outputs\n"
+    "  --checksum           store a CRC32C per block\n"
+    "  --no-index           do not write the block index\n"
+    "  --max-code-length N  limit Huffman codes to N bits (1..64)\n"
+    "  --context N          also try order-1 context coding with up to N code tables (2..16)\n"
+    "  --lz LEVEL           LZ77 match finding before Huffman coding, 1 (fast) .. 9 (best)\n"
+    "  --ans                also try tANS coding, better than Huffman on heavily skewed data\n"
+    "  -D FILE              use the serialized dictionary FILE\n"
+    "  --suffix SUF         archive suffix (default .torosamy)\n"
+    "  --files-from FILE    read input paths from FILE, one per line (\"-\" for stdin)\n"
+    "  -i N                 bench iterations (default 3)\n"
+    "  -q, --quiet          print errors only\n"
+    "  -v, --verbose        print per-file statistics\n"
+    "  -h, --help           show this help\n";
+
+enum class Command { Compress, Decompress, Verify, Bench };
+
+struct CliOptions {
+    Command command = Command::Compress;
+    std::vector<std::string> inputs;
+    std::string output;     // -o, 只用于单个输入
+    std::string output_dir; // -d
+    std::string suffix = ".torosamy";
+    bool to_stdout = false;
+    bool force = false;
+    bool quiet = false;
+    bool verbose = false;
+    unsigned threads = 0;
+    int iterations = 3;
+    CompressionOptions compression;
+    DecompressionOptions decompression;
+};
+
+// 一个文件的处理结果, 批量模式结束时汇总
+struct JobResult {
+    bool ok = false;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+};
+
+// 每个工作线程各自复用一组压缩器与解压器
+struct Worker {
+    HuffmanCompressor compressor;
+    HuffmanDecompressor decompressor;
+};
+
+// 工作窃取线程池: 每个线程有自己的任务队列, 从队首取任务; 自己的队列空了就从其他线程的队尾窃取。
+// 任务在开始前一次性分配好, 不会在执行中新增, 所有队列都为空时各线程退出
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned threads) : queues_(threads) {}
+
+    // 任务按顺序轮流分给各线程, 调用方应先把耗时长的任务排在前面
+    void assign(size_t task_count) {
+        for (size_t task = 0; task < task_count; ++task) {
+            queues_[task % queues_.size()].tasks.push_back(task);
+        }
+    }
+
+    // run(worker, task) 在 worker 号线程上执行任务, 不应抛出异常
+    template <class F>
+    void run(F&& run) {
+        std::vector<std::thread> threads;
+        for (size_t worker = 0; worker < queues_.size(); ++worker) {
+            threads.emplace_back([this, worker, &run]() {
+                size_t task;
+                while (take(worker, task)) {
+                    run(worker, task);
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    bool take(size_t worker, size_t& task) {
+        {
+            Queue& own = queues_[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues_.size(); ++i) {
+            Queue& victim = queues_[(worker + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<Queue> queues_;
+};
+
+static std::mutex g_output_mutex; // 批量模式下各线程的输出按行互斥
+
+static void printLine(std::ostream& out, const std::string& line) {
+    std::lock_guard<std::mutex> lock(g_output_mutex);
+    out << line << std::endl;
+}
+
+static void printError(const std::string& message) {
+    printLine(std::cerr, "torosamy-huff: " + message);
+}
+
+static std::vector<unsigned char> readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static bool fileExists(const std::string& path) {
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0;
+}
+
+// 输入与已存在的输出是同一个文件 (硬链接或 -o 指回输入); "-" 输入按 stdin 判断
+static bool sameFile(const std::string& input, const std::string& output) {
+    struct stat in_st;
+    struct stat out_st;
+    int in_rc = input == "-" ? ::fstat(STDIN_FILENO, &in_st) : ::stat(input.c_str(), &in_st);
+    if (in_rc != 0 || ::stat(output.c_str(), &out_st) != 0) {
+        return false;
+    }
+    return in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino;
+}
+
+static uint64_t fileSize(const std::string& path) {
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+}
+
+static std::string baseName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static bool endsWith(const std::string& s, const std::string& suffix) {
+    return s.size() > suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// 输入对应的输出路径, "-" 表示标准输出
+static std::string outputPath(const CliOptions& options, const std::string& input) {
+    if (!options.output.empty()) {
+        return options.output;
+    }
+    if (options.to_stdout || input == "-") {
+        return "-";
+    }
+    std::string name = options.output_dir.empty() ? input : options.output_dir + "/" + baseName(input);
+    if (options.command == Command::Compress) {
+        return name + options.suffix;
+    }
+    return endsWith(name, options.suffix) ? name.substr(0, name.size() - options.suffix.size()) : name + ".out";
+}
+
+static std::string formatRate(uint64_t bytes, double seconds) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.1f MB/s", seconds > 0 ? static_cast<double>(bytes) / 1e6 / seconds : 0.0);
+    return buf;
+}
+
+static std::string formatRatio(uint64_t in, uint64_t out) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.2f%%", in > 0 ? 100.0 * static_cast<double>(out) / static_cast<double>(in) : 0.0);
+    return buf;
+}
+
+// 输入或输出为 "-" 时经由文件描述符处理: "-" 对应标准输入或标准输出, 其余路径在这里打开, 用完关闭。
+// 输出文件创建之后 created 置为 true
+template <class F>
+static void withFds(const std::string& input, const std::string& output, bool& created, F&& run) {
+    int input_fd = input == "-" ? STDIN_FILENO : ::open(input.c_str(), O_RDONLY);
+    if (input_fd < 0) {
+        throw std::runtime_error("cannot open " + input);
+    }
+    int output_fd = output == "-" ? STDOUT_FILENO : ::open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output_fd < 0) {
+        if (input_fd != STDIN_FILENO) {
+            ::close(input_fd);
+        }
+        throw std::runtime_error("cannot create " + output);
+    }
+    created = output_fd != STDOUT_FILENO;
+    auto closeFds = [&]() {
+        if (input_fd != STDIN_FILENO) {
+            ::close(input_fd);
+        }
+        if (output_fd != STDOUT_FILENO) {
+            ::close(output_fd);
+        }
+    };
+    try {
+        run(input_fd, output_fd);
+    } catch (...) {
+        closeFds();
+        throw;
+    }
+    closeFds();
+}
+
+// 文件到文件: 先确认输入可读, 再创建 (或截断) 输出文件并把 created 置为 true, 库随后重新打开它。
+// 输入不存在时不会碰到输出文件
+static void createFileOutput(const std::string& input, const std::string& output, bool& created) {
+    int input_fd = ::open(input.c_str(), O_RDONLY);
+    if (input_fd < 0) {
+        throw std::runtime_error("cannot open " + input);
+    }
+    ::close(input_fd);
+    int output_fd = ::open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output_fd < 0) {
+        throw std::runtime_error("cannot create " + output);
+    }
+    ::close(output_fd);
+    created = true;
+}
+
+static JobResult compressFile(Worker& worker, const std::string& input, const std::string& output, bool& created) {
+    JobResult result;
+    HuffmanCompressor& compressor = worker.compressor;
+    if (input == "-" || output == "-") {
+        // 标准输入或标准输出不支持定位, 总是使用分块格式
+        withFds(input, output, created, [&](int input_fd, int output_fd) { compressor.compress(input_fd, output_fd); });
+    } else {
+        createFileOutput(input, output, created);
+        compressor.compress(input, output);
+    }
+    result.bytes_in = compressor.stats().bytes_in;
+    result.bytes_out = compressor.stats().bytes_out;
+    return result;
+}
+
+static JobResult decompressFile(Worker& worker, const std::string& input, const std::string& output, bool& created) {
+    JobResult result;
+    HuffmanDecompressor& decompressor = worker.decompressor;
+    if (input == "-" || output == "-") {
+        withFds(input, output, created, [&](int input_fd, int output_fd) { decompressor.decompress(input_fd, output_fd); });
+    } else {
+        createFileOutput(input, output, created);
+        decompressor.decompress(input, output);
+    }
+    result.bytes_in = decompressor.stats().bytes_in;
+    result.bytes_out = decompressor.stats().bytes_out;
+    return result;
+}
+
+static JobResult verifyFile(Worker& worker, const std::string& input) {
+    JobResult result;
+    if (input == "-") {
+        BufferedFileSource source;
+        source.attach(STDIN_FILENO);
+        result.bytes_out = worker.decompressor.verify(source);
+    } else {
+        result.bytes_out = worker.decompressor.verify(input);
+    }
+    result.bytes_in = worker.decompressor.stats().bytes_in;
+    return result;
+}
+
+static JobResult benchFile(Worker& worker, const CliOptions& options, const std::string& input) {
+    std::vector<unsigned char> data = input == "-" ? std::vector<unsigned char>(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>()) : readFile(input);
+    std::vector<unsigned char> compressed(HuffmanCompressor::compressBound(data.size(), options.compression));
+    std::vector<unsigned char> restored(data.size());
+    size_t compressed_size = 0;
+    double best_compress = 1e30;
+    double best_decompress = 1e30;
+    for (int it = 0; it < options.iterations; ++it) {
+        auto start = std::chrono::steady_clock::now();
+        compressed_size = worker.compressor.compress(data.data(), data.size(), compressed.data(), compressed.size());
+        auto middle = std::chrono::steady_clock::now();
+        worker.decompressor.decompress(compressed.data(), compressed_size, restored.data(), restored.size());
+        auto end = std::chrono::steady_clock::now();
+        best_compress = std::min(best_compress, std::chrono::duration<double>(middle - start).count());
+        best_decompress = std::min(best_decompress, std::chrono::duration<double>(end - middle).count());
+    }
+    if (restored != data) {
+        throw std::runtime_error("round trip mismatch");
+    }
+    printLine(std::cout, input + ": " + std::to_string(data.size()) + " -> " + std::to_string(compressed_size) + " bytes (" +
+                             formatRatio(data.size(), compressed_size) + "), compress " + formatRate(data.size(), best_compress) +
+                             ", decompress " + formatRate(data.size(), best_decompress));
+    JobResult result;
+    result.bytes_in = data.size();
+    result.bytes_out = compressed_size;
+    return result;
+}
+
+// 处理一个输入; 失败时打印错误, 删除本任务创建的输出 (写了一半)
+static JobResult runJob(Worker& worker, const CliOptions& options, const std::string& input) {
+    JobResult result;
+    std::string output = options.command == Command::Compress || options.command == Command::Decompress ? outputPath(options, input) : "";
+    bool created = false; // 输出文件已由本任务创建或截断
+    try {
+        if (!output.empty() && output != "-" && !options.force && fileExists(output)) {
+            throw std::runtime_error(output + " already exists (use -f to overwrite)");
+        }
+        if (!output.empty() && output != "-" && sameFile(input, output)) {
+            throw std::runtime_error("input and output are the same file: " + output);
+        }
+        switch (options.command) {
+        case Command::Compress:
+            result = compressFile(worker, input, output, created);
+            break;
+        case Command::Decompress:
+            result = decompressFile(worker, input, output, created);
+            break;
+        case Command::Verify:
+            result = verifyFile(worker, input);
+            break;
+        case Command::Bench:
+            result = benchFile(worker, options, input);
+            break;
+        }
+    } catch (const std::exception& e) {
+        printError(input + ": " + e.what());
+        if (created) {
+            ::unlink(output.c_str());
+        }
+        return JobResult();
+    }
+    result.ok = true;
+
+    if (options.command == Command::Verify && !options.quiet) {
+        printLine(std::cout, input + ": OK (" + std::to_string(result.bytes_out) + " bytes)");
+    } else if (options.verbose && options.command != Command::Bench) {
+        std::string target = output == "-" ? "stdout" : output;
+        printLine(std::cerr, input + " -> " + target + ": " + std::to_string(result.bytes_in) + " -> " + std::to_string(result.bytes_out) +
+                                 " bytes (" + formatRatio(result.bytes_in, result.bytes_out) + ")");
+    }
+    return result;
+}
+
+static size_t parseSize(const std::string& text) {
+    char* end = nullptr;
+    unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+    std::string unit = end;
+    if (unit == "K" || unit == "k") {
+        value <<= 10;
+    } else if (unit == "M" || unit == "m") {
+        value <<= 20;
+    } else if (!unit.empty() || end == text.c_str()) {
+        throw std::runtime_error("invalid size: " + text);
+    }
+    return static_cast<size_t>(value);
+}
+
+static unsigned parseNumber(const std::string& text) {
+    char* end = nullptr;
+    unsigned long value = std::strtoul(text.c_str(), &end, 10);
+    if (end == text.c_str() || *end != '\0') {
+        throw std::runtime_error("invalid number: " + text);
+    }
+    return static_cast<unsigned>(value);
+}
+
+static void readFileList(const std::string& list, std::vector<std::string>& inputs) {
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (list != "-") {
+        file.open(list);
+        if (!file) {
+            throw std::runtime_error("cannot open " + list);
+        }
+        in = &file;
+    }
+    std::string line;
+    while (std::getline(*in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            inputs.push_back(line);
+        }
+    }
+}
+
+// 解析命令行, 参数无效时抛出 std::runtime_error; 返回 false 表示只需打印帮助
+static bool parseArguments(int argc, char** argv, CliOptions& options) {
+    if (argc < 2) {
+        throw std::runtime_error("missing command");
+    }
+    std::string command = argv[1];
+    if (command == "-h" || command == "--help") {
+        return false;
+    }
+    if (command == "compress" || command == "c") {
+        options.command = Command::Compress;
+    } else if (command == "decompress" || command == "d") {
+        options.command = Command::Decompress;
+    } else if (command == "verify" || command == "v") {
+        options.command = Command::Verify;
+    } else if (command == "bench" || command == "b") {
+        options.command = Command::Bench;
+    } else {
+        throw std::runtime_error("unknown command: " + command);
+    }
+
+    options.compression.format = ContainerFormat::Chunked;
+    bool only_files = false;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("missing value for " + arg);
+            }
+            return argv[++i];
+        };
+        if (only_files || arg == "-" || arg[0] != '-') {
+            options.inputs.push_back(arg);
+        } else if (arg == "--") {
+            only_files = true;
+        } else if (arg == "-o") {
+            options.output = value();
+        } else if (arg == "-c" || arg == "--stdout") {
+            options.to_stdout = true;
+        } else if (arg == "-d") {
+            options.output_dir = value();
+        } else if (arg == "-f" || arg == "--force") {
+            options.force = true;
+        } else if (arg == "-T" || arg == "--threads") {
+            options.threads = parseNumber(value());
+        } else if (arg == "-b") {
+            options.compression.block_size = parseSize(value());
+        } else if (arg == "--legacy") {
+            options.compression.format = ContainerFormat::Legacy;
+        } else if (arg == "--checksum") {
+            options.compression.block_checksums = true;
+        } else if (arg == "--no-index") {
+            options.compression.block_index = false;
+        } else if (arg == "--max-code-length") {
+            options.compression.max_code_length = parseNumber(value());
+        } else if (arg == "--context") {
+            options.compression.context_tables = static_cast<unsigned>(parseNumber(value()));
+        } else if (arg == "--lz") {
+            options.compression.lz_level = static_cast<unsigned>(parseNumber(value()));
+        } else if (arg == "--ans") {
+            options.compression.ans_coding = true;
+        } else if (arg == "-D") {
+            std::vector<unsigned char> bytes = readFile(value());
+            auto dictionary = std::make_shared<const HuffmanDictionary>(HuffmanDictionary::deserialize(bytes.data(), bytes.size()));
+            options.compression.dictionary = dictionary;
+            options.decompression.dictionaries.push_back(dictionary);
+        } else if (arg == "--suffix") {
+            options.suffix = value();
+        } else if (arg == "--files-from") {
+            readFileList(value(), options.inputs);
+        } else if (arg == "-i") {
+            options.iterations = std::max(1u, parseNumber(value()));
+        } else if (arg == "-q" || arg == "--quiet") {
+            options.quiet = true;
+        } else if (arg == "-v" || arg == "--verbose") {
+            options.verbose = true;
+        } else if (arg == "-h" || arg == "--help") {
+            return false;
+        } else {
+            throw std::runtime_error("unknown option: " + arg);
+        }
+    }
+
+    if (options.inputs.empty()) {
+        options.inputs.push_back("-");
+    }
+    if ((!options.output.empty() || options.to_stdout) && options.inputs.size() > 1 &&
+        (options.command == Command::Compress || options.command == Command::Decompress)) {
+        throw std::runtime_error("-o and -c require a single input");
+    }
+    if (options.suffix.empty()) {
+        throw std::runtime_error("the archive suffix must not be empty");
+    }
+    // 库自己的提示信息总是关闭, 由本工具统一输出
+    options.compression.quiet = true;
+    options.decompression.quiet = true;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    CliOptions options;
+    try {
+        if (!parseArguments(argc, argv, options)) {
+            std::cout << kUsage;
+            return 0;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "torosamy-huff: " << e.what() << "\n\n" << kUsage;
+        return 2;
+    }
+
+    const size_t count = options.inputs.size();
+    unsigned threads = ThreadPool::resolveThreadCount(options.threads);
+    // 单个文件把全部线程交给库内的分块并行; 批量时 (基准测试除外) 各文件单线程处理, 文件之间并行
+    const bool batch = count > 1 && options.command != Command::Bench;
+    const unsigned workers = batch ? static_cast<unsigned>(std::min<size_t>(threads, count)) : 1;
+    options.compression.threads = batch ? 1 : threads;
+    options.decompression.threads = batch ? 1 : threads;
+
+    std::vector<std::unique_ptr<Worker>> pool_workers;
+    for (unsigned i = 0; i < workers; ++i) {
+        pool_workers.push_back(std::make_unique<Worker>());
+        pool_workers.back()->compressor.setOptions(options.compression);
+        pool_workers.back()->decompressor.setOptions(options.decompression);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<JobResult> results(count);
+    if (workers > 1) {
+        // 大文件先分配, 窃取只需平衡末尾的小文件
+        std::vector<size_t> order(count);
+        std::vector<uint64_t> sizes(count);
+        for (size_t i = 0; i < count; ++i) {
+            order[i] = i;
+            sizes[i] = fileSize(options.inputs[i]);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+        WorkStealingPool pool(workers);
+        pool.assign(count);
+        pool.run([&](size_t worker, size_t task) {
+            size_t index = order[task];
+            results[index] = runJob(*pool_workers[worker], options, options.inputs[index]);
+        });
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            results[i] = runJob(*pool_workers[0], options, options.inputs[i]);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t failed = 0;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    for (const JobResult& result : results) {
+        failed += result.ok ? 0 : 1;
+        bytes_in += result.bytes_in;
+        bytes_out += result.bytes_out;
+    }
+    if (count > 1 && !options.quiet) {
+        char line[256];
+        std::snprintf(line, sizeof(line), "%zu files, %zu failed, %llu -> %llu bytes (%s), %.2f s, %u threads", count, failed,
+                      static_cast<unsigned long long>(bytes_in), static_cast<unsigned long long>(bytes_out), formatRatio(bytes_in, bytes_out).c_str(),
+                      seconds, workers);
+        printLine(std::cerr, line);
+    }
+    return failed == 0 ? 0 : 1;
+}
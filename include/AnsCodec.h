@@ -0,0 +1,68 @@
+#ifndef ANS_CODEC_H
+#define ANS_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include "BitStream.h"
+
+// 表格式 ANS (tANS, 即 FSE) 熵编码: 字节频率归一化到 2^L (L 为表的位数) 后按固定步长散布到状态表,
+// 每个字节平均只需 log2(2^L / 归一化频率) 位, 不像哈夫曼编码那样每个字节至少1位、且只能取整数位。
+// 四个状态轮流编码相邻的字节, 解码时四次查表互不依赖; 字节逆序编码, 位流从后往前写, 解码时正向读取。
+// 位流: 若干个0 一个1 (对齐到整字节) 4个初始状态 (各 L 位) 各字节的输出位
+namespace AnsCodec {
+    constexpr int kMinTableLog = 5;
+    constexpr int kMaxTableLog = 12;
+    constexpr int kStates = 4;
+    // 归一化频率表最多占用的字节数: 表的位数 + 每个字节值最多2字节
+    constexpr size_t kMaxTableSize = 1 + 2 * 256;
+}
+
+class AnsEncoder {
+public:
+    // 由 total 个字节的频率选定表的位数, 把频率归一化并建立编码表。返回按归一化频率估计的位流位数
+    uint64_t build(const uint64_t* counts, size_t total);
+
+    int tableLog() const { return table_log_; }
+    // 归一化频率表写入 out (至少 kMaxTableSize 字节), 返回写入的字节数。
+    // 格式: 表的位数(1字节), 之后按字节值顺序: 出现的字节写 varint 归一化频率, 0 + k 表示接下来 k+1 个字节未出现;
+    // 频率之和达到 2^L 即结束
+    size_t writeTable(unsigned char* out) const;
+
+    // 编码 n 个字节, 位流写在 out 开头, 返回位流的字节数; out 至少 maxEncodedSize(n) 字节
+    size_t encode(const unsigned char* in, size_t n, unsigned char* out) const;
+    static size_t maxEncodedSize(size_t n) {
+        return (n * AnsCodec::kMaxTableLog + AnsCodec::kStates * AnsCodec::kMaxTableLog + 1 + 7) / 8 + BitWriter::kSlack;
+    }
+
+private:
+    struct SymbolTransform {
+        uint32_t delta_bits;  // (状态 + delta_bits) >> 16 即输出的位数
+        int32_t delta_state;  // 输出之后 (状态 >> 位数) + delta_state 为状态表的下标
+    };
+
+    uint16_t normalized_[256];
+    SymbolTransform transforms_[256];
+    uint16_t states_[1 << AnsCodec::kMaxTableLog];
+    int table_log_ = 0;
+};
+
+class AnsDecoder {
+public:
+    // 解析归一化频率表并建立解码表, 返回表之后的位置; 表无效时抛出 std::runtime_error
+    const unsigned char* readTable(const unsigned char* p, const unsigned char* end);
+
+    // 恰好解码 count 个字节; 位流无效或读过输入末尾时抛出 std::runtime_error
+    void decode(BitReader& reader, unsigned char* out, size_t count) const;
+
+private:
+    struct Entry {
+        uint16_t next;   // 下一个状态的基数, 加上读出的位即下一个状态
+        unsigned char symbol;
+        unsigned char bits;
+    };
+
+    Entry entries_[1 << AnsCodec::kMaxTableLog];
+    int table_log_ = 0;
+};
+
+#endif // ANS_CODEC_H
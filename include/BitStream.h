@@ -0,0 +1,175 @@
+#ifndef BIT_STREAM_H
+#define BIT_STREAM_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// 按大端序读取8字节 (哈夫曼位流为高位在前)
+inline uint64_t loadBigEndian64(const unsigned char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+// 按大端序写入8字节
+inline void storeBigEndian64(unsigned char* p, uint64_t v) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    std::memcpy(p, &v, sizeof(v));
+}
+
+// 高位在前的位写入器: 编码先累积在64位寄存器中, 再整字写入输出缓冲区。
+// flush() 每次写8字节但只前进完整的字节数, 因此输出缓冲区末尾需要预留8字节。
+class BitWriter {
+public:
+    static constexpr size_t kSlack = 8;
+
+    BitWriter() = default;
+    BitWriter(unsigned char* begin) { reset(begin); }
+
+    void reset(unsigned char* begin) {
+        begin_ = begin;
+        ptr_ = begin;
+        bits_ = 0;
+        count_ = 0;
+    }
+
+    // 写出缓冲区中已完成的字节后调用, 寄存器中未满一字节的位保持不变
+    void rewind() { ptr_ = begin_; }
+
+    // 已写入缓冲区的完整字节数
+    size_t bytesWritten() const { return static_cast<size_t>(ptr_ - begin_); }
+
+    // 寄存器中的位数加 len 不能超过64, len 取值 1..56
+    void put(uint64_t code, int len) {
+        bits_ |= code << (64 - count_ - len);
+        count_ += len;
+    }
+
+    // 把寄存器中的完整字节写入缓冲区, 之后寄存器中最多剩7位
+    void flush() {
+        storeBigEndian64(ptr_, bits_);
+        ptr_ += count_ >> 3;
+        bits_ = (count_ >= 64) ? 0 : bits_ << (count_ & ~7);
+        count_ &= 7;
+    }
+
+    // 任意长度 (最长64位) 的编码
+    void putLong(uint64_t code, int len) {
+        if (len > 32) {
+            put(code >> 32, len - 32);
+            flush();
+            len = 32;
+            code &= 0xFFFFFFFFull;
+        }
+        if (len > 0) {
+            put(code, len);
+            flush();
+        }
+    }
+
+    // 写出最后不足一字节的位 (低位补0)
+    void finish() {
+        flush();
+        if (count_ > 0) {
+            *ptr_++ = static_cast<unsigned char>(bits_ >> 56);
+            bits_ = 0;
+            count_ = 0;
+        }
+    }
+
+private:
+    unsigned char* begin_ = nullptr;
+    unsigned char* ptr_ = nullptr;
+    uint64_t bits_ = 0;
+    int count_ = 0;
+};
+
+// 高位在前的位读取器: 64位寄存器左对齐存放尚未消费的位
+class BitReader {
+public:
+    BitReader() = default;
+    BitReader(const unsigned char* begin, const unsigned char* end, bool last) {
+        reset(begin, end, last);
+    }
+
+    void reset(const unsigned char* begin, const unsigned char* end, bool last) {
+        ptr_ = begin;
+        end_ = end;
+        last_ = last;
+        bits_ = 0;
+        avail_ = 0;
+        padded_ = 0;
+    }
+
+    // 输入窗口被搬移或追加后重新定位, 寄存器中已装入的位保持不变
+    void rebase(const unsigned char* begin, const unsigned char* end, bool last) {
+        ptr_ = begin;
+        end_ = end;
+        last_ = last;
+    }
+
+    // 下一个尚未装入寄存器的字节
+    const unsigned char* position() const { return ptr_; }
+
+    // 窗口内剩余字节是否足够安全地解码一轮 (最后一个窗口总是足够, 不足部分补0)
+    bool hasMargin(size_t margin) const {
+        return last_ || static_cast<size_t>(end_ - ptr_) >= margin;
+    }
+
+    // 保证寄存器中至少有56位
+    void refill() {
+        if (end_ - ptr_ >= 8) {
+            bits_ |= loadBigEndian64(ptr_) >> avail_;
+            ptr_ += (63 - avail_) >> 3;
+            avail_ |= 56;
+        } else {
+            refillSlow();
+        }
+    }
+
+    int available() const { return avail_; }
+    // 寄存器中尚未消费的真实输入位数, 不含输入结束后补的0
+    int bufferedInputBits() const { return avail_ - padded_; }
+
+    // n 取值 1..32
+    uint32_t peek(int n) const { return static_cast<uint32_t>(bits_ >> (64 - n)); }
+    // n 取值 0..32, n 为0时返回0; 用于长度不定的附加位, 省去判断0的分支
+    uint32_t peekBits(int n) const { return static_cast<uint32_t>((bits_ >> 1) >> (63 - n)); }
+
+    void consume(int n) {
+        bits_ <<= n;
+        avail_ -= n;
+    }
+
+    // 是否已经消费了输入末尾之后的填充位
+    bool overrun() const { return padded_ > avail_; }
+
+private:
+    void refillSlow() {
+        while (avail_ <= 56) {
+            if (ptr_ < end_) {
+                bits_ |= static_cast<uint64_t>(*ptr_++) << (56 - avail_);
+            } else if (last_) {
+                padded_ += 8; // 输入结束后补0
+            } else {
+                break;
+            }
+            avail_ += 8;
+        }
+    }
+
+    const unsigned char* ptr_ = nullptr;
+    const unsigned char* end_ = nullptr;
+    bool last_ = true;
+    uint64_t bits_ = 0;
+    int avail_ = 0;
+    int padded_ = 0;
+};
+
+#endif // BIT_STREAM_H
@@ -0,0 +1,254 @@
+#ifndef BYTE_IO_H
+#define BYTE_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// 可插拔的字节输入源, 压缩器与解压器通过它读取数据
+class ByteSource {
+public:
+    static constexpr uint64_t kUnknownSize = UINT64_MAX;
+
+    virtual ~ByteSource() = default;
+
+    // 读取最多 n 个字节, 返回实际读取的字节数, 返回0表示输入结束
+    virtual size_t read(unsigned char* dst, size_t n) = 0;
+    // 跳到绝对位置, 不支持随机访问时返回 false
+    virtual bool seek(uint64_t pos) = 0;
+    // 输入总长度, 未知时返回 kUnknownSize
+    virtual uint64_t size() const = 0;
+    // 整个输入在内存中连续可见时返回首地址 (内存映射或内存块), 否则返回 nullptr
+    virtual const unsigned char* data() const { return nullptr; }
+    // 提示随后会读取 [pos, pos + n), 内存映射的输入据此提前读入页面; 默认什么也不做
+    virtual void prefetch(uint64_t pos, size_t n) { (void)pos; (void)n; }
+
+    // 读满 n 个字节, 输入提前结束时抛出 std::runtime_error
+    void readExact(void* dst, size_t n);
+};
+
+// 可插拔的字节输出端
+class ByteSink {
+public:
+    virtual ~ByteSink() = default;
+
+    virtual void write(const unsigned char* src, size_t n) = 0;
+    // 已写出的总字节数
+    virtual uint64_t tell() const = 0;
+    // 覆盖之前已写出的内容, 用于回填头部字段
+    virtual void patch(uint64_t pos, const unsigned char* src, size_t n) = 0;
+    virtual void flush() {}
+    // 预留紧接已写内容之后的 n 个字节 (n > 0) 供调用方直接填写, 返回首地址; 填写后以 commit 确认实际写入的字节数
+    // (不超过 n), 未确认的部分被丢弃, 两者之间不能调用 write。不支持时返回 nullptr, 调用方改用 write
+    virtual unsigned char* reserve(size_t n) { (void)n; return nullptr; }
+    virtual void commit(size_t n) { (void)n; }
+};
+
+// 内存块输入, 不复制数据
+class MemorySource : public ByteSource {
+public:
+    MemorySource() = default;
+    MemorySource(const unsigned char* data, size_t size) : data_(data), size_(size) {}
+
+    size_t read(unsigned char* dst, size_t n) override;
+    bool seek(uint64_t pos) override;
+    uint64_t size() const override { return size_; }
+    const unsigned char* data() const override { return data_; }
+
+protected:
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t pos_ = 0;
+};
+
+// 以 mmap 映射整个文件的输入
+class MappedFileSource : public MemorySource {
+public:
+    MappedFileSource() = default;
+    ~MappedFileSource() override;
+    MappedFileSource(const MappedFileSource&) = delete;
+    MappedFileSource& operator=(const MappedFileSource&) = delete;
+
+    // 文件不存在或无法映射 (例如管道) 时返回 false
+    bool open(const std::string& filepath);
+    void close();
+
+    void prefetch(uint64_t pos, size_t n) override;
+
+private:
+    void* mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+};
+
+// 大块缓冲的文件输入, 适用于无法映射的文件
+class BufferedFileSource : public ByteSource {
+public:
+    static constexpr size_t kDefaultBufferSize = 1 << 20;
+
+    explicit BufferedFileSource(size_t buffer_size = kDefaultBufferSize);
+    ~BufferedFileSource() override;
+    BufferedFileSource(const BufferedFileSource&) = delete;
+    BufferedFileSource& operator=(const BufferedFileSource&) = delete;
+
+    bool open(const std::string& filepath);
+    // 使用已打开的文件描述符 (标准输入、管道、套接字等), owns 为 true 时 close() 会关闭它
+    bool attach(int fd, bool owns = false);
+    void close();
+
+    size_t read(unsigned char* dst, size_t n) override;
+    bool seek(uint64_t pos) override;
+    uint64_t size() const override { return size_; }
+
+private:
+    size_t fill(unsigned char* dst, size_t n);
+
+    int fd_ = -1;
+    bool owns_fd_ = true;
+    uint64_t size_ = kUnknownSize;
+    size_t buffer_size_;
+    std::vector<unsigned char> buffer_; // 第一次打开时才分配, 只作为映射失败后备的对象不占用内存
+    size_t buffer_pos_ = 0;
+    size_t buffer_len_ = 0;
+};
+
+// 写入调用方提供的固定大小内存块, 空间不足时抛出 std::runtime_error
+class MemorySink : public ByteSink {
+public:
+    MemorySink(unsigned char* data, size_t capacity) : data_(data), capacity_(capacity) {}
+
+    void write(const unsigned char* src, size_t n) override;
+    uint64_t tell() const override { return size_; }
+    void patch(uint64_t pos, const unsigned char* src, size_t n) override;
+    unsigned char* reserve(size_t n) override;
+    void commit(size_t n) override { size_ += n; }
+
+private:
+    unsigned char* data_;
+    size_t capacity_;
+    size_t size_ = 0;
+};
+
+// 追加写入 std::vector, 位置从构造时 vector 的末尾开始计算
+class VectorSink : public ByteSink {
+public:
+    explicit VectorSink(std::vector<unsigned char>& out) : out_(out), base_(out.size()) {}
+
+    void write(const unsigned char* src, size_t n) override;
+    uint64_t tell() const override { return out_.size() - base_ - reserved_; }
+    void patch(uint64_t pos, const unsigned char* src, size_t n) override;
+    unsigned char* reserve(size_t n) override;
+    void commit(size_t n) override;
+
+private:
+    std::vector<unsigned char>& out_;
+    size_t base_;
+    size_t reserved_ = 0; // 末尾已预留而未确认的字节数
+};
+
+// 丢弃写入的数据, 只记录字节数; 用于只校验不输出的解压
+class NullSink : public ByteSink {
+public:
+    void write(const unsigned char*, size_t n) override { size_ += n; }
+    uint64_t tell() const override { return size_; }
+    void patch(uint64_t, const unsigned char*, size_t) override {}
+
+private:
+    uint64_t size_ = 0;
+};
+
+// 大块缓冲的文件输出
+class BufferedFileSink : public ByteSink {
+public:
+    static constexpr size_t kDefaultBufferSize = 1 << 20;
+
+    explicit BufferedFileSink(size_t buffer_size = kDefaultBufferSize);
+    ~BufferedFileSink() override;
+    BufferedFileSink(const BufferedFileSink&) = delete;
+    BufferedFileSink& operator=(const BufferedFileSink&) = delete;
+
+    bool open(const std::string& filepath);
+    // 使用已打开的文件描述符 (标准输出、管道、套接字等), owns 为 true 时 close() 会关闭它
+    bool attach(int fd, bool owns = false);
+    void close();
+
+    void write(const unsigned char* src, size_t n) override;
+    uint64_t tell() const override { return flushed_ + buffer_len_; }
+    void patch(uint64_t pos, const unsigned char* src, size_t n) override;
+    void flush() override;
+
+private:
+    int fd_ = -1;
+    bool owns_fd_ = true;
+    uint64_t flushed_ = 0;
+    std::vector<unsigned char> buffer_;
+    size_t buffer_len_ = 0;
+};
+
+// 以 mmap 写入的文件输出, 只支持普通文件: reserve 先为文件分配空间并扩展长度, 再把预留的范围映射到内存,
+// 调用方直接填写映射, 不经过缓冲区与 write 调用; write 与 patch 退回到 pwrite。close 时文件截到已确认的长度
+class MappedFileSink : public ByteSink {
+public:
+    MappedFileSink() = default;
+    ~MappedFileSink() override;
+    MappedFileSink(const MappedFileSink&) = delete;
+    MappedFileSink& operator=(const MappedFileSink&) = delete;
+
+    // 无法创建或不是普通文件 (例如 /dev/stdout) 时返回 false
+    bool open(const std::string& filepath);
+    void close();
+
+    void write(const unsigned char* src, size_t n) override;
+    uint64_t tell() const override { return size_; }
+    void patch(uint64_t pos, const unsigned char* src, size_t n) override;
+    // 磁盘空间不足时抛出 std::runtime_error, 而不是在填写映射时收到 SIGBUS; 无法映射时返回 nullptr
+    unsigned char* reserve(size_t n) override;
+    void commit(size_t n) override;
+
+private:
+    void unmap();
+
+    int fd_ = -1;
+    uint64_t size_ = 0; // 已确认的长度
+    void* mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+};
+
+// 从 std::istream 读取; 只有流本身支持定位时 seek 才会成功
+class StreamSource : public ByteSource {
+public:
+    explicit StreamSource(std::istream& in) : in_(in) {}
+
+    size_t read(unsigned char* dst, size_t n) override;
+    bool seek(uint64_t pos) override;
+    uint64_t size() const override { return kUnknownSize; }
+
+private:
+    std::istream& in_;
+};
+
+// 写入 std::ostream; patch 需要流支持定位, 否则抛出 std::runtime_error
+class StreamSink : public ByteSink {
+public:
+    explicit StreamSink(std::ostream& out);
+
+    void write(const unsigned char* src, size_t n) override;
+    uint64_t tell() const override { return written_; }
+    void patch(uint64_t pos, const unsigned char* src, size_t n) override;
+    void flush() override;
+
+private:
+    std::ostream& out_;
+    std::streampos base_; // 构造时流的位置, 流不支持定位时为 -1
+    uint64_t written_ = 0;
+};
+
+// 优先以 mmap 打开文件, 无法映射时退回到缓冲读取; 两者都失败时返回 nullptr
+ByteSource* openFileSource(const std::string& filepath, MappedFileSource& mapped, BufferedFileSource& buffered);
+
+// 两个路径指向同一个文件 (同一设备上的同一 inode, 包括硬链接) 时返回 true; 任一路径不存在时返回 false
+bool isSameFile(const std::string& a, const std::string& b);
+
+#endif // BYTE_IO_H
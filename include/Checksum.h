@@ -0,0 +1,11 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC32C (Castagnoli 多项式, 与 iSCSI、ext4 使用的相同)。crc 为之前各段的结果, 可以分段连续计算。
+// 支持 SSE4.2 的 x86-64 处理器与带 CRC 扩展的 ARMv8 上使用硬件 crc32 指令, 否则按8字节查表
+uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+
+#endif // CHECKSUM_H
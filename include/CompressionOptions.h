@@ -0,0 +1,50 @@
+#ifndef COMPRESSION_OPTIONS_H
+#define COMPRESSION_OPTIONS_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class HuffmanDictionary;
+
+// 压缩输出的容器格式
+enum class ContainerFormat {
+    Legacy,  // 旧格式: 全局头部 + 单一位流 + 末尾哈夫曼表
+    Chunked, // 分块格式: 每块独立编码, 可多线程压缩
+};
+
+struct CompressionOptions {
+    ContainerFormat format = ContainerFormat::Legacy;
+    size_t block_size = 1 << 20; // 分块格式每块的原始字节数
+    unsigned threads = 0;        // 压缩线程数, 0 表示使用全部硬件线程
+    // 分块压缩的流水线中在途数据块 (预读的原始数据与编码结果) 最多占用的内存, 0 表示每个线程两块;
+    // 小于一块所需的内存时仍保留一块
+    size_t max_buffered_bytes = 0;
+    bool block_index = true;     // 分块格式是否在末尾写入块索引
+    bool block_checksums = false; // 分块格式是否为每块记录负载的 CRC32C, 解压与校验时据此发现损坏
+    bool canonical_codes = true; // 分块格式是否使用规范哈夫曼编码 (编码表只存储编码长度)
+    unsigned streams = 4;        // 分块格式每块的交错位流数, 1 或 4; 多个位流可以交错解码
+    unsigned max_code_length = 0; // 最长编码位数 (1..64), 0 表示不限制; 取 kRootBits (11) 以内时每个字符一次查表即可解码
+    // 分块格式1阶上下文编码的最多编码表数 (2..16), 0 表示不使用。设置后每块还尝试按前一个字节分组选用编码表,
+    // 比普通哈夫曼块短时采用; 压缩更慢, 解码每字节依赖前一个字节, 也比普通哈夫曼块慢
+    unsigned context_tables = 0;
+    // 分块格式 LZ77 前端的级别 (1..9), 0 表示不使用。级别越高匹配查找越仔细, 压缩越慢而压缩率越高;
+    // LZ 块比其他写法短时采用, 重复内容多的数据 (日志、JSON 等) 解码也比逐字节的哈夫曼块快
+    unsigned lz_level = 0;
+    // 分块格式是否尝试 tANS 编码: 频率按小数位计费, 分布很偏斜 (少数字节占绝大多数) 时比哈夫曼编码更接近熵,
+    // 块更短时采用
+    bool ans_coding = false;
+    bool quiet = false;           // 不在控制台输出任何信息, 结果只通过统计信息返回
+    // 预先训练的静态编码表: 设置后总是使用分块格式, 各块直接使用字典的编码, 文件头只记录字典 ID;
+    // 某块用字典编码后比原始数据还长时, 该块改用自己的编码表。小消息宜同时关闭 block_index
+    std::shared_ptr<const HuffmanDictionary> dictionary;
+};
+
+struct DecompressionOptions {
+    unsigned threads = 0; // 分块格式的解码线程数, 0 表示使用全部硬件线程
+    bool quiet = false;   // 不在控制台输出任何信息, 结果只通过统计信息返回
+    // 可用的字典, 按归档头部记录的 ID 查找; 找不到归档所需的字典时解压抛出 std::runtime_error
+    std::vector<std::shared_ptr<const HuffmanDictionary>> dictionaries;
+};
+
+#endif // COMPRESSION_OPTIONS_H
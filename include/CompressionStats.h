@@ -0,0 +1,57 @@
+#ifndef COMPRESSION_STATS_H
+#define COMPRESSION_STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+// 各阶段耗时 (秒)。多线程分块压缩/解压时为各线程在该阶段的耗时之和, total 为实际经过的时间
+struct PhaseTimings {
+    double histogram = 0.0;       // 统计字符频率
+    double tree_build = 0.0;      // 建树求编码长度
+    double code_generation = 0.0; // 限制编码长度、分配规范编码并生成编码表
+    double encode = 0.0;          // 编码位流
+    double table_write = 0.0;     // 序列化编码表
+    double table_read = 0.0;      // 解压: 读取编码表并生成解码表
+    double decode = 0.0;          // 解压: 解码位流
+    double total = 0.0;
+
+    PhaseTimings& operator+=(const PhaseTimings& other);
+};
+
+// 一次压缩或解压的统计信息, 由 HuffmanCompressor / HuffmanDecompressor 填写
+struct CompressionStats {
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    uint64_t blocks = 0;  // 分块格式的数据块数, 旧格式为1
+    unsigned threads = 0; // 实际使用的线程数
+    // 以下各项只在压缩时填写; 分块格式各块有独立的编码, 平均编码长度按所有块合计
+    unsigned distinct_symbols = 0;    // 输入中出现过的不同字节值数量
+    unsigned max_code_length = 0;
+    double average_code_length = 0.0; // 按频率加权的平均编码长度 (位/字符), 不含头部与编码表
+    double entropy = 0.0;             // 输入的零阶熵 (位/字符)
+    double bits_per_symbol = 0.0;     // 实际输出的位/字符, 含头部与编码表
+    PhaseTimings timings;
+
+    // 由全部输入的字符频率与编码后的位流总位数填写 distinct_symbols、average_code_length 和 entropy
+    void setSymbolStatistics(const uint64_t* counts, uint64_t payload_bits);
+};
+
+// 每次压缩或解压结束时调用, 可用于接入指标系统
+using StatsCallback = std::function<void(const CompressionStats&)>;
+
+// 分段计时: lap() 返回距上一次调用 (或构造) 经过的秒数
+class PhaseClock {
+public:
+    PhaseClock() : last_(std::chrono::steady_clock::now()) {}
+    double lap() {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - last_).count();
+        last_ = now;
+        return seconds;
+    }
+private:
+    std::chrono::steady_clock::time_point last_;
+};
+
+#endif // COMPRESSION_STATS_H
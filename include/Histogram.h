@@ -0,0 +1,17 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+
+class ThreadPool;
+
+// 把 data 中 size 个字节的出现次数累加到 counts (以字节值为下标的256个计数)。
+// 内部用4个 uint32_t 子直方图轮流计数, 同一字节连续出现时相邻的自增不会落在同一个计数器上,
+// 避免读写同一地址造成的流水线停顿; 每次读入16字节后再拆分
+void countBytes(const unsigned char* data, size_t size, uint64_t* counts);
+
+// 输入较大时切分为多段在 pool 上并行统计, 最后合并; 输入较小时等同于 countBytes
+void countBytesParallel(const unsigned char* data, size_t size, uint64_t* counts, ThreadPool& pool);
+
+#endif // HISTOGRAM_H
@@ -1,24 +1,26 @@
-#ifndef HUFFMAN_H
-#define HUFFMAN_H
-
-#include <string>
-#include <climits> 
-class HuffmanNode {
-public:
-    unsigned char b;     // 字符本身
-    long count;          // 字符出现频率（权值）/ 或在解压时表示编码长度
-    long parent;         // 父节点索引
-    long lch, rch;       // 左右子节点索引
-    std::string bits;    // 存储哈夫曼编码
-
-    HuffmanNode() : b(0), count(0), parent(-1), lch(-1), rch(-1), bits("") {}
-
-    bool operator<(const HuffmanNode& other) const {
-        return count > other.count; // 降序
-    }
-};
-
-// 将字节转换为二进制字符串，固定8位
-std::string byteToBinaryString(unsigned char byte);
-
+#ifndef HUFFMAN_H
+#define HUFFMAN_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 数值形式的哈夫曼编码, code 的低 length 位为编码 (高位在前)
+struct HuffmanCodeword {
+    unsigned short symbol = 0;
+    unsigned char length = 0;
+    uint64_t code = 0;
+};
+
+// 按 (编码长度, 字符) 的顺序为 codewords 分配规范哈夫曼编码, 只使用其中的 symbol 与 length, codewords 会被重新排序。
+// 只有一个字符时允许编码长度为0; 其余情况下编码长度为0或超过64, 或长度集合不能构成前缀码时抛出 std::runtime_error
+void assignCanonicalCodes(HuffmanCodeword* codewords, size_t count);
+
+// package-merge: 在编码长度不超过 max_length 的约束下求最优编码长度, weights 与 lengths 各 count 个。
+// 要求 2 <= count <= 256, max_length <= 64 且 2^max_length >= count; 不分配内存
+void packageMergeCodeLengths(const uint64_t* weights, size_t count, int max_length, unsigned char* lengths);
+
+// 最长编码超过 max_length 时, 按 weights (以字符为下标) 重新求受限的编码长度并分配规范编码, max_length 为0表示不限制。
+// max_length 不足以容纳全部字符时按所需的最小位数处理; 返回是否修改了编码
+bool limitCodeLengths(HuffmanCodeword* codewords, size_t count, const uint64_t* weights, int max_length);
+
 #endif // HUFFMAN_H
\ No newline at end of file
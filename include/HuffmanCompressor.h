@@ -1,24 +1,84 @@
-#ifndef HUFFMAN_COMPRESSOR_H
-#define HUFFMAN_COMPRESSOR_H
-
-#include <string>
-#include <fstream>
-#include "Huffman.h"
-
-class HuffmanCompressor {
-public:
-    HuffmanCompressor();
-    void compress(const std::string& input_filepath, const std::string& output_filepath);
-private:
-    HuffmanNode header_[512]; // 前256个元素存储叶子结点,其余存储非叶子结点
-    long calculateFrequencies(std::ifstream& ifp);
-    void sortNodesByFrequency(long num_distinct_chars);
-    long buildHuffmanTree(long num_distinct_chars);
-    void generateHuffmanCodes(long num_distinct_chars);
-    long writeCompressedData(std::ifstream& ifp, std::ofstream& ofp, long original_file_length, long num_distinct_chars);
-    void writeHuffmanTable(std::ofstream& ofp, long num_distinct_chars);
-
-
-};
-
+#ifndef HUFFMAN_COMPRESSOR_H
+#define HUFFMAN_COMPRESSOR_H
+
+#include <iostream>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Huffman.h"
+#include "ByteIO.h"
+#include "HuffmanEncodeTable.h"
+#include "HuffmanTreeBuilder.h"
+#include "CompressionOptions.h"
+#include "CompressionStats.h"
+#include "HuffmanFormat.h"
+
+// 同一个对象可以反复用于任意多次压缩: 编码表与临时缓冲区都保存在对象中并在调用之间复用,
+// 预热之后, 单线程或只有一个数据块的调用不再分配堆内存。对象不是线程安全的, 每个线程使用自己的对象
+class HuffmanCompressor {
+public:
+    HuffmanCompressor();
+    explicit HuffmanCompressor(const CompressionOptions& options);
+    void compress(const std::string& input_filepath, const std::string& output_filepath);
+    // 从任意输入源压缩到任意输出端; 输入必须可映射或支持重新定位 (需要读两遍)
+    void compress(ByteSource& input, ByteSink& output);
+    // 流式压缩: 总是使用分块格式, 单遍顺序读取输入并顺序写出, 内存占用只与块大小和线程数 (或 max_buffered_bytes) 有关;
+    // 适用于标准输入输出、管道与套接字
+    void compress(std::istream& input, std::ostream& output);
+    // 从已打开的文件描述符流式压缩, 不会关闭它们
+    void compress(int input_fd, int output_fd);
+    // 压缩内存中的数据, 输出追加到 out 末尾
+    void compress(const void* data, size_t size, std::vector<unsigned char>& out);
+    void compress(std::string_view input, std::vector<unsigned char>& out);
+    // 压缩到调用方提供的缓冲区, 返回写入的字节数; 容量不小于 compressBound(size) 时一定成功
+    size_t compress(const void* data, size_t size, void* dst, size_t dst_capacity);
+
+    // size 字节的输入以旧格式压缩后最多占用的字节数
+    static size_t compressBound(size_t size);
+    // size 字节的输入按 options 指定的格式压缩后最多占用的字节数
+    static size_t compressBound(size_t size, const CompressionOptions& options);
+
+    const CompressionOptions& options() const { return options_; }
+    void setOptions(const CompressionOptions& options) { options_ = options; }
+
+    // 释放复用的缓冲区并清空统计信息, 选项与回调保持不变
+    void reset();
+
+    // 最近一次压缩的统计信息
+    const CompressionStats& stats() const { return stats_; }
+    // 每次压缩结束时以统计信息调用 callback, 传入空函数取消
+    void setStatsCallback(StatsCallback callback) { stats_callback_ = std::move(callback); }
+private:
+    std::ostream* report_ = &std::cout; // 统计信息的输出位置; 输出可能是标准输出时改为标准错误
+    CompressionOptions options_;
+    CompressionStats stats_;
+    StatsCallback stats_callback_;
+    // 以下表格与缓冲区在多次调用之间复用, 缓冲区只在需要更大的容量时才重新分配
+    uint64_t counts_[256] = {}; // 以字节值为下标的字符频率
+    HuffmanCodeword codewords_[256]; // 旧格式的编码, 按哈夫曼表中的顺序排列
+    size_t num_codewords_ = 0;
+    HuffmanEncodeTable encode_table_; // 以字节值为下标的整数编码表
+    HuffmanEncodeTable previous_table_; // 分块格式中最近一个自带编码表的块的编码表
+    HuffmanTreeBuilder tree_builder_;
+    std::vector<unsigned char> input_buf_;  // 未映射输入的读取缓冲区
+    std::vector<unsigned char> encode_buf_; // 编码输出缓冲区
+    std::vector<unsigned char> table_buf_;  // 旧格式的编码表 / 分块格式的文件头、结束块与块索引
+    std::vector<unsigned char> block_buf_;  // 单线程分块压缩时一块的编码结果
+    std::vector<HuffmanFormat::IndexEntry> index_;
+    long calculateFrequencies(ByteSource& input);
+    long writeCompressedData(ByteSource& input, ByteSink& output, long original_file_length);
+    void writeHuffmanTable(ByteSink& output, long num_distinct_chars);
+    // 由 counts_ 中的频率生成编码写入 codewords_ 并生成编码表, 返回不同字符的数量
+    long buildHuffmanCodes();
+    // 分块格式: 多于一块时读取、编码与写出组成流水线同时进行, 各块在工作线程上独立编码, 按顺序写出
+    void compressChunked(ByteSource& input, ByteSink& output, const CompressionOptions& options);
+    void compressStream(ByteSource& input, ByteSink& output);
+    // 填写总耗时与输出大小, 调用回调并在未静默时打印结果
+    void finishStats(double total_seconds, bool chunked);
+
+
+};
+
 #endif // HUFFMAN_COMPRESSOR_H
\ No newline at end of file
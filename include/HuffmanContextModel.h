@@ -0,0 +1,75 @@
+#ifndef HUFFMAN_CONTEXT_MODEL_H
+#define HUFFMAN_CONTEXT_MODEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Huffman.h"
+#include "BitStream.h"
+#include "HuffmanDecodeTable.h"
+#include "HuffmanTreeBuilder.h"
+
+// 1阶上下文哈夫曼编码: 每个字节按它前面的字节 (上下文) 选用编码表。256个上下文按字节频率聚为最多 kMaxTables 组,
+// 每组一张规范哈夫曼编码表; 每个位流的第一个字节以0为上下文。
+// 编码长度不超过 kMaxCodeLength, 解码时每组只需一张 2^kMaxCodeLength 项的单级查找表, 全部表合计 64 KB 以内, 可以常驻缓存
+namespace HuffmanContextModel {
+    constexpr int kMaxTables = 16;
+    constexpr int kMaxCodeLength = HuffmanDecodeTable::kRootBits;
+    constexpr int kContextMapSize = 128; // 上下文映射: 每个上下文的组号占4位, 偶数上下文在低4位
+}
+
+class HuffmanContextEncoder {
+public:
+    // 统计 data 中各段的字节对频率 (段 s 为 [starts[s], starts[s + 1])), 把上下文聚为最多 max_tables 组并为各组建表,
+    // 最长编码取 max_code_length 与 kMaxCodeLength 中较小的一个。返回编码全部数据的总位数
+    uint64_t build(const unsigned char* data, const size_t* starts, int segments, unsigned max_tables, unsigned max_code_length);
+
+    int numTables() const { return num_tables_; }
+    unsigned char tableOf(unsigned char context) const { return map_[context]; }
+    // 第 t 组的编码, 按规范编码的顺序排列
+    const HuffmanCodeword* codewords(int t) const { return codewords_[t]; }
+    size_t numCodewords(int t) const { return num_codewords_[t]; }
+    unsigned maxCodeLength() const { return max_code_length_; }
+
+    // 以0为起始上下文编码 n 个字节; 调用方需保证缓冲区剩余空间不少于 maxEncodedSize(n)
+    void encode(const unsigned char* in, size_t n, BitWriter& writer) const;
+    size_t maxEncodedSize(size_t n) const {
+        return (n * static_cast<size_t>(max_code_length_) + 7) / 8 + BitWriter::kSlack + 1;
+    }
+
+private:
+    // 把 from 组并入 into 组
+    void mergeClusters(int into, int from);
+
+    uint32_t pairs_[256][256] = {};       // [上下文][字节] 的频率, build 结束时清零用过的行
+    uint64_t clusters_[HuffmanContextModel::kMaxTables][256] = {};
+    unsigned char map_[256] = {};
+    uint16_t entries_[HuffmanContextModel::kMaxTables][256] = {}; // 编码 << 4 | 长度
+    HuffmanCodeword codewords_[HuffmanContextModel::kMaxTables][256];
+    size_t num_codewords_[HuffmanContextModel::kMaxTables] = {};
+    int num_tables_ = 0;
+    unsigned max_code_length_ = 0;
+    HuffmanTreeBuilder builder_;
+};
+
+class HuffmanContextDecoder {
+public:
+    // 由第 t 组的编码建立它的查找表; 编码超过 kMaxCodeLength 位或不是合法前缀码时抛出 std::runtime_error
+    void buildTable(int t, const HuffmanCodeword* codewords, size_t count);
+    // 由 kContextMapSize 字节的上下文映射为每个上下文选定查找表; 映射引用了 num_tables 以外的组时抛出 std::runtime_error
+    void setContextMap(const unsigned char* context_map, int num_tables);
+
+    // 以0为起始上下文恰好解码 count 个字节; 遇到无效编码或读过输入末尾时抛出 std::runtime_error
+    void decode(BitReader& reader, unsigned char* out, size_t count) const;
+    // 交错解码 kInterleavedStreams 个互相独立的位流, 各位流的起始上下文都是0
+    void decodeInterleaved(BitReader* readers, unsigned char* const* out, const size_t* count) const;
+
+private:
+    static constexpr uint16_t kInvalid = 0xFFFF;
+    // 一次装载后每个位流可以连续解码的字节数: 装载保证56位, 每个编码最多 kMaxCodeLength 位
+    static constexpr int kSymbolsPerRefill = 56 / HuffmanContextModel::kMaxCodeLength;
+
+    uint16_t entries_[HuffmanContextModel::kMaxTables][1 << HuffmanContextModel::kMaxCodeLength]; // 长度 << 8 | 字节
+    const uint16_t* tables_[256]; // 以上下文为下标的查找表
+};
+
+#endif // HUFFMAN_CONTEXT_MODEL_H
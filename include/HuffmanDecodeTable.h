@@ -0,0 +1,80 @@
+#ifndef HUFFMAN_DECODE_TABLE_H
+#define HUFFMAN_DECODE_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Huffman.h"
+#include "BitStream.h"
+
+// 查表式哈夫曼解码器: 一级表按接下来的 kRootBits 位索引, 长编码通过溢出子表继续查找。
+// 一级表的一个表项最多可以同时给出 kMaxSymbolsPerEntry 个短编码符号。
+class HuffmanDecodeTable {
+public:
+    static constexpr int kRootBits = 11;
+    static constexpr int kMaxSymbolsPerEntry = 4;
+    // 每次装载保证寄存器中有56位, 一级表与子表的一次查找最多消费 kRootBits 位, 因此装载一次可以连续查这么多次表
+    // (长编码跨过一级表时在 resolveLink 中另行装载)
+    static constexpr int kLookupsPerRefill = 56 / kRootBits;
+    // 每轮解码前输入窗口至少需要的字节数 (kLookupsPerRefill 个最长64位的编码 + 一次8字节装载)
+    static constexpr size_t kInputMargin = 64;
+    static_assert(kLookupsPerRefill * 64 / 8 + 8 <= kInputMargin, "input margin is too small");
+
+    // 由编码字构建查找表, 编码集合不是合法前缀码时抛出 std::runtime_error
+    void build(const HuffmanCodeword* codewords, size_t count);
+
+    // 解码最多 count 个符号写入 out, 输入窗口余量不足时提前返回, 返回实际解码的符号数。
+    // 遇到无效编码或读过输入末尾时抛出 std::runtime_error
+    size_t decode(BitReader& reader, unsigned char* out, size_t count) const;
+    // 同上, produced 随解码推进; 抛出异常时它是出错之前已写入 out 的符号数, 调用方据此保留已解码的部分
+    size_t decode(BitReader& reader, unsigned char* out, size_t count, size_t& produced) const;
+
+    // 交错解码 kInterleavedStreams 个互相独立的位流: 各位流轮流查表, 让处理器同时执行多条依赖链。
+    // 第 s 个位流恰好解码 count[s] 个符号写入 out[s]; 读取器必须覆盖完整的位流 (last 为 true),
+    // 任何一个位流无效或不足时抛出 std::runtime_error
+    static constexpr int kInterleavedStreams = 4;
+    void decodeInterleaved(BitReader* readers, unsigned char* const* out, const size_t* count) const;
+
+    int maxCodeLength() const { return max_code_length_; }
+
+private:
+    struct Entry {
+        unsigned char symbols[4];   // 最多4个符号, 子表链接时存放子表起始位置
+        unsigned char count;        // 符号个数, 0 表示子表链接或无效编码
+        unsigned char length;       // 消费的总位数
+        unsigned char first_length; // 第一个符号的编码长度
+        unsigned char sub_bits;     // 子表索引位数, 0 表示无效编码
+    };
+
+    struct TrieNode {
+        int child[2] = {-1, -1};
+        int symbol = -1;
+    };
+
+    struct PendingTable {
+        int node;
+        uint32_t offset;
+        int bits;
+    };
+
+    // 从 node 出发按 bits 位的前缀 pattern 向下走, 返回到达的节点, 遇到叶子提前停止
+    int walk(int node, uint32_t pattern, int bits, int& depth) const;
+    int subtreeDepth(int node) const;
+    // 为 node 分配子表并加入待填充列表, 返回指向它的链接表项; bits 为到达 node 已消费的位数
+    Entry linkSubTable(int node, int bits);
+    const Entry* resolveLink(BitReader& reader, const Entry* entry) const;
+    // 解码核心, 在编译期按位流数与有无子表特化, 装载与查表的循环完全展开; 各位流轮流查表, 相邻的查表之间没有数据依赖。
+    // 任一位流剩余的符号不足一轮或输入窗口余量不足时返回, produced 累加各位流解码的符号数 (抛出异常前也会更新)
+    template <int Streams, bool HasSubTables>
+    void decodeRounds(BitReader* readers, unsigned char* const* out, size_t* produced, const size_t* count) const;
+    // 按表的形状选用 decodeRounds 的特化
+    template <int Streams>
+    void dispatchRounds(BitReader* readers, unsigned char* const* out, size_t* produced, const size_t* count) const;
+
+    std::vector<TrieNode> trie_;
+    std::vector<Entry> entries_; // 前 2^kRootBits 项为一级表, 其后为子表
+    std::vector<PendingTable> pending_; // 构建时待填充的表, 与前两者一样在多次 build 之间复用容量
+    int max_code_length_ = 0;
+};
+
+#endif // HUFFMAN_DECODE_TABLE_H
@@ -1,25 +1,103 @@
-#ifndef HUFFMAN_DECOMPRESSOR_H
-#define HUFFMAN_DECOMPRESSOR_H
-
-#include <string>
-#include <fstream>
-#include <map>
-#include "Huffman.h"
-
-class HuffmanDecompressor {
-public:
-    HuffmanDecompressor();
-    void decompress(const std::string& input_filepath, const std::string& output_filepath);
-private:
-    HuffmanNode header_[512]; // 用于解压时存储哈夫曼表
-
-
-    void readFileHeader(std::ifstream& ifp, long& original_file_length, long& huffman_table_start_pos);
-    long readHuffmanTable(std::ifstream& ifp, long huffman_table_start_pos);
-    void sortHuffmanCodesByLength(long num_chars_in_table);
-    long decodeAndWriteData(std::ifstream& ifp, std::ofstream& ofp, long original_file_length, long num_chars_in_table);
-
-
-};
-
+#ifndef HUFFMAN_DECOMPRESSOR_H
+#define HUFFMAN_DECOMPRESSOR_H
+
+#include <functional>
+#include <iostream>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Huffman.h"
+#include "ByteIO.h"
+#include "HuffmanDecodeTable.h"
+#include "HuffmanFormat.h"
+#include "CompressionOptions.h"
+#include "CompressionStats.h"
+
+// 同一个对象可以反复用于任意多次解压: 编码表与临时缓冲区都保存在对象中并在调用之间复用,
+// 预热之后, 单线程或只有一个数据块的调用不再分配堆内存。对象不是线程安全的, 每个线程使用自己的对象
+class HuffmanDecompressor {
+public:
+    HuffmanDecompressor();
+    explicit HuffmanDecompressor(const DecompressionOptions& options);
+    // 输出为普通文件时预先分配并映射, 直接解码到映射中; 否则 (例如 /dev/stdout) 缓冲写入
+    void decompress(const std::string& input_filepath, const std::string& output_filepath);
+    // 同上, 解压后把输出文件以只读方式映射到 mapped_output, 调用方不必再读一遍文件即可使用结果
+    void decompress(const std::string& input_filepath, const std::string& output_filepath, MappedFileSource& mapped_output);
+    // 从任意输入源解压到任意输出端; 输入必须可映射或支持重新定位。
+    // 能预先得知原始长度 (旧格式或带块索引的分块格式) 且输出端支持 reserve 时, 一次预留全部输出并直接解码到其中
+    void decompress(ByteSource& input, ByteSink& output);
+    // 流式解压: 分块格式单遍顺序读取, 可以来自管道; 旧格式需要输入支持定位
+    void decompress(std::istream& input, std::ostream& output);
+    // 从已打开的文件描述符解压, 不会关闭它们
+    void decompress(int input_fd, int output_fd);
+    // 解压内存中的数据, 输出追加到 out 末尾
+    void decompress(const void* data, size_t size, std::vector<unsigned char>& out);
+    void decompress(std::string_view input, std::vector<unsigned char>& out);
+    // 解压到调用方提供的缓冲区, 返回写入的字节数; 容量不足时抛出 std::runtime_error
+    size_t decompress(const void* data, size_t size, void* dst, size_t dst_capacity);
+
+    // 只解压原始数据中 [offset, offset + length) 的部分, 超出末尾的部分被截去, 返回写入的字节数。
+    // 仅支持分块格式, 输入需支持随机访问; 有块索引时只读取与范围相交的块
+    size_t decompressRange(ByteSource& input, uint64_t offset, uint64_t length, ByteSink& output);
+    size_t decompressRange(const std::string& input_filepath, uint64_t offset, uint64_t length, std::vector<unsigned char>& out);
+    size_t decompressRange(const void* data, size_t size, uint64_t offset, uint64_t length, std::vector<unsigned char>& out);
+
+    // 只校验归档而不写出任何数据, 返回原始数据的总长度; 归档损坏时抛出 std::runtime_error。
+    // 分块格式带有块校验和时只比对各块负载的校验和与块索引, 不解码; 否则完整解码一遍并丢弃结果
+    uint64_t verify(ByteSource& input);
+    uint64_t verify(const std::string& input_filepath);
+    uint64_t verify(const void* data, size_t size);
+
+    const DecompressionOptions& options() const { return options_; }
+    void setOptions(const DecompressionOptions& options) { options_ = options; }
+
+    // 释放复用的缓冲区并清空统计信息, 选项与回调保持不变
+    void reset();
+
+    // 最近一次解压的统计信息, 只填写字节数、块数、线程数与 table_read、decode、total 耗时
+    const CompressionStats& stats() const { return stats_; }
+    // 每次解压结束时以统计信息调用 callback, 传入空函数取消
+    void setStatsCallback(StatsCallback callback) { stats_callback_ = std::move(callback); }
+
+    // 从压缩数据头部读出原始长度, 便于调用方预先分配输出缓冲区; 头部不完整时返回0
+    static size_t decompressedSize(const void* data, size_t size);
+private:
+    std::ostream* report_ = &std::cout; // 统计信息的输出位置; 输出可能是标准输出时改为标准错误
+    DecompressionOptions options_;
+    CompressionStats stats_;
+    StatsCallback stats_callback_;
+    // 以下表格与缓冲区在多次调用之间复用, 缓冲区只在需要更大的容量时才重新分配
+    HuffmanCodeword codewords_[256]; // 旧格式的哈夫曼表
+    HuffmanDecodeTable decode_table_; // 由哈夫曼表生成的查找表
+    std::vector<unsigned char> input_buf_;  // 未映射输入的读取缓冲区
+    std::vector<unsigned char> decode_buf_; // 解码输出缓冲区
+    std::vector<HuffmanFormat::IndexEntry> index_; // 分块格式的块索引
+
+
+    bool readFileHeader(ByteSource& input, long& original_file_length, long& huffman_table_start_pos);
+    long readHuffmanTable(ByteSource& input, long huffman_table_start_pos);
+    void buildDecodeTable(long num_chars_in_table);
+    // strict 为 false 时解码出错只打印错误并返回出错之前的长度, 为 true 时 (校验) 异常直接抛出
+    long decodeAndWriteData(ByteSource& input, ByteSink& output, long original_file_length, long huffman_table_start_pos, bool strict);
+    // decompress(ByteSource&, ByteSink&) 的实现; strict 为 true 时 (校验) 任何损坏都抛出 std::runtime_error,
+    // 包括解码的长度与头部或块索引记录的原始长度不符、块索引损坏
+    void decompressImpl(ByteSource& input, ByteSink& output, bool strict);
+    // 分块格式: 文件头已读出, 从第一个块开始解码
+    void decompressChunked(ByteSource& input, ByteSink& output, const HuffmanFormat::FileHeader& file_header, bool strict);
+    // 从 start_offset 处的块开始顺序读取最多 max_blocks 个块 (遇到结束块提前停止), 多线程解码后按原顺序交给 emit。
+    // table_offset 不为0时先读入该处的块的编码表, 供开头沿用编码表的块使用。
+    // dst 不为空时各块依次直接解码到 dst 中 (emit 收到的即 dst 中的位置), 超出 dst_size 时抛出 std::runtime_error。
+    // 未映射的输入需已定位到 start_offset; 返回处理的块数。块数、线程数、耗时与读到的位置记入 stats_
+    size_t decodeBlocks(ByteSource& input, uint64_t start_offset, const HuffmanFormat::FileHeader& file_header, size_t max_blocks, uint64_t table_offset,
+                        unsigned char* dst, size_t dst_size, const std::function<void(const unsigned char*, size_t)>& emit);
+    // 文件头声明的字典, 没有使用字典时返回空; options_ 中找不到该字典时抛出 std::runtime_error
+    const HuffmanDictionary* findDictionary(const HuffmanFormat::FileHeader& file_header) const;
+    // 填写总耗时, 调用回调
+    void finishStats(double total_seconds);
+
+
+};
+
 #endif // HUFFMAN_DECOMPRESSOR_H
\ No newline at end of file
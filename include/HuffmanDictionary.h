@@ -0,0 +1,47 @@
+#ifndef HUFFMAN_DICTIONARY_H
+#define HUFFMAN_DICTIONARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "Huffman.h"
+#include "HuffmanEncodeTable.h"
+#include "HuffmanDecodeTable.h"
+
+// 由样本语料预先训练的静态哈夫曼编码表, 适合大量相似的小消息。
+// 压缩时使用字典的块不统计频率、不建树也不写编码表, 归档头部只记录字典 ID; 解压时直接使用字典中建好的查找表。
+// 字典为全部256个字节值都分配了编码, 样本中没有出现的字节也能编码。构建完成后只读, 可以在多个线程之间共享
+class HuffmanDictionary {
+public:
+    static constexpr unsigned kDefaultMaxCodeLength = 15;
+    // 序列化格式: "TRHD", 版本, 小端32位 ID, 按字节值顺序的256个编码长度
+    static constexpr size_t kSerializedSize = 4 + 1 + 4 + 256;
+
+    // 由样本训练字典: 各样本的字节频率加1后建树, 最长编码不超过 max_code_length (8..64)。
+    // id 为0时由编码长度的散列值生成, 相同的编码表总是得到相同的 ID
+    static HuffmanDictionary train(const std::vector<std::string_view>& samples, uint32_t id = 0, unsigned max_code_length = kDefaultMaxCodeLength);
+    // 由以字节值为下标的频率生成字典, 频率为0的字节同样分配编码
+    static HuffmanDictionary fromCounts(const uint64_t* counts, uint32_t id = 0, unsigned max_code_length = kDefaultMaxCodeLength);
+
+    std::vector<unsigned char> serialize() const;
+    // 数据不是有效的字典时抛出 std::runtime_error
+    static HuffmanDictionary deserialize(const void* data, size_t size);
+
+    uint32_t id() const { return id_; }
+    int codeLength(unsigned char byte) const { return lengths_[byte]; }
+    const HuffmanEncodeTable& encodeTable() const { return encode_table_; }
+    const HuffmanDecodeTable& decodeTable() const { return decode_table_; }
+
+private:
+    HuffmanDictionary() = default;
+    // 由编码长度分配规范编码并生成编码表与查找表, 长度不构成前缀码时抛出 std::runtime_error
+    void build(const unsigned char* lengths, uint32_t id);
+
+    uint32_t id_ = 0;
+    unsigned char lengths_[256] = {};
+    HuffmanEncodeTable encode_table_;
+    HuffmanDecodeTable decode_table_;
+};
+
+#endif // HUFFMAN_DICTIONARY_H
@@ -0,0 +1,34 @@
+#ifndef HUFFMAN_ENCODE_TABLE_H
+#define HUFFMAN_ENCODE_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Huffman.h"
+#include "BitStream.h"
+
+// 以字节值为下标的扁平编码表, 编码以 (数值, 长度) 形式保存, 供整数位打包的编码核心使用
+class HuffmanEncodeTable {
+public:
+    // 由编码字构建编码表, 未出现的字节编码长度为0
+    void build(const HuffmanCodeword* codewords, size_t count);
+
+    // 把 in 中的 n 个字节编码写入 writer。
+    // 调用方需保证缓冲区剩余空间不少于 maxEncodedSize(n)
+    void encode(const unsigned char* in, size_t n, BitWriter& writer) const;
+
+    // n 个字节编码后最多占用的字节数 (含 BitWriter 的尾部余量)
+    size_t maxEncodedSize(size_t n) const {
+        return (n * static_cast<size_t>(max_length_) + 7) / 8 + BitWriter::kSlack + 1;
+    }
+
+    int maxLength() const { return max_length_; }
+    uint64_t code(unsigned char byte) const { return code_[byte]; }
+    int length(unsigned char byte) const { return length_[byte]; }
+
+private:
+    uint64_t code_[256] = {};
+    unsigned char length_[256] = {};
+    int max_length_ = 0;
+};
+
+#endif // HUFFMAN_ENCODE_TABLE_H
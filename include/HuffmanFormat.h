@@ -0,0 +1,212 @@
+#ifndef HUFFMAN_FORMAT_H
+#define HUFFMAN_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ByteIO.h"
+#include "HuffmanDecodeTable.h"
+#include "HuffmanEncodeTable.h"
+#include "CompressionOptions.h"
+#include "CompressionStats.h"
+
+// 分块容器格式 (版本1)
+//
+// 文件头 (8字节): "TRHF" 版本 标志 log2(最大块大小) 0x1A
+//   旧格式的前8字节是小端的原始长度, 最高字节总为0, 而这里第8字节固定为 0x1A, 两者不会混淆
+//   标志 kFlagDictionary: 文件头之后紧跟所用字典的 ID (u32)
+// 数据块: 块类型(1字节) 原始长度(varint) 负载长度(varint) [负载的 CRC32C (u32), 标志 kFlagChecksum] 负载
+//   哈夫曼块的负载: 编码表类型(1字节) 编码表 位流; 使用字典或沿用之前编码表的块没有编码表
+//   四路交错块的负载: 编码表类型 编码表 前3个位流的字节数(各 u32) 4个位流;
+//     原始数据按 ceil(原始长度/4) 均分为4段, 每段各自编码为一个位流
+//   原样块的负载即原始数据; 游程块的负载为1字节, 原始数据是它重复原始长度次
+//   上下文块的负载: 编码表数K(1字节) 位流数(1字节, 1或4) 上下文映射(128字节) K张 kTableCanonical 编码表
+//     [前3个位流的字节数, 4个位流时] 位流; 每个字节用它前一个字节所属组的编码表编码, 每个位流以上下文0开始
+//   LZ 块的负载: 字面量个数L(varint) 序列数(varint) [L > 0 时: 字面量位流数(1字节, 1或4) 字面量编码表
+//     [前3个位流的字节数, 4个位流时] 字面量位流的总字节数(varint) 字面量位流] 令牌编码表 距离编码表 序列位流;
+//     编码表均为 kTableCanonical, 序列的编码见 LzCodec.h
+//   tANS 块的负载: 归一化频率表 位流, 格式见 AnsCodec.h
+// 结束块: 块类型 kBlockEnd
+// 块索引 (标志 kFlagBlockIndex): 每块 { 块偏移 u64, 原始长度 u32 },
+//   之后是尾部 { 原始总长度 u64, 索引偏移 u64, 块数 u32, "TRHX" }
+// 多字节定长字段均为小端序
+namespace HuffmanFormat {
+    constexpr unsigned char kMagic[4] = {'T', 'R', 'H', 'F'};
+    constexpr unsigned char kFooterMagic[4] = {'T', 'R', 'H', 'X'};
+    constexpr unsigned char kVersion = 1;
+    constexpr unsigned char kHeaderTerminator = 0x1A;
+    constexpr size_t kFileHeaderSize = 8;
+    constexpr size_t kDictionaryIdSize = 4;
+    constexpr size_t kChecksumSize = 4;
+    constexpr size_t kIndexEntrySize = 12;
+    constexpr size_t kFooterSize = 24;
+    constexpr int kMaxBlockSizeLog2 = 30;
+
+    enum Flags : unsigned char {
+        kFlagBlockIndex = 0x01,
+        kFlagDictionary = 0x02,
+        kFlagChecksum = 0x04, // 每个数据块的块头带有负载的 CRC32C
+    };
+
+    enum BlockType : unsigned char {
+        kBlockEnd = 0,
+        kBlockHuffman = 1,
+        kBlockHuffman4 = 2, // 四路交错位流
+        kBlockRaw = 3,      // 不压缩, 用于编码后不会变小的数据
+        kBlockRle = 4,      // 整块只有一种字节
+        kBlockContext = 5,  // 1阶上下文: 按前一个字节选用编码表, 见 HuffmanContextModel.h
+        kBlockLz = 6,       // LZ77 序列与字面量分别做哈夫曼编码, 见 LzCodec.h
+        kBlockAns = 7,      // tANS 编码, 见 AnsCodec.h
+    };
+
+    constexpr int kInterleavedStreams = HuffmanDecodeTable::kInterleavedStreams;
+    // 小于该长度的块不值得拆成多个位流
+    constexpr size_t kMinInterleavedBlockSize = 1024;
+    // 小于该长度的块摊不开多张编码表, 不尝试上下文块
+    constexpr size_t kMinContextBlockSize = 4096;
+    // 小于该长度的块摊不开 LZ 块的三张编码表, 不尝试 LZ 块
+    constexpr size_t kMinLzBlockSize = 256;
+
+    // 哈夫曼块负载中编码表的存储方式
+    enum TableKind : unsigned char {
+        kTableExplicit = 0,  // 字符数-1, 每个字符 { 字符, 编码长度, 补齐到整字节的编码 }
+        kTableCanonical = 1, // 规范哈夫曼编码, 只存储按字节值顺序游程编码的长度向量:
+                             //   0x00..0x40 为下一个字符的编码长度, 0x80 + k 表示接下来 k+1 个字符未出现;
+                             //   长度0只出现在只有一种字符的块中
+        kTableDictionary = 2, // 使用文件头中记录的字典, 负载中不存储编码表
+        kTableRepeat = 3,     // 沿用之前最近一个自带编码表 (kTableExplicit 或 kTableCanonical) 的块的编码表
+    };
+
+    struct FileHeader {
+        unsigned char version = kVersion;
+        unsigned char flags = 0;
+        unsigned char block_size_log2 = 20;
+        uint32_t dictionary_id = 0; // 仅在设置 kFlagDictionary 时有效
+    };
+
+    // 文件头连同字典 ID 的总字节数, 即第一个块的偏移
+    inline size_t fileHeaderSize(const FileHeader& header) {
+        return kFileHeaderSize + ((header.flags & kFlagDictionary) ? kDictionaryIdSize : 0);
+    }
+
+    struct IndexEntry {
+        uint64_t offset = 0;   // 块在文件中的偏移 (块类型字节的位置)
+        uint32_t raw_size = 0; // 块的原始长度
+    };
+
+    struct BlockHeader {
+        unsigned char type = kBlockEnd;
+        uint64_t raw_size = 0;
+        uint64_t payload_size = 0;
+        uint32_t checksum = 0; // 仅在文件头设置 kFlagChecksum 时有效
+    };
+
+    struct Footer {
+        uint64_t total_raw_size = 0;
+        uint64_t index_offset = 0;
+        uint32_t block_count = 0;
+    };
+
+    inline void storeLE32(unsigned char* p, uint32_t v) {
+        for (int i = 0; i < 4; ++i) p[i] = static_cast<unsigned char>(v >> (8 * i));
+    }
+    inline void storeLE64(unsigned char* p, uint64_t v) {
+        for (int i = 0; i < 8; ++i) p[i] = static_cast<unsigned char>(v >> (8 * i));
+    }
+    inline uint32_t loadLE32(const unsigned char* p) {
+        uint32_t v = 0;
+        for (int i = 3; i >= 0; --i) v = (v << 8) | p[i];
+        return v;
+    }
+    inline uint64_t loadLE64(const unsigned char* p) {
+        uint64_t v = 0;
+        for (int i = 7; i >= 0; --i) v = (v << 8) | p[i];
+        return v;
+    }
+
+    void writeVarint(std::vector<unsigned char>& out, uint64_t value);
+    size_t varintSize(uint64_t value);
+
+    // 块负载是否自带编码表 / 是否沿用之前的编码表
+    inline bool blockHasCodeTable(unsigned char type, const unsigned char* payload, size_t payload_size) {
+        return (type == kBlockHuffman || type == kBlockHuffman4) && payload_size > 0 && (payload[0] == kTableExplicit || payload[0] == kTableCanonical);
+    }
+    inline bool blockRepeatsCodeTable(unsigned char type, const unsigned char* payload, size_t payload_size) {
+        return (type == kBlockHuffman || type == kBlockHuffman4) && payload_size > 0 && payload[0] == kTableRepeat;
+    }
+
+    // 判断前8字节是否为分块格式的文件头
+    bool isChunkedHeader(const unsigned char* data, size_t size);
+    void writeFileHeader(std::vector<unsigned char>& out, const FileHeader& header);
+    // 解析前 kFileHeaderSize 字节, 字典 ID 由调用方随后读出; 文件头无效或版本、标志不支持时抛出 std::runtime_error
+    FileHeader parseFileHeader(const unsigned char* data);
+
+    void writeIndex(std::vector<unsigned char>& out, const std::vector<IndexEntry>& index, const Footer& footer);
+    Footer parseFooter(const unsigned char* data);
+
+    // 编码一块时收集的统计信息
+    struct BlockEncodeStats {
+        uint64_t counts[256];          // 块内各字节值的频率, 使用字典编码的块不统计频率, 全为0
+        uint64_t payload_bits = 0;     // 各位流的总位数, 不含补齐
+        unsigned max_code_length = 0;  // 块内哈夫曼编码的最长位数, ANS 与 RLE 块为0
+        PhaseTimings timings;          // 填写 histogram 到 table_write 各阶段
+        unsigned char block_type = kBlockEnd; // 实际写出的块类型
+        unsigned char table_kind = 0;         // 哈夫曼块的编码表类型
+        unsigned char code_lengths[256];      // 自带编码表时以字节值为下标的编码长度, 后续块可以沿用
+    };
+
+    // 把一块数据编码为完整的块 (含块头) 追加到 out。由频率估算各种写法的长度, 选择最短的一种:
+    // 只有一种字节时写游程块, 否则在新编码表 (类型与最长编码由 options 决定)、原样块, 以及 previous 不为空时
+    // 沿用 previous 这张之前的编码表之间选择; options.ans_coding 为 true、options.lz_level 大于0、options.context_tables 大于1时
+    // 还分别实际编码一次 tANS 块、LZ 块与上下文块参与比较。设置了字典时优先使用字典的编码。stats 不为空时填入该块的统计信息
+    void encodeBlock(const unsigned char* data, size_t size, std::vector<unsigned char>& out, const CompressionOptions& options,
+                     BlockEncodeStats* stats = nullptr, const HuffmanEncodeTable* previous = nullptr);
+    // 频率为 counts 的 size 字节沿用 previous 编码时块的估计长度 (含块头, 不小于实际长度), 无法沿用时返回 SIZE_MAX。
+    // encodeBlock 只在它小于其他写法的长度时沿用编码表
+    size_t estimateRepeatBlockSize(const uint64_t* counts, size_t size, const HuffmanEncodeTable& previous, const CompressionOptions& options);
+
+    // 由自带编码表的块的负载建立解码表, 编码表损坏时抛出 std::runtime_error
+    void buildBlockTable(const unsigned char* payload, size_t payload_size, HuffmanDecodeTable& table);
+    // 解码一块的负载, 恰好输出 raw_size 字节。table 保存最近一个自带编码表的块的解码表: 解码这样的块时替换它并把
+    // table_ready 置为 true, 沿用编码表的块在 table_ready 为 false 时抛出 std::runtime_error。
+    // timings 不为空时把读表与解码耗时累加到 table_read 与 decode。
+    // 使用字典的块直接用 dictionary 的查找表, dictionary 为空时抛出 std::runtime_error
+    void decodeBlock(unsigned char block_type, const unsigned char* payload, size_t payload_size, unsigned char* out, size_t raw_size,
+                     HuffmanDecodeTable& table, bool& table_ready, PhaseTimings* timings = nullptr, const HuffmanDictionary* dictionary = nullptr);
+
+    // size 字节的输入编码为哈夫曼块后最多占用的字节数 (含块头, 不含校验和)
+    size_t maxBlockSize(size_t size);
+    // 块头 (类型, 原始长度, 负载长度) 之后的位置, 即校验和插入的位置; block 为 encodeBlock 写出的完整块
+    size_t blockHeaderLength(const unsigned char* block);
+
+    // 不小于 block_size 的最小2的幂的指数; block_size 为0或超过 2^kMaxBlockSizeLog2 时抛出 std::runtime_error
+    unsigned char blockSizeLog2(size_t block_size);
+
+    // 顺序读取块流: 映射输入时直接返回映射内存中的指针, 否则读入内部缓冲区
+    class BlockStreamReader {
+    public:
+        BlockStreamReader(ByteSource& input, uint64_t start_offset);
+
+        // 读取 n 字节, 返回的指针在下一次调用前有效; 输入提前结束时抛出 std::runtime_error
+        const unsigned char* take(size_t n);
+        unsigned char takeByte();
+        uint64_t takeVarint();
+        // 跳过 n 字节, 未映射的输入优先重新定位
+        void skip(uint64_t n);
+        uint64_t position() const { return position_; }
+
+    private:
+        ByteSource& input_;
+        uint64_t position_;
+        std::vector<unsigned char> scratch_;
+    };
+
+    // 读取块头 (含校验和), 结束块只读出类型; 块类型未知或长度超出文件头声明的上限时抛出 std::runtime_error
+    BlockHeader readBlockHeader(BlockStreamReader& reader, const FileHeader& file_header);
+
+    // 读取并校验文件末尾的块索引, 输入需支持随机访问且长度已知。
+    // 归档没有块索引时返回 false, 索引损坏时抛出 std::runtime_error
+    bool readBlockIndex(ByteSource& input, const FileHeader& file_header, std::vector<IndexEntry>& index, Footer& footer);
+}
+
+#endif // HUFFMAN_FORMAT_H
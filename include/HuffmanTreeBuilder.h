@@ -0,0 +1,38 @@
+#ifndef HUFFMAN_TREE_BUILDER_H
+#define HUFFMAN_TREE_BUILDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Huffman.h"
+
+// 两队列哈夫曼建树: 叶子按频率升序排好后, 新建的内部节点频率单调不减,
+// 每次合并只需比较两个队列的队首, 排序之后建树为线性时间。
+// 节点存放在对象内的定长数组中, 同一个对象可以在多个块之间反复使用而不分配内存。
+class HuffmanTreeBuilder {
+public:
+    // 由以字节值为下标的频率求每个字符的编码长度 (未出现的字符为0, 只有一种字符时也为0), 返回不同字符的数量
+    int buildLengths(const uint64_t* counts, unsigned char* lengths);
+
+    // 求编码长度, 最长编码超过 max_length (0 表示只受64位的限制) 时改用 package-merge,
+    // 然后分配规范编码写入 codewords (至少256个元素), 返回字符数
+    size_t buildCodewords(const uint64_t* counts, int max_length, HuffmanCodeword* codewords);
+    // buildCodewords 的后半部分: 由 buildLengths 求出的编码长度限制长度并分配规范编码, 返回字符数
+    static size_t assignCodewords(const uint64_t* counts, const unsigned char* lengths, int max_length, HuffmanCodeword* codewords);
+
+    // 旧格式的编码, 与最初的实现逐位相同, 旧格式的输出因此不变: 叶子按频率降序排序 (相同频率的顺序也与之相同),
+    // 每次合并列表中频率最小且最靠前的两个节点, 字节值较小的作左子节点 (内部节点的字节值视为0), 左0右1;
+    // 只有一种字符时编码长度为0。编码按排序后的叶子顺序写入 codewords, 返回字符数;
+    // 最长编码超过 max_length (0 表示只受64位的限制) 时返回0, 由调用方改用 buildCodewords
+    size_t buildLegacyCodewords(const uint64_t* counts, int max_length, HuffmanCodeword* codewords);
+
+private:
+    struct Node {
+        uint64_t count;
+        int32_t parent; // 建树完成后改存节点深度
+        int32_t symbol; // 叶子的字节值, 内部节点为 -1
+    };
+
+    Node nodes_[511]; // 前 n 个为叶子, 其后 n-1 个为按创建顺序排列的内部节点
+};
+
+#endif // HUFFMAN_TREE_BUILDER_H
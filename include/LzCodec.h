@@ -0,0 +1,103 @@
+#ifndef LZ_CODEC_H
+#define LZ_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Huffman.h"
+#include "BitStream.h"
+#include "HuffmanDecodeTable.h"
+#include "HuffmanTreeBuilder.h"
+
+// LZ77 前端: 块内的重复片段改写为 (字面量个数, 匹配长度, 距离) 序列, 字面量与序列再分别做哈夫曼编码。
+// 序列的三个量用两个字母表: 令牌的高4位是字面量个数的长度码、低4位是匹配长度的长度码; 距离码单独一个字母表。
+// 长度码 0..7 即数值本身, 8..15 后跟 kLengthExtraBits 位附加值; 距离码0表示沿用上一个距离,
+// k >= 1 表示距离在 [2^(k-1), 2^k) 内, 后跟 k-1 位附加值。匹配只在块内查找, 每块的初始距离为1
+namespace LzCodec {
+    constexpr int kMinMatch = 4;
+    constexpr int kMaxLevel = 9;
+    // 令牌与距离的编码长度上限, 解码时一次查表
+    constexpr int kMaxCodeLength = HuffmanDecodeTable::kRootBits;
+    constexpr int kNumDistanceCodes = 32;
+    constexpr unsigned char kLengthExtraBits[16] = {0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 4, 5, 7, 9, 12, 30};
+    constexpr uint32_t kLengthBase[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 20, 36, 68, 196, 708, 4804};
+
+    inline unsigned lengthCode(uint32_t value) {
+        unsigned code = value < 8 ? value : 8;
+        while (code < 15 && value >= kLengthBase[code + 1]) {
+            ++code;
+        }
+        return code;
+    }
+    inline unsigned distanceCode(uint32_t distance) {
+        return 32 - static_cast<unsigned>(__builtin_clz(distance)); // distance >= 1
+    }
+}
+
+struct LzSequence {
+    uint32_t literals;     // 匹配之前的字面量个数
+    uint32_t match_length; // 不小于 kMinMatch
+    uint32_t distance;     // 1..当前位置
+};
+
+// 哈希链匹配查找。级别 1..kMaxLevel: 级别越高, 每个位置沿哈希链比较的候选越多,
+// 4级起改为惰性匹配 (下一个位置的匹配更长时先输出一个字面量)。哈希表与链在多次调用之间复用
+class LzMatchFinder {
+public:
+    // 把 data 拆成序列追加到 sequences, 返回最后一个匹配之后剩余的字面量个数
+    size_t parse(const unsigned char* data, size_t size, int level, std::vector<LzSequence>& sequences);
+
+private:
+    static constexpr int kHashBits = 16;
+
+    std::vector<int32_t> head_;  // 各哈希值最近出现的位置
+    std::vector<int32_t> chain_; // 同一哈希值上一次出现的位置
+};
+
+// 由序列统计令牌与距离码的频率, 建立受限长度的规范编码并写出序列位流
+class LzSequenceEncoder {
+public:
+    // 统计频率并建表, 返回编码全部序列的总位数
+    uint64_t build(const LzSequence* sequences, size_t count);
+
+    const HuffmanCodeword* tokenCodewords() const { return token_codewords_; }
+    size_t numTokenCodewords() const { return num_token_codewords_; }
+    const HuffmanCodeword* distanceCodewords() const { return distance_codewords_; }
+    size_t numDistanceCodewords() const { return num_distance_codewords_; }
+
+    // 调用方需保证缓冲区剩余空间不少于 maxEncodedSize(count)
+    void encode(const LzSequence* sequences, size_t count, BitWriter& writer) const;
+    static size_t maxEncodedSize(size_t count) {
+        return count * 16 + BitWriter::kSlack + 1; // 每个序列最多 11 + 30 + 30 + 11 + 29 位
+    }
+
+private:
+    uint64_t token_counts_[256];
+    uint64_t distance_counts_[256];
+    HuffmanCodeword token_codewords_[256];
+    HuffmanCodeword distance_codewords_[256];
+    size_t num_token_codewords_ = 0;
+    size_t num_distance_codewords_ = 0;
+    uint32_t token_entries_[256];    // 编码 << 4 | 长度
+    uint32_t distance_entries_[256];
+    HuffmanTreeBuilder builder_;
+};
+
+class LzSequenceDecoder {
+public:
+    // 编码超过 kMaxCodeLength 位或不是合法前缀码时抛出 std::runtime_error
+    void buildTokenTable(const HuffmanCodeword* codewords, size_t count);
+    void buildDistanceTable(const HuffmanCodeword* codewords, size_t count);
+
+    // 解码 count 个序列并执行: 依次复制字面量与匹配, 最后复制剩余的字面量, 恰好输出 out_size 字节。
+    // 序列无效、字面量个数不符或读过位流末尾时抛出 std::runtime_error
+    void decode(BitReader& reader, size_t count, const unsigned char* literals, size_t num_literals, unsigned char* out, size_t out_size) const;
+
+private:
+    static constexpr uint16_t kInvalid = 0xFFFF;
+
+    uint16_t token_entries_[1 << LzCodec::kMaxCodeLength];    // 长度 << 8 | 符号
+    uint16_t distance_entries_[1 << LzCodec::kMaxCodeLength];
+};
+
+#endif // LZ_CODEC_H
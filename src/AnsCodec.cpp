@@ -0,0 +1,313 @@
+#include "AnsCodec.h"
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using AnsCodec::kMaxTableLog;
+using AnsCodec::kMinTableLog;
+using AnsCodec::kStates;
+
+namespace {
+
+inline int highBit(uint32_t value) {
+    return 31 - __builtin_clz(value); // value >= 1
+}
+
+// 按固定步长把各字节散布到 2^table_log 个状态上; 步长为奇数, 每个位置恰好走到一次
+void spreadSymbols(const uint16_t* normalized, int table_log, unsigned char* symbols) {
+    const uint32_t size = 1u << table_log;
+    const uint32_t mask = size - 1;
+    const uint32_t step = (size >> 1) + (size >> 3) + 3;
+    uint32_t pos = 0;
+    for (int c = 0; c < 256; ++c) {
+        for (uint32_t i = 0; i < normalized[c]; ++i) {
+            symbols[pos] = static_cast<unsigned char>(c);
+            pos = (pos + step) & mask;
+        }
+    }
+}
+
+// 从后往前写的位写入器: 后写的位排在前面, 正向读取时与 BitReader 一致 (高位在前)。
+// flush() 每次在当前位置之前写8字节, 因此缓冲区开头需要预留 kSlack 字节
+class BackwardBitWriter {
+public:
+    explicit BackwardBitWriter(unsigned char* end) : ptr_(end) {}
+
+    // 寄存器中的位数加 len 不能超过64
+    void put(uint32_t value, int len) {
+        bits_ |= static_cast<uint64_t>(value) << count_;
+        count_ += len;
+    }
+
+    void flush() {
+        storeBigEndian64(ptr_ - 8, bits_);
+        ptr_ -= count_ >> 3;
+        bits_ >>= count_ & ~7;
+        count_ &= 7;
+    }
+
+    // 写出最后不足一字节的位 (高位补0), 返回位流的起点
+    unsigned char* finish() {
+        flush();
+        if (count_ > 0) {
+            *--ptr_ = static_cast<unsigned char>(bits_);
+        }
+        return ptr_;
+    }
+
+private:
+    unsigned char* ptr_;
+    uint64_t bits_ = 0;
+    int count_ = 0;
+};
+
+} // namespace
+
+uint64_t AnsEncoder::build(const uint64_t* counts, size_t total) {
+    int distinct = 0;
+    for (int c = 0; c < 256; ++c) {
+        distinct += counts[c] > 0 ? 1 : 0;
+    }
+    // 表不必比数据长很多, 但每个出现的字节至少占一个状态
+    int table_log = kMinTableLog;
+    while (table_log < kMaxTableLog && ((static_cast<size_t>(1) << table_log) < total || (1 << table_log) < 2 * distinct)) {
+        ++table_log;
+    }
+    table_log_ = table_log;
+    const uint32_t size = 1u << table_log;
+
+    // 1. 按比例取整, 每个出现的字节至少为1; 再逐个增减, 每次选编码长度变化最小的字节, 使总和恰为 2^L
+    int64_t sum = 0;
+    for (int c = 0; c < 256; ++c) {
+        uint64_t scaled = counts[c] == 0 ? 0 : (counts[c] * size + total / 2) / total;
+        normalized_[c] = static_cast<uint16_t>(counts[c] == 0 ? 0 : (scaled == 0 ? 1 : scaled));
+        sum += normalized_[c];
+    }
+    while (sum > size) {
+        int best = -1;
+        double best_cost = 0.0;
+        for (int c = 0; c < 256; ++c) {
+            if (normalized_[c] > 1) {
+                double cost = static_cast<double>(counts[c]) / (normalized_[c] - 0.5);
+                if (best < 0 || cost < best_cost) {
+                    best = c;
+                    best_cost = cost;
+                }
+            }
+        }
+        normalized_[best]--;
+        sum--;
+    }
+    while (sum < size) {
+        int best = -1;
+        double best_gain = 0.0;
+        for (int c = 0; c < 256; ++c) {
+            if (normalized_[c] > 0) {
+                double gain = static_cast<double>(counts[c]) / (normalized_[c] + 0.5);
+                if (best < 0 || gain > best_gain) {
+                    best = c;
+                    best_gain = gain;
+                }
+            }
+        }
+        normalized_[best]++;
+        sum++;
+    }
+
+    // 2. 状态表: 各字节的状态按散布位置的顺序连续存放
+    unsigned char symbols[1 << kMaxTableLog];
+    spreadSymbols(normalized_, table_log, symbols);
+    uint32_t next[256];
+    uint32_t start = 0;
+    for (int c = 0; c < 256; ++c) {
+        next[c] = start;
+        uint32_t n = normalized_[c];
+        if (n > 0) {
+            // 状态 x 输出若干位后落在 [n, 2n) 内; x >= n << max_bits 时输出 max_bits 位, 否则少一位
+            int max_bits = table_log - (n == 1 ? 0 : highBit(n - 1));
+            transforms_[c].delta_bits = (static_cast<uint32_t>(max_bits) << 16) - (n << max_bits);
+            transforms_[c].delta_state = static_cast<int32_t>(start) - static_cast<int32_t>(n);
+        }
+        start += n;
+    }
+    for (uint32_t u = 0; u < size; ++u) {
+        states_[next[symbols[u]]++] = static_cast<uint16_t>(size + u);
+    }
+
+    double bits = 0.0;
+    for (int c = 0; c < 256; ++c) {
+        if (counts[c] > 0) {
+            bits += static_cast<double>(counts[c]) * (table_log - std::log2(static_cast<double>(normalized_[c])));
+        }
+    }
+    return static_cast<uint64_t>(bits) + kStates * static_cast<uint64_t>(table_log) + 8;
+}
+
+size_t AnsEncoder::writeTable(unsigned char* out) const {
+    unsigned char* p = out;
+    *p++ = static_cast<unsigned char>(table_log_);
+    uint32_t sum = 0;
+    const uint32_t size = 1u << table_log_;
+    for (int c = 0; c < 256 && sum < size;) {
+        if (normalized_[c] > 0) {
+            uint32_t n = normalized_[c++];
+            sum += n;
+            while (n >= 0x80) {
+                *p++ = static_cast<unsigned char>(n | 0x80);
+                n >>= 7;
+            }
+            *p++ = static_cast<unsigned char>(n);
+            continue;
+        }
+        int run = 0;
+        while (c < 256 && normalized_[c] == 0 && run < 256) {
+            ++c;
+            ++run;
+        }
+        *p++ = 0;
+        *p++ = static_cast<unsigned char>(run - 1);
+    }
+    return static_cast<size_t>(p - out);
+}
+
+size_t AnsEncoder::encode(const unsigned char* in, size_t n, unsigned char* out) const {
+    const uint32_t size = 1u << table_log_;
+    uint32_t state[kStates] = {size, size, size, size};
+    unsigned char* end = out + maxEncodedSize(n);
+    BackwardBitWriter writer(end);
+
+    auto put = [&](int k, unsigned char c) {
+        const SymbolTransform& t = transforms_[c];
+        uint32_t bits = (state[k] + t.delta_bits) >> 16;
+        writer.put(state[k] & ((1u << bits) - 1), static_cast<int>(bits));
+        state[k] = states_[static_cast<int32_t>(state[k] >> bits) + t.delta_state];
+    };
+
+    // 逆序编码, 第 i 个字节用状态 i % kStates; 每轮最多 4 * kMaxTableLog = 48 位
+    size_t i = n;
+    while (i % kStates != 0) {
+        --i;
+        put(static_cast<int>(i % kStates), in[i]);
+        writer.flush();
+    }
+    while (i > 0) {
+        i -= kStates;
+        put(3, in[i + 3]);
+        put(2, in[i + 2]);
+        put(1, in[i + 1]);
+        put(0, in[i]);
+        writer.flush();
+    }
+    for (int k = kStates - 1; k >= 0; --k) {
+        writer.put(state[k] - size, table_log_);
+        writer.flush();
+    }
+    writer.put(1, 1);
+    unsigned char* begin = writer.finish();
+    const size_t written = static_cast<size_t>(end - begin);
+    std::memmove(out, begin, written);
+    return written;
+}
+
+const unsigned char* AnsDecoder::readTable(const unsigned char* p, const unsigned char* end) {
+    if (p == end || *p < kMinTableLog || *p > kMaxTableLog) {
+        throw std::runtime_error("Error: block is corrupted");
+    }
+    const int table_log = *p++;
+    const uint32_t size = 1u << table_log;
+    uint16_t normalized[256] = {0};
+    uint32_t sum = 0;
+    for (int c = 0; sum < size;) {
+        if (p == end || c >= 256) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        if (*p == 0) {
+            if (end - p < 2) {
+                throw std::runtime_error("Error: block is corrupted");
+            }
+            c += p[1] + 1;
+            p += 2;
+            continue;
+        }
+        uint32_t n = 0;
+        for (int shift = 0;; shift += 7) {
+            if (p == end || shift > 14) {
+                throw std::runtime_error("Error: block is corrupted");
+            }
+            unsigned char byte = *p++;
+            n |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        if (n > size - sum) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        normalized[c++] = static_cast<uint16_t>(n);
+        sum += n;
+    }
+
+    unsigned char symbols[1 << kMaxTableLog];
+    spreadSymbols(normalized, table_log, symbols);
+    uint32_t next[256];
+    for (int c = 0; c < 256; ++c) {
+        next[c] = normalized[c];
+    }
+    for (uint32_t u = 0; u < size; ++u) {
+        unsigned char c = symbols[u];
+        uint32_t x = next[c]++;
+        int bits = table_log - highBit(x);
+        entries_[u].next = static_cast<uint16_t>((x << bits) - size);
+        entries_[u].symbol = c;
+        entries_[u].bits = static_cast<unsigned char>(bits);
+    }
+    table_log_ = table_log;
+    return p;
+}
+
+void AnsDecoder::decode(BitReader& reader, unsigned char* out, size_t count) const {
+    // 在局部副本上解码: 写出的字节不会与 reader 的成员重叠, 编译器可以把位缓冲与状态都留在寄存器中
+    BitReader bits = reader;
+    // 开头的若干个0与一个1最多8位, 加上初始状态不超过装载保证的56位
+    bits.refill();
+    const uint32_t marker = bits.peek(8);
+    if (marker == 0) {
+        throw std::runtime_error("Error: block is corrupted");
+    }
+    bits.consume(__builtin_clz(marker) - 24 + 1);
+    uint32_t state[kStates];
+    for (int k = 0; k < kStates; ++k) {
+        state[k] = bits.peek(table_log_);
+        bits.consume(table_log_);
+    }
+
+    // 状态总在 [0, 2^L) 内, 无论输入如何查表都不会越界
+    auto step = [&](uint32_t& x) {
+        const Entry e = entries_[x];
+        x = e.next + bits.peekBits(e.bits);
+        bits.consume(e.bits);
+        return e.symbol;
+    };
+    uint32_t x0 = state[0], x1 = state[1], x2 = state[2], x3 = state[3];
+    size_t i = 0;
+    for (; i + kStates <= count; i += kStates) {
+        bits.refill();
+        out[i] = step(x0);
+        out[i + 1] = step(x1);
+        out[i + 2] = step(x2);
+        out[i + 3] = step(x3);
+    }
+    state[0] = x0;
+    state[1] = x1;
+    state[2] = x2;
+    state[3] = x3;
+    for (; i < count; ++i) {
+        bits.refill();
+        out[i] = step(state[i % kStates]);
+    }
+    // 编码从状态 2^L 开始, 解码到最后应回到0
+    if (bits.overrun() || (state[0] | state[1] | state[2] | state[3]) != 0) {
+        throw std::runtime_error("Error: block is corrupted");
+    }
+    reader = bits;
+}
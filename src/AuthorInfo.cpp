@@ -1,24 +1,26 @@
 #include "AuthorInfo.h"
+#include <cstdlib>
 // #include <curl/curl.h>
 namespace AuthorInfo {
     static std::atomic<bool> authorInfoPrinted(false);
 
     LibraryInitializer::LibraryInitializer() :
         mVersion("1.0") {
-        if (!authorInfoPrinted.exchange(true)) {
-
-            std::cout << "-----------------------------" << std::endl;
-            std::cout << "Library: torosamy_huffman_compressor" << std::endl;
-            std::cout << "Author: Torosamy" << std::endl;
-            std::cout << "Website: www.torosamy.net" << std::endl;
-            std::cout << "Version: "<<mVersion<<" - GPL-3.0 license" << std::endl;
+        // 设置环境变量 TOROSAMY_HUFFMAN_QUIET 时不输出, 库加载时还没有压缩选项可用
+        if (std::getenv("TOROSAMY_HUFFMAN_QUIET") == nullptr && !authorInfoPrinted.exchange(true)) {
+            // 写到标准错误, 标准输出可能正在传输压缩数据
+            std::cerr << "-----------------------------" << std::endl;
+            std::cerr << "Library: torosamy_huffman_compressor" << std::endl;
+            std::cerr << "Author: Torosamy" << std::endl;
+            std::cerr << "Website: www.torosamy.net" << std::endl;
+            std::cerr << "Version: "<<mVersion<<" - GPL-3.0 license" << std::endl;
             
 
             // if(fileReader["Settings"]["CheckVersion"]["Enable"].as<bool>()) updateVersion();
             // else std::cout<<"Warning: Version checking has been disabled"<<std::endl;
 
-            std::cout << "If you have any questions, welcome to contact me" << std::endl;
-            std::cout << "-----------------------------" << std::endl;
+            std::cerr << "If you have any questions, welcome to contact me" << std::endl;
+            std::cerr << "-----------------------------" << std::endl;
         }
     }
     // size_t LibraryInitializer::writeCallback(void *contents, size_t size, size_t nmemb, std::string *response) {
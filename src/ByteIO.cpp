@@ -0,0 +1,501 @@
+#include "ByteIO.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void ByteSource::readExact(void* dst, size_t n) {
+    unsigned char* p = static_cast<unsigned char*>(dst);
+    while (n > 0) {
+        size_t got = read(p, n);
+        if (got == 0) {
+            throw std::runtime_error("Error: unexpected end of input");
+        }
+        p += got;
+        n -= got;
+    }
+}
+
+// ---------------- MemorySource ----------------
+
+size_t MemorySource::read(unsigned char* dst, size_t n) {
+    size_t got = std::min(n, size_ - pos_);
+    std::memcpy(dst, data_ + pos_, got);
+    pos_ += got;
+    return got;
+}
+
+bool MemorySource::seek(uint64_t pos) {
+    if (pos > size_) {
+        return false;
+    }
+    pos_ = static_cast<size_t>(pos);
+    return true;
+}
+
+// ---------------- MappedFileSource ----------------
+
+MappedFileSource::~MappedFileSource() {
+    close();
+}
+
+bool MappedFileSource::open(const std::string& filepath) {
+    close();
+    int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+
+    static const unsigned char kEmpty[1] = {0};
+    if (st.st_size == 0) { // 空文件无法映射
+        ::close(fd);
+        data_ = kEmpty;
+        size_ = 0;
+        pos_ = 0;
+        return true;
+    }
+
+    void* mapping = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // 映射建立后即可关闭文件描述符
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    ::madvise(mapping, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+    mapping_ = mapping;
+    mapping_size_ = static_cast<size_t>(st.st_size);
+    data_ = static_cast<const unsigned char*>(mapping);
+    size_ = mapping_size_;
+    pos_ = 0;
+    return true;
+}
+
+void MappedFileSource::close() {
+    if (mapping_ != nullptr) {
+        ::munmap(mapping_, mapping_size_);
+    }
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+    data_ = nullptr;
+    size_ = 0;
+    pos_ = 0;
+}
+
+void MappedFileSource::prefetch(uint64_t pos, size_t n) {
+    if (mapping_ == nullptr || pos >= mapping_size_) {
+        return;
+    }
+    // madvise 要求起始地址按页对齐
+    static const size_t kPageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t begin = static_cast<size_t>(pos) / kPageSize * kPageSize;
+    size_t end = std::min(mapping_size_, static_cast<size_t>(pos) + n);
+    ::madvise(static_cast<unsigned char*>(mapping_) + begin, end - begin, MADV_WILLNEED);
+}
+
+// ---------------- BufferedFileSource ----------------
+
+BufferedFileSource::BufferedFileSource(size_t buffer_size) : buffer_size_(buffer_size) {
+}
+
+BufferedFileSource::~BufferedFileSource() {
+    close();
+}
+
+bool BufferedFileSource::open(const std::string& filepath) {
+    close();
+    fd_ = ::open(filepath.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        return false;
+    }
+    struct stat st;
+    size_ = (::fstat(fd_, &st) == 0 && S_ISREG(st.st_mode)) ? static_cast<uint64_t>(st.st_size) : kUnknownSize;
+    buffer_.resize(buffer_size_);
+    return true;
+}
+
+bool BufferedFileSource::attach(int fd, bool owns) {
+    close();
+    if (fd < 0) {
+        return false;
+    }
+    fd_ = fd;
+    owns_fd_ = owns;
+    struct stat st;
+    size_ = (::fstat(fd_, &st) == 0 && S_ISREG(st.st_mode)) ? static_cast<uint64_t>(st.st_size) : kUnknownSize;
+    buffer_.resize(buffer_size_);
+    return true;
+}
+
+void BufferedFileSource::close() {
+    if (fd_ >= 0 && owns_fd_) {
+        ::close(fd_);
+    }
+    fd_ = -1;
+    owns_fd_ = true;
+    size_ = kUnknownSize;
+    buffer_pos_ = 0;
+    buffer_len_ = 0;
+}
+
+size_t BufferedFileSource::fill(unsigned char* dst, size_t n) {
+    while (true) {
+        ssize_t got = ::read(fd_, dst, n);
+        if (got >= 0) {
+            return static_cast<size_t>(got);
+        }
+        if (errno != EINTR) {
+            throw std::runtime_error(std::string("Error: read failed: ") + std::strerror(errno));
+        }
+    }
+}
+
+size_t BufferedFileSource::read(unsigned char* dst, size_t n) {
+    if (buffer_pos_ == buffer_len_) {
+        // 大块读取直接进入调用方的缓冲区, 避免多一次复制
+        if (n >= buffer_.size()) {
+            return fill(dst, n);
+        }
+        buffer_pos_ = 0;
+        buffer_len_ = fill(buffer_.data(), buffer_.size());
+    }
+    size_t got = std::min(n, buffer_len_ - buffer_pos_);
+    std::memcpy(dst, buffer_.data() + buffer_pos_, got);
+    buffer_pos_ += got;
+    return got;
+}
+
+bool BufferedFileSource::seek(uint64_t pos) {
+    if (::lseek(fd_, static_cast<off_t>(pos), SEEK_SET) < 0) {
+        return false;
+    }
+    buffer_pos_ = 0;
+    buffer_len_ = 0;
+    return true;
+}
+
+// ---------------- MemorySink ----------------
+
+void MemorySink::write(const unsigned char* src, size_t n) {
+    if (n > capacity_ - size_) {
+        throw std::runtime_error("Error: output buffer is too small");
+    }
+    std::memcpy(data_ + size_, src, n);
+    size_ += n;
+}
+
+unsigned char* MemorySink::reserve(size_t n) {
+    if (n > capacity_ - size_) {
+        throw std::runtime_error("Error: output buffer is too small");
+    }
+    return data_ + size_;
+}
+
+void MemorySink::patch(uint64_t pos, const unsigned char* src, size_t n) {
+    if (pos > size_ || n > size_ - pos) {
+        throw std::runtime_error("Error: patch position is out of range");
+    }
+    std::memcpy(data_ + pos, src, n);
+}
+
+// ---------------- VectorSink ----------------
+
+void VectorSink::write(const unsigned char* src, size_t n) {
+    out_.insert(out_.end(), src, src + n);
+}
+
+unsigned char* VectorSink::reserve(size_t n) {
+    out_.resize(out_.size() - reserved_ + n);
+    reserved_ = n;
+    return out_.data() + out_.size() - n;
+}
+
+void VectorSink::commit(size_t n) {
+    out_.resize(out_.size() - reserved_ + std::min(n, reserved_));
+    reserved_ = 0;
+}
+
+void VectorSink::patch(uint64_t pos, const unsigned char* src, size_t n) {
+    if (pos > tell() || n > tell() - pos) {
+        throw std::runtime_error("Error: patch position is out of range");
+    }
+    std::memcpy(out_.data() + base_ + pos, src, n);
+}
+
+// ---------------- BufferedFileSink ----------------
+
+BufferedFileSink::BufferedFileSink(size_t buffer_size) : buffer_(buffer_size) {
+}
+
+BufferedFileSink::~BufferedFileSink() {
+    try {
+        close();
+    } catch (const std::exception&) {
+        // 析构时无法再报告写入错误
+    }
+}
+
+bool BufferedFileSink::open(const std::string& filepath) {
+    close();
+    fd_ = ::open(filepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    flushed_ = 0;
+    buffer_len_ = 0;
+    return fd_ >= 0;
+}
+
+bool BufferedFileSink::attach(int fd, bool owns) {
+    close();
+    if (fd < 0) {
+        return false;
+    }
+    fd_ = fd;
+    owns_fd_ = owns;
+    flushed_ = 0;
+    buffer_len_ = 0;
+    return true;
+}
+
+void BufferedFileSink::close() {
+    if (fd_ >= 0) {
+        int fd = fd_;
+        bool owns = owns_fd_;
+        owns_fd_ = true;
+        try {
+            flush();
+        } catch (...) {
+            if (owns) {
+                ::close(fd);
+            }
+            fd_ = -1;
+            throw;
+        }
+        if (owns) {
+            ::close(fd);
+        }
+    }
+    fd_ = -1;
+}
+
+static void writeAll(int fd, const unsigned char* src, size_t n) {
+    while (n > 0) {
+        ssize_t written = ::write(fd, src, n);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::string("Error: write failed: ") + std::strerror(errno));
+        }
+        src += written;
+        n -= static_cast<size_t>(written);
+    }
+}
+
+static void pwriteAll(int fd, const unsigned char* src, size_t n, uint64_t pos) {
+    size_t done = 0;
+    while (done < n) {
+        ssize_t written = ::pwrite(fd, src + done, n - done, static_cast<off_t>(pos + done));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::string("Error: write failed: ") + std::strerror(errno));
+        }
+        done += static_cast<size_t>(written);
+    }
+}
+
+void BufferedFileSink::write(const unsigned char* src, size_t n) {
+    if (n > buffer_.size() - buffer_len_) {
+        flush();
+        // 大块数据直接写入文件
+        if (n >= buffer_.size()) {
+            writeAll(fd_, src, n);
+            flushed_ += n;
+            return;
+        }
+    }
+    std::memcpy(buffer_.data() + buffer_len_, src, n);
+    buffer_len_ += n;
+}
+
+void BufferedFileSink::patch(uint64_t pos, const unsigned char* src, size_t n) {
+    if (pos + n > tell()) {
+        throw std::runtime_error("Error: patch position is out of range");
+    }
+    if (pos >= flushed_) { // 仍在缓冲区中
+        std::memcpy(buffer_.data() + (pos - flushed_), src, n);
+        return;
+    }
+    flush();
+    pwriteAll(fd_, src, n, pos);
+}
+
+void BufferedFileSink::flush() {
+    if (buffer_len_ > 0) {
+        writeAll(fd_, buffer_.data(), buffer_len_);
+        flushed_ += buffer_len_;
+        buffer_len_ = 0;
+    }
+}
+
+// ---------------- MappedFileSink ----------------
+
+MappedFileSink::~MappedFileSink() {
+    close();
+}
+
+bool MappedFileSink::open(const std::string& filepath) {
+    close();
+    // 可写的共享映射要求文件以读写方式打开
+    int fd = ::open(filepath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+    fd_ = fd;
+    size_ = 0;
+    return true;
+}
+
+void MappedFileSink::close() {
+    unmap();
+    if (fd_ >= 0) {
+        // 去掉预留而未确认的部分; 析构时无法报告错误, 这里忽略返回值
+        (void)::ftruncate(fd_, static_cast<off_t>(size_));
+        ::close(fd_);
+    }
+    fd_ = -1;
+    size_ = 0;
+}
+
+void MappedFileSink::unmap() {
+    if (mapping_ != nullptr) {
+        ::munmap(mapping_, mapping_size_);
+    }
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+}
+
+void MappedFileSink::write(const unsigned char* src, size_t n) {
+    pwriteAll(fd_, src, n, size_);
+    size_ += n;
+}
+
+void MappedFileSink::patch(uint64_t pos, const unsigned char* src, size_t n) {
+    if (pos > size_ || n > size_ - pos) {
+        throw std::runtime_error("Error: patch position is out of range");
+    }
+    pwriteAll(fd_, src, n, pos);
+}
+
+unsigned char* MappedFileSink::reserve(size_t n) {
+    unmap();
+    // 先真正分配磁盘空间: 只用 ftruncate 得到的空洞文件在磁盘写满时, 填写映射会收到 SIGBUS。
+    // 文件系统不支持 fallocate 时退回到 ftruncate
+    if (::fallocate(fd_, 0, static_cast<off_t>(size_), static_cast<off_t>(n)) != 0) {
+        if (errno != EOPNOTSUPP && errno != ENOSYS) {
+            throw std::runtime_error(std::string("Error: write failed: ") + std::strerror(errno));
+        }
+        if (::ftruncate(fd_, static_cast<off_t>(size_ + n)) != 0) {
+            return nullptr;
+        }
+    }
+    // 映射的起点须按页对齐
+    static const size_t kPageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    const uint64_t begin = size_ / kPageSize * kPageSize;
+    const size_t length = static_cast<size_t>(size_ + n - begin);
+    void* mapping = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, static_cast<off_t>(begin));
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+    mapping_ = mapping;
+    mapping_size_ = length;
+    return static_cast<unsigned char*>(mapping) + (size_ - begin);
+}
+
+void MappedFileSink::commit(size_t n) {
+    unmap();
+    size_ += n;
+}
+
+// ---------------- StreamSource / StreamSink ----------------
+
+size_t StreamSource::read(unsigned char* dst, size_t n) {
+    in_.read(reinterpret_cast<char*>(dst), static_cast<std::streamsize>(n));
+    if (in_.bad()) {
+        throw std::runtime_error("Error: read failed");
+    }
+    return static_cast<size_t>(in_.gcount());
+}
+
+bool StreamSource::seek(uint64_t pos) {
+    in_.clear();
+    if (!in_.seekg(static_cast<std::streamoff>(pos), std::ios::beg)) {
+        in_.clear();
+        return false;
+    }
+    return true;
+}
+
+StreamSink::StreamSink(std::ostream& out) : out_(out), base_(out.tellp()) {
+    if (base_ == std::streampos(-1)) {
+        out_.clear();
+    }
+}
+
+void StreamSink::write(const unsigned char* src, size_t n) {
+    if (!out_.write(reinterpret_cast<const char*>(src), static_cast<std::streamsize>(n))) {
+        throw std::runtime_error("Error: write failed");
+    }
+    written_ += n;
+}
+
+void StreamSink::patch(uint64_t pos, const unsigned char* src, size_t n) {
+    if (pos + n > written_) {
+        throw std::runtime_error("Error: patch position is out of range");
+    }
+    if (base_ == std::streampos(-1) || !out_.seekp(base_ + static_cast<std::streamoff>(pos))) {
+        throw std::runtime_error("Error: output stream is not seekable");
+    }
+    out_.write(reinterpret_cast<const char*>(src), static_cast<std::streamsize>(n));
+    if (!out_.seekp(base_ + static_cast<std::streamoff>(written_))) {
+        throw std::runtime_error("Error: output stream is not seekable");
+    }
+}
+
+void StreamSink::flush() {
+    if (!out_.flush()) {
+        throw std::runtime_error("Error: write failed");
+    }
+}
+
+ByteSource* openFileSource(const std::string& filepath, MappedFileSource& mapped, BufferedFileSource& buffered) {
+    if (mapped.open(filepath)) {
+        return &mapped;
+    }
+    if (buffered.open(filepath)) {
+        return &buffered;
+    }
+    return nullptr;
+}
+
+bool isSameFile(const std::string& a, const std::string& b) {
+    struct stat a_st;
+    struct stat b_st;
+    if (::stat(a.c_str(), &a_st) != 0 || ::stat(b.c_str(), &b_st) != 0) {
+        return false;
+    }
+    return a_st.st_dev == b_st.st_dev && a_st.st_ino == b_st.st_ino;
+}
@@ -0,0 +1,35 @@
+#include "CompressionStats.h"
+#include <cmath>
+
+PhaseTimings& PhaseTimings::operator+=(const PhaseTimings& other) {
+    histogram += other.histogram;
+    tree_build += other.tree_build;
+    code_generation += other.code_generation;
+    encode += other.encode;
+    table_write += other.table_write;
+    table_read += other.table_read;
+    decode += other.decode;
+    total += other.total;
+    return *this;
+}
+
+void CompressionStats::setSymbolStatistics(const uint64_t* counts, uint64_t payload_bits) {
+    uint64_t total = 0;
+    distinct_symbols = 0;
+    for (int c = 0; c < 256; ++c) {
+        total += counts[c];
+        distinct_symbols += counts[c] > 0 ? 1 : 0;
+    }
+    entropy = 0.0;
+    average_code_length = 0.0;
+    if (total == 0) {
+        return;
+    }
+    for (int c = 0; c < 256; ++c) {
+        if (counts[c] > 0) {
+            double p = static_cast<double>(counts[c]) / static_cast<double>(total);
+            entropy -= p * std::log2(p);
+        }
+    }
+    average_code_length = static_cast<double>(payload_bits) / static_cast<double>(total);
+}
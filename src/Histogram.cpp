@@ -0,0 +1,85 @@
+#include "Histogram.h"
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <vector>
+#include "ThreadPool.h"
+
+// 子直方图为32位计数, 每段输入不超过该长度时不会溢出
+static const size_t kMaxSegment = static_cast<size_t>(1) << 30;
+// 并行统计时每个任务至少处理的字节数
+static const size_t kMinParallelSlice = static_cast<size_t>(4) << 20;
+
+void countBytes(const unsigned char* data, size_t size, uint64_t* counts) {
+    // 很短的输入直接计数, 不值得清零子直方图
+    if (size < 256) {
+        for (size_t i = 0; i < size; ++i) {
+            counts[data[i]]++;
+        }
+        return;
+    }
+
+    uint32_t sub[4][256];
+    while (size > 0) {
+        size_t n = std::min(size, kMaxSegment);
+        std::memset(sub, 0, sizeof(sub));
+
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            uint64_t a;
+            uint64_t b;
+            std::memcpy(&a, data + i, sizeof(a));
+            std::memcpy(&b, data + i + 8, sizeof(b));
+            sub[0][a & 0xFF]++;
+            sub[1][(a >> 8) & 0xFF]++;
+            sub[2][(a >> 16) & 0xFF]++;
+            sub[3][(a >> 24) & 0xFF]++;
+            sub[0][(a >> 32) & 0xFF]++;
+            sub[1][(a >> 40) & 0xFF]++;
+            sub[2][(a >> 48) & 0xFF]++;
+            sub[3][a >> 56]++;
+            sub[0][b & 0xFF]++;
+            sub[1][(b >> 8) & 0xFF]++;
+            sub[2][(b >> 16) & 0xFF]++;
+            sub[3][(b >> 24) & 0xFF]++;
+            sub[0][(b >> 32) & 0xFF]++;
+            sub[1][(b >> 40) & 0xFF]++;
+            sub[2][(b >> 48) & 0xFF]++;
+            sub[3][b >> 56]++;
+        }
+        for (; i < n; ++i) {
+            sub[0][data[i]]++;
+        }
+
+        for (int c = 0; c < 256; ++c) {
+            counts[c] += static_cast<uint64_t>(sub[0][c]) + sub[1][c] + sub[2][c] + sub[3][c];
+        }
+        data += n;
+        size -= n;
+    }
+}
+
+void countBytesParallel(const unsigned char* data, size_t size, uint64_t* counts, ThreadPool& pool) {
+    size_t slices = std::min(static_cast<size_t>(pool.size()), size / kMinParallelSlice);
+    if (slices <= 1) {
+        countBytes(data, size, counts);
+        return;
+    }
+
+    size_t slice_size = (size + slices - 1) / slices;
+    std::vector<std::future<std::vector<uint64_t>>> partials;
+    for (size_t pos = 0; pos < size; pos += slice_size) {
+        size_t n = std::min(slice_size, size - pos);
+        partials.push_back(pool.submit([slice = data + pos, n]() {
+            std::vector<uint64_t> partial(256, 0);
+            countBytes(slice, n, partial.data());
+            return partial;
+        }));
+    }
+    for (std::future<std::vector<uint64_t>>& partial : partials) {
+        std::vector<uint64_t> result = partial.get();
+        for (int c = 0; c < 256; ++c) {
+            counts[c] += result[c];
+        }
+    }
+}
@@ -1,10 +1,122 @@
 #include "Huffman.h"
+#include <algorithm>
+#include <stdexcept>
 
 
-std::string byteToBinaryString(unsigned char byte) {
-    std::string binaryString;
-    for (int i = CHAR_BIT - 1; i >= 0; --i) {
-        binaryString += ((byte >> i) & 1) ? '1' : '0';
+void assignCanonicalCodes(HuffmanCodeword* codewords, size_t count) {
+    std::sort(codewords, codewords + count, [](const HuffmanCodeword& a, const HuffmanCodeword& b) {
+        return a.length != b.length ? a.length < b.length : a.symbol < b.symbol;
+    });
+    // 只有一种字符时编码长度为0, 不占任何位
+    if (count == 1 && codewords[0].length == 0) {
+        codewords[0].code = 0;
+        return;
     }
-    return binaryString;
-}
\ No newline at end of file
+    // 同一长度的编码连续递增, 长度增加时左移补0
+    uint64_t next_code = 0;
+    int prev_length = 0;
+    bool exhausted = false; // 编码空间已全部分配
+    for (size_t i = 0; i < count; ++i) {
+        int length = codewords[i].length;
+        if (length == 0 || length > 64 || exhausted) {
+            throw std::runtime_error("Huffman code lengths do not form a prefix code");
+        }
+        // next_code < 2^prev_length, 左移后不会溢出
+        next_code = (length - prev_length >= 64) ? 0 : next_code << (length - prev_length);
+        codewords[i].code = next_code;
+        next_code++;
+        exhausted = (length == 64) ? next_code == 0 : (next_code >> length) != 0;
+        prev_length = length;
+    }
+}
+
+void packageMergeCodeLengths(const uint64_t* weights, size_t count, int max_length, unsigned char* lengths) {
+    // 每层列表由叶子与下一层相邻两项打包而成的包组成, 最多 2n-1 项。同一层的叶子总是按权值升序依次取出,
+    // 第 k 个叶子就是 order[k], 因此每层只需记录各项是否为叶子; 权值只有相邻两层用到, 两个数组交替使用。
+    // 全部使用定长数组, 不分配内存
+    static const size_t kMaxItems = 2 * 256 - 1;
+    static const int kMaxLevels = 64;
+    static const size_t kFlagWords = (kMaxItems + 63) / 64;
+    int order[256];
+    for (size_t i = 0; i < count; ++i) {
+        order[i] = static_cast<int>(i);
+    }
+    // 权值相同时按下标排序, 与稳定排序的结果相同
+    std::sort(order, order + count, [weights](int a, int b) {
+        return weights[a] != weights[b] ? weights[a] < weights[b] : a < b;
+    });
+
+    // is_leaf[d] 为深度 d+1 处各项是否为叶子的位图, 最深一层只有叶子
+    uint64_t is_leaf[kMaxLevels][kFlagWords];
+    uint64_t level_weights[2][kMaxItems];
+    uint64_t* below = level_weights[0];
+    uint64_t* level = level_weights[1];
+    size_t below_size = count;
+    std::fill(is_leaf[max_length - 1], is_leaf[max_length - 1] + kFlagWords, ~static_cast<uint64_t>(0));
+    for (size_t i = 0; i < count; ++i) {
+        below[i] = weights[order[i]];
+    }
+    for (int d = max_length - 2; d >= 0; --d) {
+        std::fill(is_leaf[d], is_leaf[d] + kFlagWords, 0);
+        size_t size = 0;
+        size_t leaf = 0;
+        size_t pkg = 0;
+        while (leaf < count || pkg + 1 < below_size) {
+            bool take_leaf = pkg + 1 >= below_size ||
+                (leaf < count && weights[order[leaf]] <= below[pkg] + below[pkg + 1]);
+            if (take_leaf) {
+                is_leaf[d][size / 64] |= static_cast<uint64_t>(1) << (size % 64);
+                level[size++] = weights[order[leaf++]];
+            } else {
+                level[size++] = below[pkg] + below[pkg + 1];
+                pkg += 2;
+            }
+        }
+        std::swap(below, level);
+        below_size = size;
+    }
+
+    // 取最上层前 2n-2 项, 逐层向下展开: 前 k 个叶子的编码长度各加1, 每个包展开为下一层的两项
+    std::fill(lengths, lengths + count, 0);
+    size_t selected = 2 * count - 2;
+    for (int d = 0; d < max_length && selected > 0; ++d) {
+        size_t leaves = 0;
+        for (size_t i = 0; i < selected; ++i) {
+            leaves += (is_leaf[d][i / 64] >> (i % 64)) & 1;
+        }
+        for (size_t k = 0; k < leaves; ++k) {
+            lengths[order[k]]++;
+        }
+        selected = 2 * (selected - leaves);
+    }
+}
+
+bool limitCodeLengths(HuffmanCodeword* codewords, size_t count, const uint64_t* weights, int max_length) {
+    if (max_length <= 0 || count < 2) {
+        return false;
+    }
+    int current_max = 0;
+    for (size_t i = 0; i < count; ++i) {
+        current_max = std::max(current_max, static_cast<int>(codewords[i].length));
+    }
+    if (current_max <= max_length) {
+        return false; // 不受限的哈夫曼树已满足约束, 它本身就是最优解
+    }
+    int min_length = 0;
+    while ((static_cast<size_t>(1) << min_length) < count) {
+        ++min_length;
+    }
+    max_length = std::max(max_length, min_length);
+
+    uint64_t symbol_weights[256];
+    unsigned char lengths[256];
+    for (size_t i = 0; i < count; ++i) {
+        symbol_weights[i] = weights[codewords[i].symbol];
+    }
+    packageMergeCodeLengths(symbol_weights, count, max_length, lengths);
+    for (size_t i = 0; i < count; ++i) {
+        codewords[i].length = lengths[i];
+    }
+    assignCanonicalCodes(codewords, count);
+    return true;
+}
@@ -1,284 +1,636 @@
 #include "HuffmanCompressor.h"
 #include <iostream>
 #include <algorithm> 
+#include <atomic>
 #include <climits> 
+#include <cstring>
+#include <future>
 #include <stdexcept>
-#include <filesystem> 
-#include <map>
 #include <vector>
-
-HuffmanCompressor::HuffmanCompressor() {
+#include "HuffmanFormat.h"
+#include "HuffmanContextModel.h"
+#include "LzCodec.h"
+#include "HuffmanDictionary.h"
+#include "Checksum.h"
+#include "Histogram.h"
+#include "CompressionStats.h"
+#include "ThreadPool.h"
+#include "BoundedQueue.h"
+
+static const size_t kInputChunk = 1 << 20;
+// 映射输入超过该大小且允许多线程时, 频率统计分段并行
+static const size_t kParallelHistogramThreshold = static_cast<size_t>(16) << 20;
+
+// 块是否自带编码表 (而不是字典或沿用之前的编码表)
+static bool hasCodeTable(const HuffmanFormat::BlockEncodeStats& stats) {
+    return (stats.block_type == HuffmanFormat::kBlockHuffman || stats.block_type == HuffmanFormat::kBlockHuffman4) &&
+           (stats.table_kind == HuffmanFormat::kTableExplicit || stats.table_kind == HuffmanFormat::kTableCanonical);
 }
 
-long HuffmanCompressor::calculateFrequencies(std::ifstream& ifp) {
-    long file_length = 0;
-    unsigned char c;
-
-    // 初始化header_数组
-    for (int i = 0; i < 512; ++i) {
-        header_[i] = HuffmanNode(); // 调用默认构造函数
-        header_[i].b = static_cast<unsigned char>(i); // 为前256个字符节点设置字符值
-    }
-
-    // 逐字节读取文件，统计频率
-    ifp.clear(); // 清除可能的EOF标志
-    ifp.seekg(0, std::ios::beg); // 确保从文件开头读取
-
-    while (ifp.read(reinterpret_cast<char*>(&c), 1)) {
-        header_[c].count++;
-        file_length++;
-    }
-    return file_length;
-}
-
-void HuffmanCompressor::sortNodesByFrequency(long num_distinct_chars) {
-    // 对 header_数组中的对象直接操作
-    std::sort(header_, header_ + num_distinct_chars, [](const HuffmanNode& a, const HuffmanNode& b) {
-        return a.count > b.count; // 降序排列
-    });
+// encodeBlock 在没有之前的编码表时写出的块中, 哪些是与其他写法比较后选出的, 有了之前的编码表可能改为沿用
+static bool mayRepeatTable(const HuffmanFormat::BlockEncodeStats& stats) {
+    return stats.block_type == HuffmanFormat::kBlockRaw || stats.block_type == HuffmanFormat::kBlockContext ||
+           stats.block_type == HuffmanFormat::kBlockLz || stats.block_type == HuffmanFormat::kBlockAns || hasCodeTable(stats);
 }
 
-long HuffmanCompressor::buildHuffmanTree(long num_distinct_chars) {
-    if (num_distinct_chars <= 1) { // 0或1个字符不需要构建树
-        if (num_distinct_chars == 1) { // 如果只有一个字符，给它一个默认编码 '0'
-            header_[0].bits = "0";
+// 由块的编码长度重新分配规范编码, 与块中写出的编码相同
+static void rebuildPreviousTable(const unsigned char* code_lengths, HuffmanEncodeTable& table) {
+    HuffmanCodeword codewords[256];
+    size_t count = 0;
+    for (int c = 0; c < 256; ++c) {
+        if (code_lengths[c] > 0) {
+            codewords[count].symbol = static_cast<unsigned short>(c);
+            codewords[count].length = code_lengths[c];
+            count++;
         }
-        return num_distinct_chars;
     }
+    assignCanonicalCodes(codewords, count);
+    table.build(codewords, count);
+}
 
-    // 复制前 num_distinct_chars 个有效节点到 vector，方便操作
-    std::vector<HuffmanNode*> active_nodes_ptrs;
-    for (long i = 0; i < num_distinct_chars; ++i) {
-        active_nodes_ptrs.push_back(&header_[i]);
+// 选项无效时抛出 std::runtime_error
+static void validateOptions(const CompressionOptions& options) {
+    if (options.max_code_length > 64) {
+        throw std::runtime_error("压缩选项无效: 最长编码不能超过64位");
     }
+    if (options.streams != 1 && options.streams != HuffmanFormat::kInterleavedStreams) {
+        throw std::runtime_error("压缩选项无效: 交错位流数只能为1或4");
+    }
+    if (options.context_tables == 1 || options.context_tables > static_cast<unsigned>(HuffmanContextModel::kMaxTables)) {
+        throw std::runtime_error("压缩选项无效: 上下文编码表数只能为0或2..16");
+    }
+    if (options.lz_level > static_cast<unsigned>(LzCodec::kMaxLevel)) {
+        throw std::runtime_error("压缩选项无效: LZ 级别只能为0..9");
+    }
+}
 
-    long next_available_node_idx = num_distinct_chars; // 从 num_distinct_chars 之后开始存放内部节点
-
-    // 只要待合并的节点数量大于 1，就继续合并
-    while (active_nodes_ptrs.size() > 1) {
-        // 找到频率最小的两个节点
-        auto it1 = std::min_element(active_nodes_ptrs.begin(), active_nodes_ptrs.end(), [](const HuffmanNode* a, const HuffmanNode* b) {
-            return a->count < b->count;
-        });
-        HuffmanNode* node1 = *it1;
-        active_nodes_ptrs.erase(it1);
-
-        auto it2 = std::min_element(active_nodes_ptrs.begin(), active_nodes_ptrs.end(), [](const HuffmanNode* a, const HuffmanNode* b) {
-            return a->count < b->count;
-        });
-        HuffmanNode* node2 = *it2;
-        active_nodes_ptrs.erase(it2);
-
-        // 创建新的父节点
-        if (next_available_node_idx >= 512) {
-             throw std::runtime_error("Huffman tree construction error: Header array size exceeded.");
-        }
-        header_[next_available_node_idx].count = node1->count + node2->count;
-        // 约定：左子节点的字符值较小
-        header_[next_available_node_idx].lch = (node1->b < node2->b) ? (node1 - header_) : (node2 - header_);
-        header_[next_available_node_idx].rch = (node1->b < node2->b) ? (node2 - header_) : (node1 - header_);
+HuffmanCompressor::HuffmanCompressor() {
+}
 
-        // 设置子节点的父节点
-        node1->parent = next_available_node_idx;
-        node2->parent = next_available_node_idx;
+HuffmanCompressor::HuffmanCompressor(const CompressionOptions& options) : options_(options) {
+}
 
-        // 将新创建的父节点加入到 active_nodes_ptrs 中
-        active_nodes_ptrs.push_back(&header_[next_available_node_idx]);
-        next_available_node_idx++;
-    }
-    return next_available_node_idx; // 返回实际使用的总节点数 (包括叶子和内部节点)
+void HuffmanCompressor::reset() {
+    stats_ = CompressionStats();
+    std::vector<unsigned char>().swap(input_buf_);
+    std::vector<unsigned char>().swap(encode_buf_);
+    std::vector<unsigned char>().swap(table_buf_);
+    std::vector<unsigned char>().swap(block_buf_);
+    std::vector<HuffmanFormat::IndexEntry>().swap(index_);
 }
 
-void HuffmanCompressor::generateHuffmanCodes(long num_distinct_chars) {
-    for (long i = 0; i < num_distinct_chars; ++i) { // 遍历所有叶子节点
-        long current_node_idx = i;
-        std::string current_code_str = "";
-
-        while (header_[current_node_idx].parent != -1) {
-            long parent_idx = header_[current_node_idx].parent;
-            if (header_[parent_idx].lch == current_node_idx) { // 如果是左子节点
-                current_code_str = '0' + current_code_str;
-            } else { // 如果是右子节点
-                current_code_str = '1' + current_code_str;
-            }
-            current_node_idx = parent_idx;
+long HuffmanCompressor::calculateFrequencies(ByteSource& input) {
+    long file_length = 0;
+    uint64_t* counts = counts_;
+    std::fill(counts, counts + 256, 0);
+    if (input.data() != nullptr) {
+        // 输入已映射到内存, 直接统计; 大文件分段交给线程池并行统计
+        const unsigned char* data = input.data();
+        size_t size = static_cast<size_t>(input.size());
+        if (size >= kParallelHistogramThreshold && ThreadPool::resolveThreadCount(options_.threads) > 1) {
+            ThreadPool pool(options_.threads);
+            countBytesParallel(data, size, counts, pool);
+        } else {
+            countBytes(data, size, counts);
+        }
+        file_length = static_cast<long>(size);
+    } else {
+        // 按大块读取文件，统计频率
+        if (!input.seek(0)) { // 确保从文件开头读取
+            throw std::runtime_error("压缩文件失败，输入不支持重新定位");
+        }
+        input_buf_.resize(kInputChunk);
+        size_t got;
+        while ((got = input.read(input_buf_.data(), input_buf_.size())) > 0) {
+            countBytes(input_buf_.data(), got, counts);
+            file_length += static_cast<long>(got);
         }
-        header_[i].bits = current_code_str; // 存储编码
     }
+    return file_length;
 }
 
-long HuffmanCompressor::writeCompressedData(std::ifstream& ifp, std::ofstream& ofp, long original_file_length, long num_distinct_chars) {
+long HuffmanCompressor::writeCompressedData(ByteSource& input, ByteSink& output, long original_file_length) {
     // 写入原始文件长度
-    ofp.write(reinterpret_cast<const char*>(&original_file_length), sizeof(long));
+    output.write(reinterpret_cast<const unsigned char*>(&original_file_length), sizeof(long));
     // 写入哈夫曼表起始位置占位符
     long header_table_start_pos_placeholder = 0;
-    ofp.write(reinterpret_cast<const char*>(&header_table_start_pos_placeholder), sizeof(long));
-    
-    // 回到输入文件开头，准备读取数据进行压缩
-    ifp.clear();
-    ifp.seekg(0, std::ios::beg);
+    output.write(reinterpret_cast<const unsigned char*>(&header_table_start_pos_placeholder), sizeof(long));
 
-    std::string bit_buffer = "";
+    // 输出缓冲区只需容纳一个输入块的编码结果, 小输入按实际长度分配, 之后的调用复用
+    encode_buf_.resize(encode_table_.maxEncodedSize(std::min(kInputChunk, static_cast<size_t>(original_file_length))));
+    std::vector<unsigned char>& out_buf = encode_buf_;
+    BitWriter writer(out_buf.data());
     long compressed_bytes_count = 0;
-    unsigned char c;
 
-    // 构建一个 map 方便快速查找字符对应的编码，因为它可能在 header_数组中被移动了
-    std::map<unsigned char, std::string> huffman_codes_map;
-    for(long i = 0; i < num_distinct_chars; ++i) {
-        huffman_codes_map[header_[i].b] = header_[i].bits;
+    auto encodeChunk = [&](const unsigned char* chunk, size_t n) {
+        encode_table_.encode(chunk, n, writer);
+        output.write(out_buf.data(), writer.bytesWritten());
+        compressed_bytes_count += static_cast<long>(writer.bytesWritten());
+        writer.rewind();
+    };
+
+    if (input.data() != nullptr) {
+        // 输入已映射到内存, 第二遍无需重新读取
+        const unsigned char* data = input.data();
+        size_t size = static_cast<size_t>(input.size());
+        for (size_t pos = 0; pos < size; pos += kInputChunk) {
+            encodeChunk(data + pos, std::min(kInputChunk, size - pos));
+        }
+    } else {
+        // 回到输入文件开头，准备读取数据进行压缩
+        if (!input.seek(0)) {
+            throw std::runtime_error("压缩文件失败，输入不支持重新定位");
+        }
+        input_buf_.resize(kInputChunk);
+        size_t got;
+        while ((got = input.read(input_buf_.data(), input_buf_.size())) > 0) {
+            encodeChunk(input_buf_.data(), got);
+        }
     }
 
-    while (ifp.read(reinterpret_cast<char*>(&c), 1)) {
-        if (huffman_codes_map.count(c)) {
-            bit_buffer += huffman_codes_map.at(c);
-        } else {
-            std::cerr << "Warning: Character " << static_cast<int>(c) << " (0x" << std::hex << (int)c << std::dec << ") not found in Huffman codes during compression. Skipping." << std::endl;
-            continue;
-        }
+    // 处理剩余的位 (低位补0)
+    writer.finish();
+    output.write(out_buf.data(), writer.bytesWritten());
+    compressed_bytes_count += static_cast<long>(writer.bytesWritten());
+    return compressed_bytes_count;
+}
 
-        while (bit_buffer.length() >= CHAR_BIT) {
-            unsigned char byte_to_write = 0;
-            for (int i = 0; i < CHAR_BIT; ++i) {
-                if (bit_buffer[i] == '1') byte_to_write = (byte_to_write << 1) | 1;
-                else byte_to_write = byte_to_write << 1;
-            }
-            ofp.write(reinterpret_cast<const char*>(&byte_to_write), 1);
-            compressed_bytes_count++;
-            bit_buffer = bit_buffer.substr(CHAR_BIT);
-        }
+long HuffmanCompressor::buildHuffmanCodes() {
+    PhaseClock clock;
+    // 旧格式沿用最初实现的建树方式与编码, 输出与之逐字节相同; 超过最长编码限制时改用受限的规范编码
+    const int max_length = static_cast<int>(options_.max_code_length);
+    num_codewords_ = tree_builder_.buildLegacyCodewords(counts_, max_length, codewords_);
+    if (num_codewords_ == 0) {
+        unsigned char lengths[256];
+        tree_builder_.buildLengths(counts_, lengths);
+        num_codewords_ = HuffmanTreeBuilder::assignCodewords(counts_, lengths, max_length, codewords_);
     }
+    stats_.timings.tree_build = clock.lap();
 
-    // 处理剩余的位
-    if (!bit_buffer.empty()) {
-        unsigned char byte_to_write = 0;
-        for (size_t i = 0; i < bit_buffer.length(); ++i) {
-            if (bit_buffer[i] == '1') byte_to_write = (byte_to_write << 1) | 1;
-            else byte_to_write = byte_to_write << 1;
-        }
-        byte_to_write <<= (CHAR_BIT - bit_buffer.length()); // 低位补0
-        ofp.write(reinterpret_cast<const char*>(&byte_to_write), 1);
-        compressed_bytes_count++;
+    uint64_t payload_bits = 0;
+    for (size_t i = 0; i < num_codewords_; ++i) {
+        payload_bits += counts_[codewords_[i].symbol] * codewords_[i].length;
+        stats_.max_code_length = std::max<unsigned>(stats_.max_code_length, codewords_[i].length);
     }
-    return compressed_bytes_count;
+    // 编码表以字节值为下标, 编码以 (数值, 长度) 形式保存
+    encode_table_.build(codewords_, num_codewords_);
+    stats_.setSymbolStatistics(counts_, payload_bits);
+    stats_.timings.code_generation = clock.lap();
+    return static_cast<long>(num_codewords_);
 }
 
-void HuffmanCompressor::writeHuffmanTable(std::ofstream& ofp, long num_distinct_chars) {
+void HuffmanCompressor::writeHuffmanTable(ByteSink& output, long num_distinct_chars) {
     // 回填哈夫曼表起始位置
-    long current_pos_after_data = ofp.tellp(); // 获取当前位置
-    ofp.seekp(sizeof(long), std::ios::beg); // 回到文件头，写入哈夫曼表起始位置 (第二个long)
-    ofp.write(reinterpret_cast<const char*>(&current_pos_after_data), sizeof(long));
-    ofp.seekp(current_pos_after_data, std::ios::beg); // 回到之前的位置准备写入哈夫曼表
+    long current_pos_after_data = static_cast<long>(output.tell()); // 获取当前位置
+    output.patch(sizeof(long), reinterpret_cast<const unsigned char*>(&current_pos_after_data), sizeof(long)); // 哈夫曼表起始位置是文件头的第二个long
+
+    // 哈夫曼表先在内存中拼好, 再一次写出
+    std::vector<unsigned char>& table = table_buf_;
 
     // 写入有效字符的数量
-    ofp.write(reinterpret_cast<const char*>(&num_distinct_chars), sizeof(long));
+    table.resize(sizeof(long));
+    std::memcpy(table.data(), &num_distinct_chars, sizeof(long));
 
     for (long i = 0; i < num_distinct_chars; ++i) { // 遍历所有有效字符
-        ofp.write(reinterpret_cast<const char*>(&header_[i].b), 1); // 写入字符本身
-        unsigned char code_length = static_cast<unsigned char>(header_[i].bits.length());
-        ofp.write(reinterpret_cast<const char*>(&code_length), 1); // 写入编码长度
-
-        // 写入编码的字节序列
-        const std::string& current_code_to_write = header_[i].bits;
-        size_t bit_idx = 0;
-        while (bit_idx < current_code_to_write.length()) {
-            unsigned char byte_to_write = 0;
-            for (int bit_pos = 0; bit_pos < CHAR_BIT; ++bit_pos) {
-                if (bit_idx < current_code_to_write.length()) {
-                    if (current_code_to_write[bit_idx] == '1') byte_to_write = (byte_to_write << 1) | 1;
-                    else byte_to_write = byte_to_write << 1;
-                    bit_idx++;
-                } else {
-                    byte_to_write = byte_to_write << 1; // 补0
-                }
-            }
-            ofp.write(reinterpret_cast<const char*>(&byte_to_write), 1);
+        const HuffmanCodeword& cw = codewords_[i];
+        table.push_back(static_cast<unsigned char>(cw.symbol)); // 写入字符本身
+        table.push_back(cw.length); // 写入编码长度
+
+        // 写入编码的字节序列: 编码左对齐到整字节, 低位补0
+        uint64_t aligned = cw.code << ((CHAR_BIT - cw.length % CHAR_BIT) % CHAR_BIT);
+        for (int shift = (cw.length + CHAR_BIT - 1) / CHAR_BIT * CHAR_BIT - CHAR_BIT; shift >= 0; shift -= CHAR_BIT) {
+            table.push_back(static_cast<unsigned char>(aligned >> shift));
         }
     }
+    output.write(table.data(), table.size());
 }
 
 void HuffmanCompressor::compress(const std::string& input_filepath, const std::string& output_filepath) {
-    std::ifstream ifp(input_filepath, std::ios::binary);
-    if (!ifp.is_open()) {
+    // 优先以 mmap 打开输入, 两遍扫描都直接访问映射内存
+    MappedFileSource mapped_input;
+    BufferedFileSource buffered_input;
+    ByteSource* input = openFileSource(input_filepath, mapped_input, buffered_input);
+    if (input == nullptr) {
         throw std::runtime_error("文件打开失败: " + input_filepath);
     }
+    // 截断输出会破坏仍在读取 (映射) 中的输入
+    if (isSameFile(input_filepath, output_filepath)) {
+        throw std::runtime_error("压缩文件失败，输入与输出是同一个文件: " + output_filepath);
+    }
 
- 
-    std::ofstream ofp(output_filepath, std::ios::binary);
-    if (!ofp.is_open()) {
+    BufferedFileSink output;
+    if (!output.open(output_filepath)) {
         throw std::runtime_error("压缩文件失败，无法创建输出文件: " + output_filepath);
     }
 
-    // 1. 统计字符频率
-    long original_file_length = calculateFrequencies(ifp);
-    if (original_file_length == 0) {
-        std::cout << "输入文件为空或不含可压缩内容，无需压缩。" << std::endl;
-        ifp.close(); ofp.close(); return;
+    compress(*input, output);
+    output.close();
+}
+
+void HuffmanCompressor::compressStream(ByteSource& input, ByteSink& output) {
+    validateOptions(options_);
+    // 旧格式需要读两遍输入并回填头部, 流式压缩总是使用分块格式
+    CompressionOptions options = options_;
+    options.format = ContainerFormat::Chunked;
+    compressChunked(input, output, options);
+}
+
+void HuffmanCompressor::compress(std::istream& input, std::ostream& output) {
+    StreamSource source(input);
+    StreamSink sink(output);
+    report_ = &std::cerr;
+    try {
+        compressStream(source, sink);
+    } catch (...) {
+        report_ = &std::cout;
+        throw;
+    }
+    report_ = &std::cout;
+}
+
+void HuffmanCompressor::compress(int input_fd, int output_fd) {
+    BufferedFileSource source;
+    BufferedFileSink sink;
+    if (!source.attach(input_fd) || !sink.attach(output_fd)) {
+        throw std::runtime_error("压缩文件失败，无效的文件描述符");
+    }
+    report_ = &std::cerr;
+    try {
+        compressStream(source, sink);
+        sink.close();
+    } catch (...) {
+        report_ = &std::cout;
+        throw;
+    }
+    report_ = &std::cout;
+}
+
+void HuffmanCompressor::compress(const void* data, size_t size, std::vector<unsigned char>& out) {
+    static const unsigned char kEmpty[1] = {0};
+    MemorySource input(size > 0 ? static_cast<const unsigned char*>(data) : kEmpty, size);
+    out.reserve(out.size() + compressBound(size, options_));
+    VectorSink output(out);
+    compress(input, output);
+}
+
+void HuffmanCompressor::compress(std::string_view input, std::vector<unsigned char>& out) {
+    compress(input.data(), input.size(), out);
+}
+
+size_t HuffmanCompressor::compress(const void* data, size_t size, void* dst, size_t dst_capacity) {
+    static const unsigned char kEmpty[1] = {0};
+    MemorySource input(size > 0 ? static_cast<const unsigned char*>(data) : kEmpty, size);
+    MemorySink output(static_cast<unsigned char*>(dst), dst_capacity);
+    compress(input, output);
+    return static_cast<size_t>(output.tell());
+}
+
+size_t HuffmanCompressor::compressBound(size_t size) {
+    // 哈夫曼编码不会比定长8位编码更长, 因此数据部分不超过 size 字节 (再加1字节补位);
+    // 哈夫曼表为字符数量加每个字符 (字符, 长度, 最多8字节编码)
+    const size_t kHeaderSize = 2 * sizeof(long);
+    const size_t kTableSize = sizeof(long) + 256 * (2 + 8);
+    return kHeaderSize + size + 1 + kTableSize;
+}
+
+size_t HuffmanCompressor::compressBound(size_t size, const CompressionOptions& options) {
+    if (options.format == ContainerFormat::Legacy && options.dictionary == nullptr) {
+        return compressBound(size);
+    }
+    // 文件头 + 每块最坏情况 + 结束块 + 块索引
+    HuffmanFormat::blockSizeLog2(options.block_size); // 校验块大小
+    const size_t block_size = options.block_size;
+    size_t num_blocks = (size + block_size - 1) / block_size;
+    size_t bound = HuffmanFormat::kFileHeaderSize + 1;
+    if (options.dictionary != nullptr) {
+        bound += HuffmanFormat::kDictionaryIdSize;
+    }
+    if (num_blocks > 0) {
+        bound += (num_blocks - 1) * HuffmanFormat::maxBlockSize(block_size) + HuffmanFormat::maxBlockSize(size - (num_blocks - 1) * block_size);
     }
+    if (options.block_checksums) {
+        bound += num_blocks * HuffmanFormat::kChecksumSize;
+    }
+    if (options.block_index) {
+        bound += num_blocks * HuffmanFormat::kIndexEntrySize + HuffmanFormat::kFooterSize;
+    }
+    return bound;
+}
 
-    // 2. 确定实际有多少种不同的字符
-    long num_distinct_chars = 0;
-    for (int i = 0; i < 256; ++i) {
-        if (header_[i].count > 0) {
-            num_distinct_chars++;
+void HuffmanCompressor::compressChunked(ByteSource& input, ByteSink& output, const CompressionOptions& options) {
+    PhaseClock total_clock;
+    stats_ = CompressionStats();
+    const size_t block_size = options.block_size;
+    HuffmanFormat::FileHeader file_header;
+    file_header.flags = options.block_index ? HuffmanFormat::kFlagBlockIndex : 0;
+    file_header.block_size_log2 = HuffmanFormat::blockSizeLog2(block_size);
+    if (options.block_checksums) {
+        file_header.flags |= HuffmanFormat::kFlagChecksum;
+    }
+    if (options.dictionary != nullptr) {
+        file_header.flags |= HuffmanFormat::kFlagDictionary;
+        file_header.dictionary_id = options.dictionary->id();
+    }
+
+    std::vector<unsigned char>& buf = table_buf_;
+    buf.clear();
+    HuffmanFormat::writeFileHeader(buf, file_header);
+    output.write(buf.data(), buf.size());
+
+    std::vector<HuffmanFormat::IndexEntry>& index = index_;
+    index.clear();
+    uint64_t original_file_length = 0;
+    uint64_t counts[256] = {0};
+    uint64_t payload_bits = 0;
+    // 最近一个自带编码表的块的编码表, 后续块可以沿用
+    const HuffmanEncodeTable* previous = nullptr;
+
+    // 写出一块并汇总它的统计信息
+    auto writeBlock = [&](const std::vector<unsigned char>& block, size_t raw_size, const HuffmanFormat::BlockEncodeStats& block_stats) {
+        HuffmanFormat::IndexEntry entry;
+        entry.offset = output.tell();
+        entry.raw_size = static_cast<uint32_t>(raw_size);
+        index.push_back(entry);
+        original_file_length += raw_size;
+        if (options.block_checksums) {
+            // 校验和插在块头与负载之间
+            size_t header_length = HuffmanFormat::blockHeaderLength(block.data());
+            unsigned char checksum[HuffmanFormat::kChecksumSize];
+            HuffmanFormat::storeLE32(checksum, crc32c(block.data() + header_length, block.size() - header_length));
+            output.write(block.data(), header_length);
+            output.write(checksum, sizeof(checksum));
+            output.write(block.data() + header_length, block.size() - header_length);
+        } else {
+            output.write(block.data(), block.size());
+        }
+        for (int c = 0; c < 256; ++c) {
+            counts[c] += block_stats.counts[c];
+        }
+        payload_bits += block_stats.payload_bits;
+        stats_.max_code_length = std::max(stats_.max_code_length, block_stats.max_code_length);
+        stats_.timings += block_stats.timings;
+        if (hasCodeTable(block_stats)) {
+            rebuildPreviousTable(block_stats.code_lengths, previous_table_);
+            previous = &previous_table_;
+        }
+    };
+    // 从未映射的输入顺序读取一块, 不需要重新定位; 返回读到的字节数
+    auto readBlock = [&](unsigned char* block) {
+        size_t got = 0;
+        size_t n;
+        while (got < block_size && (n = input.read(block + got, block_size - got)) > 0) {
+            got += n;
+        }
+        return got;
+    };
+
+    // 映射的输入块数已知, 只有一块或只允许一个线程时直接在调用线程上编码, 不创建线程
+    const unsigned char* data = input.data();
+    const size_t size = data != nullptr ? static_cast<size_t>(input.size()) : 0;
+    unsigned threads = ThreadPool::resolveThreadCount(options.threads);
+    if (data != nullptr) {
+        threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>((size + block_size - 1) / block_size, 1)));
+    }
+    HuffmanFormat::BlockEncodeStats block_stats;
+    auto encodeBlock = [&](const unsigned char* block, size_t n) {
+        block_buf_.clear();
+        HuffmanFormat::encodeBlock(block, n, block_buf_, options, &block_stats, previous);
+        writeBlock(block_buf_, n, block_stats);
+    };
+
+    // 未映射的输入先在调用线程上读第一块, 整个输入只有一块时同样不创建线程
+    size_t first_block = 0;
+    bool pipelined = threads > 1;
+    if (data == nullptr) {
+        input_buf_.resize(block_size);
+        first_block = readBlock(input_buf_.data());
+        pipelined = first_block == block_size;
+        if (!pipelined && first_block > 0) {
+            encodeBlock(input_buf_.data(), first_block);
+        }
+    } else if (!pipelined) {
+        for (size_t pos = 0; pos < size; pos += block_size) {
+            encodeBlock(data + pos, std::min(block_size, size - pos));
         }
     }
 
-    if (num_distinct_chars == 0) {
-        std::cout << "文件中不包含任何可压缩字符" << std::endl;
-        ifp.close(); ofp.close(); return;
-    }
-    
-    // 3. 将有频率的字符节点移动到 header_数组的前面，并按频率降序排列
-    // 这一步是关键，确保后续的树构建只处理有效字符
-    std::vector<HuffmanNode> temp_active_nodes;
-    for (int i = 0; i < 256; ++i) {
-        if (header_[i].count > 0) {
-            temp_active_nodes.push_back(header_[i]);
+    if (pipelined) {
+        // 流水线: 读取线程预读各块, threads 个工作线程编码, 调用线程按顺序写出, 三者同时进行。
+        // 在途的块数由内存上限决定, 块的缓冲区在流水线内循环使用
+        struct PipelineBlock {
+            uint64_t sequence = 0;
+            const unsigned char* raw = nullptr; // 原始数据: 映射中的片段, 或者 input
+            std::vector<unsigned char> input;
+            size_t raw_size = 0;
+            std::vector<unsigned char> data;
+            HuffmanFormat::BlockEncodeStats stats;
+        };
+        const size_t block_memory = (data == nullptr ? block_size : 0) + HuffmanFormat::maxBlockSize(block_size);
+        size_t slots = 2 * static_cast<size_t>(threads) + 2;
+        if (options.max_buffered_bytes > 0) {
+            slots = std::max<size_t>(options.max_buffered_bytes / block_memory, 1);
+        }
+        std::vector<PipelineBlock> blocks(slots);
+        BoundedQueue<PipelineBlock*> free_blocks(slots);
+        BoundedQueue<PipelineBlock*> read_blocks(slots);
+        BoundedQueue<PipelineBlock*> encoded_blocks(slots);
+        for (PipelineBlock& block : blocks) {
+            free_blocks.push(&block);
+        }
+        // 任一阶段出错时关闭全部队列, 其余阶段随即退出
+        auto abort = [&]() {
+            free_blocks.close();
+            read_blocks.close();
+            encoded_blocks.close();
+        };
+
+        ThreadPool pool(threads + 1);
+        std::future<void> reader = pool.submit([&]() {
+            try {
+                uint64_t sequence = 0;
+                size_t pos = 0;
+                PipelineBlock* block;
+                while (free_blocks.pop(block)) {
+                    if (data != nullptr) {
+                        if (pos >= size) {
+                            break;
+                        }
+                        block->raw = data + pos;
+                        block->raw_size = std::min(block_size, size - pos);
+                        input.prefetch(pos, block->raw_size);
+                        pos += block->raw_size;
+                    } else {
+                        block->input.resize(block_size);
+                        if (sequence == 0) {
+                            std::memcpy(block->input.data(), input_buf_.data(), first_block);
+                            block->raw_size = first_block;
+                        } else {
+                            block->raw_size = readBlock(block->input.data());
+                        }
+                        if (block->raw_size == 0) {
+                            break;
+                        }
+                        block->raw = block->input.data();
+                    }
+                    block->sequence = sequence++;
+                    if (!read_blocks.push(block) || block->raw_size < block_size) {
+                        break;
+                    }
+                }
+            } catch (...) {
+                abort();
+                throw;
+            }
+            read_blocks.close();
+        });
+        // 工作线程不知道之前的块的编码表, 一律不沿用
+        std::atomic<unsigned> running_encoders(threads);
+        std::vector<std::future<void>> encoders;
+        for (unsigned i = 0; i < threads; ++i) {
+            encoders.push_back(pool.submit([&]() {
+                try {
+                    PipelineBlock* block;
+                    while (read_blocks.pop(block)) {
+                        block->data.clear();
+                        block->data.reserve(HuffmanFormat::maxBlockSize(block->raw_size));
+                        HuffmanFormat::encodeBlock(block->raw, block->raw_size, block->data, options, &block->stats);
+                        if (!encoded_blocks.push(block)) {
+                            break;
+                        }
+                    }
+                } catch (...) {
+                    abort();
+                    throw;
+                }
+                if (--running_encoders == 0) {
+                    encoded_blocks.close();
+                }
+            }));
+        }
+
+        // 按读入顺序写出。沿用之前的块的编码表更短时在这里重新编码, 这样输出与单线程时完全相同。
+        // 在途的块的序号相差不到 slots, 按序号对 slots 取余即可在 reorder 中排队
+        std::vector<PipelineBlock*> reorder(slots, nullptr);
+        uint64_t next = 0;
+        try {
+            PipelineBlock* block;
+            while (encoded_blocks.pop(block)) {
+                reorder[block->sequence % slots] = block;
+                while ((block = reorder[next % slots]) != nullptr) {
+                    reorder[next % slots] = nullptr;
+                    if (previous != nullptr && mayRepeatTable(block->stats) &&
+                        HuffmanFormat::estimateRepeatBlockSize(block->stats.counts, block->raw_size, *previous, options) < block->data.size()) {
+                        block->data.clear();
+                        HuffmanFormat::encodeBlock(block->raw, block->raw_size, block->data, options, &block->stats, previous);
+                    }
+                    writeBlock(block->data, block->raw_size, block->stats);
+                    next++;
+                    free_blocks.push(block);
+                }
+            }
+        } catch (...) {
+            abort();
+            throw;
+        }
+        // 读取或编码出错时队列被提前关闭, 这里重新抛出该异常
+        reader.get();
+        for (std::future<void>& encoder : encoders) {
+            encoder.get();
         }
     }
-    std::sort(temp_active_nodes.begin(), temp_active_nodes.end(), [](const HuffmanNode& a, const HuffmanNode& b) {
-        return a.count > b.count; // 降序
-    });
-    // 将排序后的节点复制回 header_数组的前部
-    for (long i = 0; i < temp_active_nodes.size(); ++i) {
-        header_[i] = temp_active_nodes[i];
-        header_[i].parent = -1; // 确保父节点重置
-        header_[i].lch = -1;
-        header_[i].rch = -1;
-        header_[i].bits = ""; // 清空编码
+
+    // 结束块与块索引
+    buf.clear();
+    buf.push_back(HuffmanFormat::kBlockEnd);
+    if (options.block_index) {
+        HuffmanFormat::Footer footer;
+        footer.total_raw_size = original_file_length;
+        footer.index_offset = output.tell() + 1;
+        footer.block_count = static_cast<uint32_t>(index.size());
+        HuffmanFormat::writeIndex(buf, index, footer);
     }
-    // 清空 header_数组中超出实际字符数量的部分（可选，但安全起见）
-    for (long i = temp_active_nodes.size(); i < 512; ++i) {
-        header_[i] = HuffmanNode(); // 重置为默认状态
+    output.write(buf.data(), buf.size());
+    output.flush();
+
+    stats_.bytes_in = original_file_length;
+    stats_.bytes_out = output.tell();
+    stats_.blocks = index.size();
+    stats_.threads = threads;
+    stats_.setSymbolStatistics(counts, payload_bits);
+    finishStats(total_clock.lap(), true);
+}
+
+void HuffmanCompressor::finishStats(double total_seconds, bool chunked) {
+    stats_.timings.total = total_seconds;
+    stats_.bits_per_symbol = stats_.bytes_in > 0 ? 8.0 * static_cast<double>(stats_.bytes_out) / static_cast<double>(stats_.bytes_in) : 0.0;
+    if (stats_callback_) {
+        stats_callback_(stats_);
+    }
+    if (options_.quiet) {
+        return;
     }
 
-    // 4. 构建哈夫曼树
-    long total_nodes_in_tree = buildHuffmanTree(num_distinct_chars);
-    if (total_nodes_in_tree == -1 && num_distinct_chars > 1) { // 只有多于一个字符才需要严格的树构建
-        throw std::runtime_error("构建哈夫曼树失败，无法压缩。");
+    double compression_ratio = 0.0;
+    if (stats_.bytes_in > 0) {
+        compression_ratio = (static_cast<double>(stats_.bytes_in) - static_cast<double>(stats_.bytes_out)) / static_cast<double>(stats_.bytes_in);
+    }
+    *report_ << "压缩文件成功！" << std::endl;
+    *report_ << "原始文件大小: " << stats_.bytes_in << " 字节" << std::endl;
+    *report_ << "压缩后文件大小: " << stats_.bytes_out << " 字节" << std::endl;
+    if (chunked) {
+        *report_ << "数据块数: " << stats_.blocks << ", 线程数: " << stats_.threads << std::endl;
+    }
+    *report_ << "压缩率为 " << compression_ratio * 100 << "%" << std::endl << std::endl;
+}
+
+void HuffmanCompressor::compress(ByteSource& input, ByteSink& output) {
+    validateOptions(options_);
+    // 字典只用于分块格式
+    if (options_.format == ContainerFormat::Chunked || options_.dictionary != nullptr) {
+        compressChunked(input, output, options_);
+        return;
+    }
+    PhaseClock total_clock;
+    PhaseClock clock;
+    stats_ = CompressionStats();
+    stats_.threads = 1;
+
+    // 1. 统计字符频率
+    long original_file_length = calculateFrequencies(input);
+    stats_.timings.histogram = clock.lap();
+    if (original_file_length == 0) {
+        stats_.timings.total = total_clock.lap();
+        if (stats_callback_) {
+            stats_callback_(stats_);
+        }
+        if (!options_.quiet) {
+            *report_ << "输入文件为空或不含可压缩内容，无需压缩。" << std::endl;
+        }
+        return;
     }
 
-    // 5. 生成哈夫曼编码
-    generateHuffmanCodes(num_distinct_chars);
+    // 2. 建树生成编码, 编码按哈夫曼表中的顺序存入 codewords_
+    long num_distinct_chars = buildHuffmanCodes();
+    clock.lap(); // 建树与生成编码的耗时已在 buildHuffmanCodes 中分别记录
+    if (num_distinct_chars == 0) {
+        if (!options_.quiet) {
+            *report_ << "文件中不包含任何可压缩字符" << std::endl;
+        }
+        return;
+    }
 
-    // 6. 写入压缩数据和头部信息（包括原始长度和哈夫曼表起始位置占位）
-    writeCompressedData(ifp, ofp, original_file_length, num_distinct_chars);
-    
-    // 7. 写入哈夫曼编码表 (包括回填哈夫曼表起始位置)
-    writeHuffmanTable(ofp, num_distinct_chars);
+    // 3. 写入压缩数据和头部信息（包括原始长度和哈夫曼表起始位置占位）
+    writeCompressedData(input, output, original_file_length);
+    stats_.timings.encode = clock.lap();
 
-    ifp.close();
-    ofp.close();
+    // 4. 写入哈夫曼编码表 (包括回填哈夫曼表起始位置)
+    writeHuffmanTable(output, num_distinct_chars);
+    output.flush();
+    stats_.timings.table_write = clock.lap();
 
-    // 8. 计算压缩率
-    long final_compressed_file_length = std::filesystem::file_size(output_filepath);
-    double compression_ratio = 0.0;
-    if (original_file_length > 0) {
-        compression_ratio = (static_cast<double>(original_file_length) - final_compressed_file_length) / original_file_length;
-    }
-    
-    std::cout << "压缩文件成功！" << std::endl;
-    std::cout << "原始文件大小: " << original_file_length << " 字节" << std::endl;
-    std::cout << "压缩后文件大小: " << final_compressed_file_length << " 字节" << std::endl;
-    std::cout << "压缩率为 " << compression_ratio * 100 << "%" << std::endl << std::endl;
-}
\ No newline at end of file
+    // 5. 汇总统计信息
+    stats_.bytes_in = static_cast<uint64_t>(original_file_length);
+    stats_.bytes_out = output.tell();
+    stats_.blocks = 1;
+    finishStats(total_clock.lap(), false);
+}
@@ -0,0 +1,337 @@
+#include "HuffmanContextModel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using HuffmanContextModel::kMaxCodeLength;
+using HuffmanContextModel::kMaxTables;
+
+// 聚类时重新分配上下文的最多轮数
+static const int kClusterIterations = 4;
+
+// 以频率 h 各自编码的最优总位数 (零阶熵)
+static double entropyBits(const uint64_t* h) {
+    uint64_t total = 0;
+    double sum = 0.0;
+    for (int c = 0; c < 256; ++c) {
+        if (h[c] > 0) {
+            total += h[c];
+            sum += static_cast<double>(h[c]) * std::log2(static_cast<double>(h[c]));
+        }
+    }
+    return total > 0 ? static_cast<double>(total) * std::log2(static_cast<double>(total)) - sum : 0.0;
+}
+
+// 规范编码表的估计位数: 每个出现的字节一个长度字节, 再加表类型与游程
+static double tableBits(const uint64_t* h) {
+    int distinct = 0;
+    for (int c = 0; c < 256; ++c) {
+        distinct += h[c] > 0 ? 1 : 0;
+    }
+    return 8.0 * (distinct + 2);
+}
+
+void HuffmanContextEncoder::mergeClusters(int into, int from) {
+    for (int c = 0; c < 256; ++c) {
+        clusters_[into][c] += clusters_[from][c];
+        clusters_[from][c] = 0;
+    }
+    for (int p = 0; p < 256; ++p) {
+        if (map_[p] == from) {
+            map_[p] = static_cast<unsigned char>(into);
+        }
+    }
+}
+
+uint64_t HuffmanContextEncoder::build(const unsigned char* data, const size_t* starts, int segments, unsigned max_tables, unsigned max_code_length) {
+    max_tables = std::min<unsigned>(std::max(max_tables, 1u), kMaxTables);
+    max_code_length_ = max_code_length == 0 ? kMaxCodeLength : std::min<unsigned>(max_code_length, kMaxCodeLength);
+
+    // 1. 字节对频率, 每段从上下文0开始
+    uint64_t totals[256] = {0};
+    for (int s = 0; s < segments; ++s) {
+        unsigned char prev = 0;
+        for (size_t i = starts[s]; i < starts[s + 1]; ++i) {
+            pairs_[prev][data[i]]++;
+            prev = data[i];
+        }
+    }
+    int active[256];
+    int num_active = 0;
+    for (int p = 0; p < 256; ++p) {
+        for (int c = 0; c < 256; ++c) {
+            totals[p] += pairs_[p][c];
+        }
+        if (totals[p] > 0) {
+            active[num_active++] = p;
+        }
+    }
+    // 总数相同时按前一个字节排序, 与稳定排序的结果相同 (std::stable_sort 会分配临时缓冲区)
+    std::sort(active, active + num_active, [&](int a, int b) { return totals[a] != totals[b] ? totals[a] > totals[b] : a < b; });
+
+    // 2. 以最常见的上下文为初始的组, 其余上下文按编码代价归入最合适的组, 反复几轮
+    const int k = std::min(static_cast<int>(max_tables), num_active);
+    std::memset(clusters_, 0, sizeof(clusters_));
+    std::memset(map_, 0, sizeof(map_));
+    for (int i = 0; i < k; ++i) {
+        map_[active[i]] = static_cast<unsigned char>(i);
+        for (int c = 0; c < 256; ++c) {
+            clusters_[i][c] = pairs_[active[i]][c];
+        }
+    }
+    float cost[kMaxTables][256];
+    for (int iteration = 0; iteration < kClusterIterations && k > 1; ++iteration) {
+        // 组内频率加0.5平滑后的 -log2(概率), 组内没有出现过的字节代价高但有限
+        for (int t = 0; t < k; ++t) {
+            uint64_t total = 0;
+            for (int c = 0; c < 256; ++c) {
+                total += clusters_[t][c];
+            }
+            const double log_total = std::log2(static_cast<double>(total) + 128.0);
+            for (int c = 0; c < 256; ++c) {
+                cost[t][c] = static_cast<float>(log_total - std::log2(static_cast<double>(clusters_[t][c]) + 0.5));
+            }
+        }
+        bool changed = false;
+        for (int i = 0; i < num_active; ++i) {
+            const int p = active[i];
+            int best = 0;
+            float best_cost = HUGE_VALF;
+            for (int t = 0; t < k; ++t) {
+                float bits = 0.0f;
+                for (int c = 0; c < 256; ++c) {
+                    bits += static_cast<float>(pairs_[p][c]) * cost[t][c];
+                }
+                if (bits < best_cost) {
+                    best_cost = bits;
+                    best = t;
+                }
+            }
+            changed |= map_[p] != best;
+            map_[p] = static_cast<unsigned char>(best);
+        }
+        std::memset(clusters_, 0, sizeof(clusters_));
+        for (int i = 0; i < num_active; ++i) {
+            const int p = active[i];
+            for (int c = 0; c < 256; ++c) {
+                clusters_[map_[p]][c] += pairs_[p][c];
+            }
+        }
+        if (!changed) {
+            break;
+        }
+    }
+
+    // 3. 合并后熵的增加少于省下的编码表时合并两组, 小块因此只保留少数几组
+    bool present[kMaxTables] = {false};
+    for (int t = 0; t < k; ++t) {
+        present[t] = std::any_of(clusters_[t], clusters_[t] + 256, [](uint64_t count) { return count > 0; });
+    }
+    while (true) {
+        int best_a = -1;
+        int best_b = -1;
+        double best_delta = 0.0;
+        for (int a = 0; a < k; ++a) {
+            for (int b = a + 1; b < k && present[a]; ++b) {
+                if (!present[b]) {
+                    continue;
+                }
+                uint64_t merged[256];
+                for (int c = 0; c < 256; ++c) {
+                    merged[c] = clusters_[a][c] + clusters_[b][c];
+                }
+                double delta = entropyBits(merged) - entropyBits(clusters_[a]) - entropyBits(clusters_[b]) -
+                               (tableBits(clusters_[a]) + tableBits(clusters_[b]) - tableBits(merged));
+                if (delta < best_delta) {
+                    best_delta = delta;
+                    best_a = a;
+                    best_b = b;
+                }
+            }
+        }
+        if (best_a < 0) {
+            break;
+        }
+        mergeClusters(best_a, best_b);
+        present[best_b] = false;
+    }
+
+    // 4. 去掉空组后重新编号, 为每组建立受限长度的规范编码
+    int renumber[kMaxTables];
+    num_tables_ = 0;
+    for (int t = 0; t < k; ++t) {
+        renumber[t] = present[t] ? num_tables_++ : 0;
+        if (present[t] && renumber[t] != t) {
+            std::memcpy(clusters_[renumber[t]], clusters_[t], sizeof(clusters_[t]));
+        }
+    }
+    num_tables_ = std::max(num_tables_, 1);
+    for (int p = 0; p < 256; ++p) {
+        map_[p] = totals[p] > 0 ? static_cast<unsigned char>(renumber[map_[p]]) : 0;
+    }
+    uint64_t bits = 0;
+    for (int t = 0; t < num_tables_; ++t) {
+        num_codewords_[t] = builder_.buildCodewords(clusters_[t], static_cast<int>(max_code_length_), codewords_[t]);
+        std::fill(entries_[t], entries_[t] + 256, 0);
+        for (size_t i = 0; i < num_codewords_[t]; ++i) {
+            const HuffmanCodeword& cw = codewords_[t][i];
+            entries_[t][cw.symbol] = static_cast<uint16_t>(cw.code << 4 | cw.length);
+            bits += clusters_[t][cw.symbol] * cw.length;
+        }
+    }
+
+    // 用过的行清零, 下次调用不必清空整张表
+    for (int i = 0; i < num_active; ++i) {
+        std::memset(pairs_[active[i]], 0, sizeof(pairs_[active[i]]));
+    }
+    return bits;
+}
+
+void HuffmanContextEncoder::encode(const unsigned char* in, size_t n, BitWriter& writer) const {
+    const uint16_t* tables[256];
+    bool zero_length = false; // 只有一种字节的组编码长度为0, BitWriter::put 不接受
+    for (int p = 0; p < 256; ++p) {
+        tables[p] = entries_[map_[p]];
+    }
+    for (int t = 0; t < num_tables_; ++t) {
+        zero_length |= num_codewords_[t] == 1;
+    }
+
+    unsigned char prev = 0;
+    size_t i = 0;
+    if (!zero_length) {
+        // 每个编码最多 kMaxCodeLength (11) 位, 刷新后寄存器最多剩7位, 可以连续放入5个编码
+        for (; i + 5 <= n; i += 5) {
+            for (int k = 0; k < 5; ++k) {
+                uint16_t entry = tables[prev][in[i + k]];
+                writer.put(entry >> 4, entry & 0xF);
+                prev = in[i + k];
+            }
+            writer.flush();
+        }
+    }
+    for (; i < n; ++i) {
+        uint16_t entry = tables[prev][in[i]];
+        if ((entry & 0xF) != 0) {
+            writer.put(entry >> 4, entry & 0xF);
+            writer.flush();
+        }
+        prev = in[i];
+    }
+}
+
+void HuffmanContextDecoder::buildTable(int t, const HuffmanCodeword* codewords, size_t count) {
+    const size_t table_size = size_t(1) << kMaxCodeLength;
+    uint16_t* entries = entries_[t];
+    std::fill(entries, entries + table_size, kInvalid);
+    // 只有一种字节时编码长度为0, 任何位模式都解码为它且不消费位
+    if (count == 1 && codewords[0].length == 0) {
+        std::fill(entries, entries + table_size, static_cast<uint16_t>(codewords[0].symbol));
+        return;
+    }
+    // 规范编码由长度分配, Kraft 和不超过1时各编码落在表内且互不重叠
+    uint64_t kraft = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (codewords[i].length == 0 || codewords[i].length > kMaxCodeLength) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        kraft += table_size >> codewords[i].length;
+    }
+    if (kraft > table_size) {
+        throw std::runtime_error("Error: block is corrupted");
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const HuffmanCodeword& cw = codewords[i];
+        size_t first = static_cast<size_t>(cw.code) << (kMaxCodeLength - cw.length);
+        std::fill(entries + first, entries + first + (table_size >> cw.length), static_cast<uint16_t>(cw.length << 8 | cw.symbol));
+    }
+}
+
+void HuffmanContextDecoder::setContextMap(const unsigned char* context_map, int num_tables) {
+    for (int p = 0; p < 256; ++p) {
+        int t = (context_map[p / 2] >> (4 * (p % 2))) & 0xF;
+        if (t >= num_tables) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        tables_[p] = entries_[t];
+    }
+}
+
+void HuffmanContextDecoder::decode(BitReader& reader, unsigned char* out, size_t count) const {
+    unsigned char prev = 0;
+    size_t produced = 0;
+    while (produced < count) {
+        reader.refill();
+        if (reader.overrun()) {
+            throw std::runtime_error("Error: Huffman bitstream ended early. File might be corrupted or incomplete.");
+        }
+        size_t n = std::min<size_t>(kSymbolsPerRefill, count - produced);
+        for (size_t k = 0; k < n; ++k) {
+            uint16_t entry = tables_[prev][reader.peek(kMaxCodeLength)];
+            if (entry == kInvalid) {
+                throw std::runtime_error("Error: invalid Huffman prefix. File might be corrupted or incomplete.");
+            }
+            prev = static_cast<unsigned char>(entry);
+            out[produced++] = prev;
+            reader.consume(entry >> 8);
+        }
+    }
+    if (reader.overrun()) {
+        throw std::runtime_error("Error: Huffman bitstream ended early. File might be corrupted or incomplete.");
+    }
+}
+
+void HuffmanContextDecoder::decodeInterleaved(BitReader* readers, unsigned char* const* out, const size_t* count) const {
+    constexpr int kStreams = HuffmanDecodeTable::kInterleavedStreams;
+    unsigned char prev[kStreams] = {0};
+    size_t produced = 0;
+    size_t common = count[0];
+    for (int s = 1; s < kStreams; ++s) {
+        common = std::min(common, count[s]);
+    }
+
+    // 每个字节的查表依赖前一个字节, 一个位流内无法并行; 各位流轮流查表, 让处理器同时执行多条依赖链
+    while (common - produced >= static_cast<size_t>(kSymbolsPerRefill)) {
+        for (int s = 0; s < kStreams; ++s) {
+            readers[s].refill();
+        }
+        for (int k = 0; k < kSymbolsPerRefill; ++k) {
+            for (int s = 0; s < kStreams; ++s) {
+                uint16_t entry = tables_[prev[s]][readers[s].peek(kMaxCodeLength)];
+                if (entry == kInvalid) {
+                    throw std::runtime_error("Error: invalid Huffman prefix. File might be corrupted or incomplete.");
+                }
+                prev[s] = static_cast<unsigned char>(entry);
+                out[s][produced + k] = prev[s];
+                readers[s].consume(entry >> 8);
+            }
+        }
+        produced += kSymbolsPerRefill;
+    }
+    for (int s = 0; s < kStreams; ++s) {
+        if (readers[s].overrun()) {
+            throw std::runtime_error("Error: Huffman bitstream ended early. File might be corrupted or incomplete.");
+        }
+    }
+
+    // 各位流剩余的部分分别解码, 上下文接着之前的字节
+    for (int s = 0; s < kStreams; ++s) {
+        for (size_t i = produced; i < count[s];) {
+            readers[s].refill();
+            size_t n = std::min<size_t>(kSymbolsPerRefill, count[s] - i);
+            for (size_t k = 0; k < n; ++k, ++i) {
+                uint16_t entry = tables_[prev[s]][readers[s].peek(kMaxCodeLength)];
+                if (entry == kInvalid) {
+                    throw std::runtime_error("Error: invalid Huffman prefix. File might be corrupted or incomplete.");
+                }
+                prev[s] = static_cast<unsigned char>(entry);
+                out[s][i] = prev[s];
+                readers[s].consume(entry >> 8);
+            }
+        }
+        if (readers[s].overrun()) {
+            throw std::runtime_error("Error: Huffman bitstream ended early. File might be corrupted or incomplete.");
+        }
+    }
+}
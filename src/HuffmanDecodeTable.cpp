@@ -0,0 +1,276 @@
+#include "HuffmanDecodeTable.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+[[noreturn]] static void throwInvalidPrefix() {
+    throw std::runtime_error("Error: invalid Huffman prefix. File might be corrupted or incomplete.");
+}
+
+[[noreturn]] static void throwEndedEarly() {
+    throw std::runtime_error("Error: Huffman bitstream ended early. File might be corrupted or incomplete.");
+}
+
+void HuffmanDecodeTable::build(const HuffmanCodeword* codewords, size_t count) {
+    trie_.assign(1, TrieNode());
+    entries_.clear();
+    max_code_length_ = 0;
+
+    // 1. 把所有编码插入前缀树, 同时检查前缀码的合法性
+    for (size_t i = 0; i < count; ++i) {
+        const HuffmanCodeword& cw = codewords[i];
+        // 只有一种符号时旧格式写出的编码长度为0, 此时每个符号不消耗任何位
+        if (cw.length > 64 || (cw.length == 0 && count != 1)) {
+            throw std::runtime_error("Huffman table is corrupted: invalid code length");
+        }
+        int node = 0;
+        for (int d = cw.length - 1; d >= 0; --d) {
+            if (trie_[node].symbol != -1) {
+                throw std::runtime_error("Huffman table is corrupted: codes are not prefix-free");
+            }
+            int bit = static_cast<int>((cw.code >> d) & 1);
+            if (trie_[node].child[bit] == -1) {
+                trie_[node].child[bit] = static_cast<int>(trie_.size());
+                trie_.push_back(TrieNode());
+            }
+            node = trie_[node].child[bit];
+        }
+        if (trie_[node].symbol != -1 || trie_[node].child[0] != -1 || trie_[node].child[1] != -1) {
+            throw std::runtime_error("Huffman table is corrupted: codes are not prefix-free");
+        }
+        trie_[node].symbol = cw.symbol;
+        max_code_length_ = std::max(max_code_length_, static_cast<int>(cw.length));
+    }
+
+    // 2. 一级表: 不超过 kRootBits 位的编码直接按编码展开, 每项先只放一个符号
+    const Entry kInvalid = {{0, 0, 0, 0}, 0, 0, 0, 0}; // count 与 sub_bits 都为0
+    entries_.assign(size_t(1) << kRootBits, kInvalid);
+    for (size_t i = 0; i < count; ++i) {
+        const HuffmanCodeword& cw = codewords[i];
+        if (cw.length > kRootBits) {
+            continue;
+        }
+        Entry entry = {{static_cast<unsigned char>(cw.symbol), 0, 0, 0}, 1, cw.length, cw.length, 0};
+        size_t first = static_cast<size_t>(cw.code << (kRootBits - cw.length));
+        std::fill(entries_.begin() + first, entries_.begin() + first + (size_t(1) << (kRootBits - cw.length)), entry);
+    }
+
+    // 3. 更长的编码所在的一级表项链接到子表, 子表在遇到时追加到 entries_ 末尾, 由前缀树逐项填充
+    std::vector<PendingTable>& pending = pending_;
+    pending.clear();
+    if (max_code_length_ > kRootBits) {
+        for (uint32_t pattern = 0; pattern < (uint32_t(1) << kRootBits); ++pattern) {
+            if (entries_[pattern].count != 0) {
+                continue;
+            }
+            int depth = 0;
+            int node = walk(0, pattern, kRootBits, depth);
+            if (node != -1) {
+                entries_[pattern] = linkSubTable(node, kRootBits);
+            }
+        }
+    }
+    for (size_t t = 0; t < pending.size(); ++t) {
+        const PendingTable table = pending[t];
+        for (uint32_t pattern = 0; pattern < (uint32_t(1) << table.bits); ++pattern) {
+            Entry entry = kInvalid;
+            int depth = 0;
+            int node = walk(table.node, pattern, table.bits, depth);
+            if (node != -1 && trie_[node].symbol != -1) {
+                entry.symbols[0] = static_cast<unsigned char>(trie_[node].symbol);
+                entry.count = 1;
+                entry.length = static_cast<unsigned char>(depth);
+                entry.first_length = static_cast<unsigned char>(depth);
+            } else if (node != -1) {
+                entry = linkSubTable(node, table.bits);
+            }
+            entries_[table.offset + pattern] = entry;
+        }
+    }
+
+    // 4. 一级表中剩余的位如果还能完整容纳后续的短编码, 一并放入同一表项。
+    //    剩余的位左对齐后在一级表中查到的第一个符号就是紧随其后的编码, 不必再走前缀树
+    for (uint32_t pattern = 0; pattern < (uint32_t(1) << kRootBits); ++pattern) {
+        Entry& entry = entries_[pattern];
+        if (entry.count == 0) {
+            continue;
+        }
+        while (entry.count < kMaxSymbolsPerEntry && entry.length < kRootBits) {
+            int rest_bits = kRootBits - entry.length;
+            uint32_t rest = pattern & ((uint32_t(1) << rest_bits) - 1);
+            const Entry& next = entries_[rest << entry.length];
+            if (next.count == 0 || next.first_length > rest_bits) {
+                break;
+            }
+            entry.symbols[entry.count] = next.symbols[0];
+            entry.count++;
+            entry.length = static_cast<unsigned char>(entry.length + next.first_length);
+        }
+    }
+}
+
+HuffmanDecodeTable::Entry HuffmanDecodeTable::linkSubTable(int node, int bits) {
+    // 走完 bits 位仍未到达叶子, 链接到以该节点为根的子表
+    int sub_bits = std::min(kRootBits, subtreeDepth(node));
+    uint32_t offset = static_cast<uint32_t>(entries_.size());
+    Entry entry = {{0, 0, 0, 0}, 0, static_cast<unsigned char>(bits), 0, static_cast<unsigned char>(sub_bits)};
+    std::memcpy(entry.symbols, &offset, sizeof(offset));
+    pending_.push_back({node, offset, sub_bits});
+    entries_.resize(entries_.size() + (size_t(1) << sub_bits));
+    return entry;
+}
+
+int HuffmanDecodeTable::walk(int node, uint32_t pattern, int bits, int& depth) const {
+    depth = 0;
+    while (depth < bits && trie_[node].symbol == -1) {
+        int bit = static_cast<int>((pattern >> (bits - 1 - depth)) & 1);
+        node = trie_[node].child[bit];
+        depth++;
+        if (node == -1) {
+            return -1;
+        }
+    }
+    return node;
+}
+
+int HuffmanDecodeTable::subtreeDepth(int node) const {
+    if (node == -1 || trie_[node].symbol != -1) {
+        return 0;
+    }
+    return 1 + std::max(subtreeDepth(trie_[node].child[0]), subtreeDepth(trie_[node].child[1]));
+}
+
+const HuffmanDecodeTable::Entry* HuffmanDecodeTable::resolveLink(BitReader& reader, const Entry* entry) const {
+    while (entry->count == 0) {
+        if (entry->sub_bits == 0) {
+            throwInvalidPrefix();
+        }
+        reader.consume(entry->length);
+        // 长编码一次消费一级表与子表两段, 总是重新装载, 否则同一轮中接连几个长编码会读到未装载的位
+        reader.refill();
+        uint32_t offset;
+        std::memcpy(&offset, entry->symbols, sizeof(offset));
+        entry = &entries_[offset + reader.peek(entry->sub_bits)];
+    }
+    return entry;
+}
+
+template <int Streams, bool HasSubTables>
+void HuffmanDecodeTable::decodeRounds(BitReader* readers, unsigned char* const* out, size_t* produced, const size_t* count) const {
+    constexpr size_t kRoundSymbols = static_cast<size_t>(kLookupsPerRefill) * kMaxSymbolsPerEntry;
+    const Entry* root = entries_.data();
+    // 在局部副本上解码: 写出的字节不会与读取器的成员重叠, 位缓冲可以留在寄存器中
+    BitReader bits[Streams];
+    unsigned char* dst[Streams];
+    for (int s = 0; s < Streams; ++s) {
+        bits[s] = readers[s];
+        dst[s] = out[s] + produced[s];
+    }
+    // 出错时先记下各位流已写出的符号数再抛出
+    auto saveProgress = [&]() {
+        for (int s = 0; s < Streams; ++s) {
+            produced[s] = static_cast<size_t>(dst[s] - out[s]);
+        }
+    };
+    auto minRemaining = [&]() {
+        size_t remaining = count[0] - static_cast<size_t>(dst[0] - out[0]);
+        for (int s = 1; s < Streams; ++s) {
+            remaining = std::min(remaining, count[s] - static_cast<size_t>(dst[s] - out[s]));
+        }
+        return remaining;
+    };
+
+    while (minRemaining() >= kRoundSymbols) {
+        bool margin = true;
+        for (int s = 0; s < Streams; ++s) {
+            margin = margin && bits[s].hasMargin(kInputMargin);
+        }
+        if (!margin) {
+            break;
+        }
+        for (int s = 0; s < Streams; ++s) {
+            bits[s].refill();
+            if (bits[s].overrun()) {
+                saveProgress();
+                throwEndedEarly();
+            }
+        }
+        for (int k = 0; k < kLookupsPerRefill; ++k) {
+            for (int s = 0; s < Streams; ++s) {
+                const Entry* entry = &root[bits[s].peek(kRootBits)];
+                if (entry->count == 0) {
+                    // 没有子表时一级表中的空项只能是无效编码
+                    saveProgress();
+                    if (HasSubTables) {
+                        // 经由临时副本调用, bits 的地址不外泄, 编译器才能继续把它留在寄存器中
+                        BitReader link = bits[s];
+                        entry = resolveLink(link, entry);
+                        bits[s] = link;
+                    } else {
+                        throwInvalidPrefix();
+                    }
+                }
+                std::memcpy(dst[s], entry->symbols, kMaxSymbolsPerEntry);
+                dst[s] += entry->count;
+                bits[s].consume(entry->length);
+            }
+        }
+    }
+    for (int s = 0; s < Streams; ++s) {
+        readers[s] = bits[s];
+    }
+    saveProgress();
+}
+
+template <int Streams>
+void HuffmanDecodeTable::dispatchRounds(BitReader* readers, unsigned char* const* out, size_t* produced, const size_t* count) const {
+    // 最长编码不超过 kRootBits 时不存在子表 (长度受限的编码表、LZ 与上下文编码的字面量表都是如此)
+    if (max_code_length_ > kRootBits) {
+        decodeRounds<Streams, true>(readers, out, produced, count);
+    } else {
+        decodeRounds<Streams, false>(readers, out, produced, count);
+    }
+}
+
+size_t HuffmanDecodeTable::decode(BitReader& reader, unsigned char* out, size_t count) const {
+    size_t produced = 0;
+    return decode(reader, out, count, produced);
+}
+
+size_t HuffmanDecodeTable::decode(BitReader& reader, unsigned char* out, size_t count, size_t& produced) const {
+    produced = 0;
+    dispatchRounds<1>(&reader, &out, &produced, &count);
+
+    // 尾部: 每次只取一个符号, 避免越过原始长度
+    const Entry* root = entries_.data();
+    while (produced < count && reader.hasMargin(kInputMargin)) {
+        reader.refill();
+        if (reader.overrun()) {
+            throwEndedEarly();
+        }
+        const Entry* entry = &root[reader.peek(kRootBits)];
+        if (entry->count == 0) {
+            entry = resolveLink(reader, entry);
+        }
+        out[produced++] = entry->symbols[0];
+        reader.consume(entry->first_length);
+    }
+    if (reader.overrun()) {
+        throwEndedEarly();
+    }
+    return produced;
+}
+
+void HuffmanDecodeTable::decodeInterleaved(BitReader* readers, unsigned char* const* out, const size_t* count) const {
+    size_t produced[kInterleavedStreams] = {0};
+    dispatchRounds<kInterleavedStreams>(readers, out, produced, count);
+
+    // 各位流剩余的部分分别解码
+    for (int s = 0; s < kInterleavedStreams; ++s) {
+        size_t wanted = count[s] - produced[s];
+        if (decode(readers[s], out[s] + produced[s], wanted) != wanted) {
+            throwEndedEarly();
+        }
+    }
+}
@@ -2,140 +2,856 @@
 #include <iostream>
 #include <algorithm>
 #include <stdexcept> 
-#include <filesystem>
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+#include <vector>
+#include "ThreadPool.h"
+#include "HuffmanDictionary.h"
+#include "Checksum.h"
 HuffmanDecompressor::HuffmanDecompressor() {
 }
 
-void HuffmanDecompressor::readFileHeader(std::ifstream& ifp, long& original_file_length, long& huffman_table_start_pos) {
-    ifp.read(reinterpret_cast<char*>(&original_file_length), sizeof(long));
-    ifp.read(reinterpret_cast<char*>(&huffman_table_start_pos), sizeof(long));
+HuffmanDecompressor::HuffmanDecompressor(const DecompressionOptions& options) : options_(options) {
 }
 
-long HuffmanDecompressor::readHuffmanTable(std::ifstream& ifp, long huffman_table_start_pos) {
-    ifp.seekg(huffman_table_start_pos, std::ios::beg);
+// 文件头声明了字典时紧跟着读出字典 ID
+static void readDictionaryId(ByteSource& input, HuffmanFormat::FileHeader& file_header) {
+    if (file_header.flags & HuffmanFormat::kFlagDictionary) {
+        unsigned char id[HuffmanFormat::kDictionaryIdSize];
+        input.readExact(id, sizeof(id));
+        file_header.dictionary_id = HuffmanFormat::loadLE32(id);
+    }
+}
+
+// 文件头声明了校验和时比对块负载的 CRC32C
+static void checkBlockChecksum(const HuffmanFormat::FileHeader& file_header, const HuffmanFormat::BlockHeader& block, const unsigned char* payload) {
+    if ((file_header.flags & HuffmanFormat::kFlagChecksum) && crc32c(payload, static_cast<size_t>(block.payload_size)) != block.checksum) {
+        throw std::runtime_error("Error: block checksum mismatch. File is corrupted.");
+    }
+}
+
+void HuffmanDecompressor::reset() {
+    stats_ = CompressionStats();
+    std::vector<unsigned char>().swap(input_buf_);
+    std::vector<unsigned char>().swap(decode_buf_);
+    std::vector<HuffmanFormat::IndexEntry>().swap(index_);
+}
+
+bool HuffmanDecompressor::readFileHeader(ByteSource& input, long& original_file_length, long& huffman_table_start_pos) {
+    unsigned char header[2 * sizeof(long)];
+    size_t got = 0;
+    size_t n;
+    while (got < sizeof(header) && (n = input.read(header + got, sizeof(header) - got)) > 0) {
+        got += n;
+    }
+    if (got < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&original_file_length, header, sizeof(long));
+    std::memcpy(&huffman_table_start_pos, header + sizeof(long), sizeof(long));
+    return true;
+}
+
+long HuffmanDecompressor::readHuffmanTable(ByteSource& input, long huffman_table_start_pos) {
+    if (huffman_table_start_pos < static_cast<long>(2 * sizeof(long)) || !input.seek(huffman_table_start_pos)) {
+        throw std::runtime_error("Error: invalid Huffman table position");
+    }
     long num_chars_in_table;
-    ifp.read(reinterpret_cast<char*>(&num_chars_in_table), sizeof(long));
+    input.readExact(&num_chars_in_table, sizeof(long));
+    if (num_chars_in_table > 256) {
+        throw std::runtime_error("Error: Huffman table is corrupted");
+    }
 
-    for (long i = 0; i < num_chars_in_table; ++i) { // 读入header_数组
-        ifp.read(reinterpret_cast<char*>(&header_[i].b), 1); // 字符本身
-        unsigned char code_length_uc;
-        ifp.read(reinterpret_cast<char*>(&code_length_uc), 1); // 编码长度
-        long code_length = static_cast<long>(code_length_uc);
-        
-        header_[i].count = code_length; // 解压时count用来存储编码长度
-        header_[i].bits = ""; // 清空编码字符串
+    for (long i = 0; i < num_chars_in_table; ++i) { // 读入编码表
+        unsigned char entry[2]; // 字符本身与编码长度
+        input.readExact(entry, sizeof(entry));
+        if (entry[1] > 64) {
+            throw std::runtime_error("Huffman code longer than 64 bits is not supported");
+        }
+        HuffmanCodeword& cw = codewords_[i];
+        cw.symbol = entry[0];
+        cw.length = entry[1];
 
-        long bytes_to_read = (code_length + CHAR_BIT - 1) / CHAR_BIT; // 计算编码需要多少字节存储
-        for (long j = 0; j < bytes_to_read; ++j) {
-            unsigned char byte_read;
-            ifp.read(reinterpret_cast<char*>(&byte_read), 1);
-            header_[i].bits += byteToBinaryString(byte_read); // 将字节转为二进制字符串并追加
+        // 编码按字节左对齐存储, 低位补0
+        unsigned char code_bytes[8];
+        size_t bytes_to_read = (cw.length + CHAR_BIT - 1) / CHAR_BIT;
+        input.readExact(code_bytes, bytes_to_read);
+        uint64_t aligned = 0;
+        for (size_t j = 0; j < bytes_to_read; ++j) {
+            aligned = (aligned << CHAR_BIT) | code_bytes[j];
         }
-        header_[i].bits = header_[i].bits.substr(0, code_length); // 根据实际编码长度截断
+        cw.code = cw.length == 0 ? 0 : aligned >> (bytes_to_read * CHAR_BIT - cw.length);
     }
     return num_chars_in_table;
 }
 
-void HuffmanDecompressor::sortHuffmanCodesByLength(long num_chars_in_table) {
-    std::sort(header_, header_ + num_chars_in_table, [](const HuffmanNode& a, const HuffmanNode& b) {
-        return a.bits.length() < b.bits.length(); // 按编码长度升序排列
-    });
+void HuffmanDecompressor::buildDecodeTable(long num_chars_in_table) {
+    decode_table_.build(codewords_, static_cast<size_t>(num_chars_in_table));
 }
 
-long HuffmanDecompressor::decodeAndWriteData(std::ifstream& ifp, std::ofstream& ofp, long original_file_length, long num_chars_in_table) {
-    ifp.seekg(2 * sizeof(long), std::ios::beg); // 回到压缩数据开始的位置 (跳过两个long的头部)
+long HuffmanDecompressor::decodeAndWriteData(ByteSource& input, ByteSink& output, long original_file_length, long huffman_table_start_pos, bool strict) {
+    const size_t kInputChunk = 1 << 20;
+    const size_t kOutputChunk = 1 << 20;
 
-    long decoded_chars_count = 0;
-    std::string bit_buffer = "";
-    size_t max_code_len = 0;
+    long remaining_input = huffman_table_start_pos - static_cast<long>(2 * sizeof(long)); // 压缩数据位于头部与哈夫曼表之间
+    // 缓冲区在多次调用之间复用, 输出缓冲区不超过原始长度
+    std::vector<unsigned char>& in_buf = input_buf_;
+    std::vector<unsigned char>& out_buf = decode_buf_;
+    out_buf.resize(std::min(kOutputChunk, static_cast<size_t>(std::max(original_file_length, 1L))));
+    size_t in_len = 0;
+    BitReader reader;
+    const unsigned char* window_end = nullptr; // 当前输入窗口的末尾
 
-    // 找到最长哈夫曼编码的长度，用于优化读取缓冲区
-    if (num_chars_in_table > 0) {
-        max_code_len = header_[num_chars_in_table - 1].bits.length(); // 因为已经按长度排序，取最后一个
+    if (input.data() != nullptr) {
+        // 输入已映射到内存, 直接在映射上解码
+        const unsigned char* data_begin = input.data() + 2 * sizeof(long);
+        window_end = data_begin + remaining_input;
+        reader.reset(data_begin, window_end, true);
+        remaining_input = 0;
     } else {
-        std::cerr << "Warning: Huffman code table is empty. Cannot decompress." << std::endl;
+        if (!input.seek(2 * sizeof(long))) { // 回到压缩数据开始的位置 (跳过两个long的头部)
+            throw std::runtime_error("Error: input is not seekable");
+        }
+        in_buf.resize(kInputChunk + HuffmanDecodeTable::kInputMargin);
+        window_end = in_buf.data();
+        reader.reset(in_buf.data(), window_end, remaining_input <= 0);
+    }
+
+    // 每个字符至少占1位, 原始长度不超过压缩数据位数时才按头部记录的长度预留输出, 以免损坏的头部导致巨大的预留;
+    // 输出端支持预留时直接解码到其中, 不经过 out_buf
+    unsigned char* direct = nullptr;
+    const long payload_size = huffman_table_start_pos - static_cast<long>(2 * sizeof(long));
+    if (original_file_length > 0 && payload_size > 0 && original_file_length / CHAR_BIT <= payload_size) {
+        direct = output.reserve(static_cast<size_t>(original_file_length));
+    }
+
+    long decoded_chars_count = 0;
+    try {
+        while (decoded_chars_count < original_file_length) {
+            // 把未消费的输入挪到缓冲区开头, 再从文件中补满
+            if (!reader.hasMargin(HuffmanDecodeTable::kInputMargin)) {
+                size_t unread = in_len - (reader.position() - in_buf.data());
+                std::memmove(in_buf.data(), reader.position(), unread);
+                size_t to_read = static_cast<size_t>(std::min(static_cast<long>(in_buf.size() - unread), remaining_input));
+                size_t got = 0;
+                size_t n;
+                while (got < to_read && (n = input.read(in_buf.data() + unread + got, to_read - got)) > 0) {
+                    got += n;
+                }
+                remaining_input = (got == to_read) ? remaining_input - static_cast<long>(got) : 0;
+                in_len = unread + got;
+                window_end = in_buf.data() + in_len;
+                reader.rebase(in_buf.data(), window_end, remaining_input <= 0);
+            }
+
+            size_t wanted = static_cast<size_t>(std::min(static_cast<long>(out_buf.size()), original_file_length - decoded_chars_count));
+            unsigned char* target = direct != nullptr ? direct + decoded_chars_count : out_buf.data();
+            size_t produced = 0;
+            // 出错的这一次调用在出错之前解码的部分也照常写出, 直接解码与经由 out_buf 写出的结果一致
+            auto keep = [&]() {
+                if (direct == nullptr) {
+                    output.write(out_buf.data(), produced);
+                }
+                decoded_chars_count += static_cast<long>(produced);
+            };
+            try {
+                decode_table_.decode(reader, target, wanted, produced);
+            } catch (const std::runtime_error&) {
+                keep();
+                throw;
+            }
+            keep();
+        }
+        // 校验时压缩数据必须恰好用完, 只允许最后一个字节中补齐的位; 否则头部记录的长度比实际的短
+        if (strict) {
+            uint64_t unread_bits = static_cast<uint64_t>(std::max(remaining_input, 0L) + (window_end - reader.position())) * CHAR_BIT;
+            if (unread_bits + static_cast<uint64_t>(std::max(reader.bufferedInputBits(), 0)) >= CHAR_BIT) {
+                throw std::runtime_error("Error: decoded length does not match the header. File is corrupted.");
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        if (strict) {
+            if (direct != nullptr) {
+                output.commit(static_cast<size_t>(decoded_chars_count));
+            }
+            throw;
+        }
+        // 无法继续解码, 可能文件损坏或数据不完整
+        if (!options_.quiet) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+    if (direct != nullptr) {
+        output.commit(static_cast<size_t>(decoded_chars_count)); // 保留出错之前解码的部分
+    }
+    return decoded_chars_count;
+}
+
+void HuffmanDecompressor::decompress(const std::string& input_filepath, const std::string& output_filepath) {
+    MappedFileSource mapped_input;
+    BufferedFileSource buffered_input;
+    ByteSource* input = openFileSource(input_filepath, mapped_input, buffered_input);
+    if (input == nullptr) {
+        throw std::runtime_error("Error: fail to open file: " + input_filepath);
+    }
+    // 截断输出会破坏仍在读取 (映射) 中的输入
+    if (isSameFile(input_filepath, output_filepath)) {
+        throw std::runtime_error("Error: input and output are the same file: " + output_filepath);
+    }
+
+    // 普通文件直接解码到映射中, 无法映射的输出退回到缓冲写入
+    MappedFileSink mapped_output;
+    BufferedFileSink buffered_output;
+    ByteSink* output = &mapped_output;
+    if (!mapped_output.open(output_filepath)) {
+        if (!buffered_output.open(output_filepath)) {
+            throw std::runtime_error("fail to decompress fiel, can not create output file: " + output_filepath);
+        }
+        output = &buffered_output;
+    }
+
+    decompress(*input, *output);
+    mapped_output.close();
+    buffered_output.close();
+}
+
+void HuffmanDecompressor::decompress(const std::string& input_filepath, const std::string& output_filepath, MappedFileSource& mapped_output) {
+    decompress(input_filepath, output_filepath);
+    if (!mapped_output.open(output_filepath)) {
+        throw std::runtime_error("Error: fail to map file: " + output_filepath);
+    }
+}
+
+void HuffmanDecompressor::decompress(std::istream& input, std::ostream& output) {
+    StreamSource source(input);
+    StreamSink sink(output);
+    report_ = &std::cerr;
+    try {
+        decompress(source, sink);
+    } catch (...) {
+        report_ = &std::cout;
+        throw;
+    }
+    report_ = &std::cout;
+}
+
+void HuffmanDecompressor::decompress(int input_fd, int output_fd) {
+    BufferedFileSource source;
+    BufferedFileSink sink;
+    if (!source.attach(input_fd) || !sink.attach(output_fd)) {
+        throw std::runtime_error("Error: invalid file descriptor");
+    }
+    report_ = &std::cerr;
+    try {
+        decompress(source, sink);
+        sink.close();
+    } catch (...) {
+        report_ = &std::cout;
+        throw;
+    }
+    report_ = &std::cout;
+}
+
+void HuffmanDecompressor::decompress(const void* data, size_t size, std::vector<unsigned char>& out) {
+    static const unsigned char kEmpty[1] = {0};
+    MemorySource input(size > 0 ? static_cast<const unsigned char*>(data) : kEmpty, size);
+    VectorSink output(out);
+    decompress(input, output);
+}
+
+void HuffmanDecompressor::decompress(std::string_view input, std::vector<unsigned char>& out) {
+    decompress(input.data(), input.size(), out);
+}
+
+size_t HuffmanDecompressor::decompress(const void* data, size_t size, void* dst, size_t dst_capacity) {
+    static const unsigned char kEmpty[1] = {0};
+    MemorySource input(size > 0 ? static_cast<const unsigned char*>(data) : kEmpty, size);
+    MemorySink output(static_cast<unsigned char*>(dst), dst_capacity);
+    decompress(input, output);
+    return static_cast<size_t>(output.tell());
+}
+
+size_t HuffmanDecompressor::decompressedSize(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    if (HuffmanFormat::isChunkedHeader(bytes, size)) {
+        try {
+            HuffmanFormat::FileHeader file_header = HuffmanFormat::parseFileHeader(bytes);
+            const size_t header_size = HuffmanFormat::fileHeaderSize(file_header);
+            if ((file_header.flags & HuffmanFormat::kFlagBlockIndex) && size >= header_size + HuffmanFormat::kFooterSize) {
+                return static_cast<size_t>(HuffmanFormat::parseFooter(bytes + size - HuffmanFormat::kFooterSize).total_raw_size);
+            }
+            // 没有块索引时逐块累加原始长度, 只读块头
+            MemorySource input(bytes, size);
+            HuffmanFormat::BlockStreamReader reader(input, header_size);
+            uint64_t total = 0;
+            HuffmanFormat::BlockHeader block;
+            while ((block = HuffmanFormat::readBlockHeader(reader, file_header)).type != HuffmanFormat::kBlockEnd) {
+                total += block.raw_size;
+                reader.skip(block.payload_size);
+            }
+            return static_cast<size_t>(total);
+        } catch (const std::runtime_error&) {
+            return 0;
+        }
+    }
+
+    long original_file_length = 0;
+    if (size < 2 * sizeof(long)) {
         return 0;
     }
+    std::memcpy(&original_file_length, data, sizeof(long));
+    return original_file_length > 0 ? static_cast<size_t>(original_file_length) : 0;
+}
 
-    while (decoded_chars_count < original_file_length) {
-        // 确保缓冲区足够长以匹配最长的编码，或者直到文件结束
-        while (bit_buffer.length() < max_code_len && ifp.good()) {
-            unsigned char byte_read;
-            if (ifp.read(reinterpret_cast<char*>(&byte_read), 1)) {
-                bit_buffer += byteToBinaryString(byte_read);
-            } else {
-                break; // 文件结束或读取错误
+size_t HuffmanDecompressor::decodeBlocks(ByteSource& input, uint64_t start_offset, const HuffmanFormat::FileHeader& file_header, size_t max_blocks,
+                                         uint64_t table_offset, unsigned char* dst, size_t dst_size,
+                                         const std::function<void(const unsigned char*, size_t)>& emit) {
+    const HuffmanDictionary* dictionary = findDictionary(file_header);
+    // 沿用编码表的块需要最近一个自带编码表的块: 单线程时它的解码表就在 decode_table_ 中,
+    // 多线程时各线程由它的负载重新建表, 映射的输入直接引用映射中的负载, 否则共享一份副本
+    bool table_ready = false;
+    const unsigned char* table_payload = nullptr;
+    size_t table_payload_size = 0;
+    std::shared_ptr<const std::vector<unsigned char>> table_copy;
+    if (table_offset != 0) {
+        if (input.data() == nullptr && !input.seek(table_offset)) {
+            throw std::runtime_error("Error: input is not seekable");
+        }
+        HuffmanFormat::BlockStreamReader table_reader(input, table_offset);
+        HuffmanFormat::BlockHeader block = HuffmanFormat::readBlockHeader(table_reader, file_header);
+        table_payload_size = static_cast<size_t>(block.payload_size);
+        table_payload = table_reader.take(table_payload_size);
+        if (!HuffmanFormat::blockHasCodeTable(block.type, table_payload, table_payload_size)) {
+            throw std::runtime_error("Error: block index is corrupted");
+        }
+        if (input.data() == nullptr) {
+            table_copy = std::make_shared<const std::vector<unsigned char>>(table_payload, table_payload + table_payload_size);
+            table_payload = table_copy->data();
+            if (!input.seek(start_offset)) {
+                throw std::runtime_error("Error: input is not seekable");
             }
         }
+        HuffmanFormat::buildBlockTable(table_payload, table_payload_size, decode_table_);
+        table_ready = true;
+    }
+
+    HuffmanFormat::BlockStreamReader reader(input, start_offset);
+    size_t num_blocks = 0;
+    size_t dst_offset = 0; // 直接解码时下一块在 dst 中的位置
+    auto directTarget = [&](uint64_t raw_size) -> unsigned char* {
+        if (dst == nullptr) {
+            return nullptr;
+        }
+        if (raw_size > dst_size - dst_offset) {
+            throw std::runtime_error("Error: block index is corrupted");
+        }
+        unsigned char* target = dst + dst_offset;
+        dst_offset += static_cast<size_t>(raw_size);
+        return target;
+    };
+    unsigned threads = std::min<size_t>(ThreadPool::resolveThreadCount(options_.threads), max_blocks);
+    if (threads > 1 && input.data() != nullptr) {
+        // 映射的输入先只读块头数一数, 块数少于线程数时按块数建线程, 只有一块时不建线程池
+        HuffmanFormat::BlockStreamReader counter(input, start_offset);
+        unsigned blocks = 0;
+        HuffmanFormat::BlockHeader block;
+        while (blocks < threads && (block = HuffmanFormat::readBlockHeader(counter, file_header)).type != HuffmanFormat::kBlockEnd) {
+            counter.skip(block.payload_size);
+            blocks++;
+        }
+        threads = std::min(threads, blocks);
+    }
+    stats_.threads = std::max(threads, 1u);
 
-        bool found_match = false;
-        // 优化：从短到长尝试匹配，因为表已经按长度排序。
-        // 但这里直接遍历整个表也可以，因为map或vector的查找效率已经足够。
-        for (long i = 0; i < num_chars_in_table; ++i) { // 遍历所有哈夫曼编码进行匹配
-            const std::string& current_code = header_[i].bits;
-            if (bit_buffer.length() >= current_code.length() && 
-                bit_buffer.substr(0, current_code.length()) == current_code) {
-                
-                unsigned char decoded_char = header_[i].b;
-                ofp.write(reinterpret_cast<const char*>(&decoded_char), 1);
-                decoded_chars_count++;
-
-                bit_buffer = bit_buffer.substr(current_code.length()); // 移除已解码的前缀
-                found_match = true;
-                break; // 找到一个字符，重新开始匹配
+    if (threads <= 1) {
+        // 单线程时直接在调用线程上解码, 复用成员解码表与缓冲区
+        std::vector<unsigned char>& out_buf = decode_buf_;
+        for (; num_blocks < max_blocks; ++num_blocks) {
+            HuffmanFormat::BlockHeader block = HuffmanFormat::readBlockHeader(reader, file_header);
+            if (block.type == HuffmanFormat::kBlockEnd) {
+                break;
+            }
+            const unsigned char* payload = reader.take(static_cast<size_t>(block.payload_size));
+            checkBlockChecksum(file_header, block, payload);
+            const size_t raw_size = static_cast<size_t>(block.raw_size);
+            unsigned char* target = directTarget(block.raw_size);
+            if (target == nullptr) {
+                out_buf.resize(raw_size);
+                target = out_buf.data();
             }
+            HuffmanFormat::decodeBlock(block.type, payload, static_cast<size_t>(block.payload_size), target, raw_size, decode_table_, table_ready,
+                                       &stats_.timings, dictionary);
+            emit(target, raw_size);
         }
+        stats_.blocks = num_blocks;
+        stats_.bytes_in = reader.position();
+        return num_blocks;
+    }
 
-        if (!found_match) {
-            // 如果缓冲区还有数据但无法匹配任何编码，可能文件损坏或数据不完整
-            if (!bit_buffer.empty() && decoded_chars_count < original_file_length) {
-                std::cerr << "Error: Could not decode Huffman prefix. File might be corrupted or incomplete." << std::endl;
+    ThreadPool pool(threads);
+    // 同时在途的块数有上限, 解码结果最多只需缓存这么多块
+    const size_t max_in_flight = 2 * static_cast<size_t>(pool.size());
+    struct DecodedBlock {
+        std::vector<unsigned char> data; // 直接解码到 dst 时为空
+        const unsigned char* target = nullptr;
+        size_t size = 0;
+        PhaseTimings timings;
+    };
+    std::deque<std::future<DecodedBlock>> pending;
+    auto emitOldest = [&]() {
+        DecodedBlock block = pending.front().get();
+        pending.pop_front();
+        stats_.timings += block.timings;
+        emit(block.target != nullptr ? block.target : block.data.data(), block.size);
+    };
+
+    for (; num_blocks < max_blocks; ++num_blocks) {
+        HuffmanFormat::BlockHeader block = HuffmanFormat::readBlockHeader(reader, file_header);
+        if (block.type == HuffmanFormat::kBlockEnd) {
+            break;
+        }
+        if (pending.size() >= max_in_flight) {
+            emitOldest();
+        }
+        size_t raw_size = static_cast<size_t>(block.raw_size);
+        size_t payload_size = static_cast<size_t>(block.payload_size);
+        const unsigned char* payload = reader.take(payload_size);
+        checkBlockChecksum(file_header, block, payload);
+        // 映射的输入直接引用映射中的负载, 否则复制一份交给解码线程
+        std::shared_ptr<const std::vector<unsigned char>> payload_copy;
+        if (input.data() == nullptr) {
+            payload_copy = std::make_shared<const std::vector<unsigned char>>(payload, payload + payload_size);
+            payload = payload_copy->data();
+        }
+        const bool repeats = HuffmanFormat::blockRepeatsCodeTable(block.type, payload, payload_size);
+        unsigned char* target = directTarget(block.raw_size); // 各块在 dst 中的范围互不重叠, 解码线程各写各的
+        pending.push_back(pool.submit([block_type = block.type, payload, payload_size, raw_size, payload_copy, dictionary, target,
+                                       repeat_payload = repeats ? table_payload : nullptr, repeat_size = table_payload_size, table_copy]() {
+            thread_local HuffmanDecodeTable table; // 每个线程复用自己的解码表
+            DecodedBlock decoded;
+            bool table_ready = false;
+            if (repeat_payload != nullptr) {
+                PhaseClock clock;
+                HuffmanFormat::buildBlockTable(repeat_payload, repeat_size, table);
+                decoded.timings.table_read += clock.lap();
+                table_ready = true;
+            }
+            unsigned char* out = target;
+            if (out == nullptr) {
+                decoded.data.resize(raw_size);
+                out = decoded.data.data();
             }
-            break; // 无法解码，退出循环
+            HuffmanFormat::decodeBlock(block_type, payload, payload_size, out, raw_size, table, table_ready, &decoded.timings, dictionary);
+            decoded.target = target;
+            decoded.size = raw_size;
+            return decoded;
+        }));
+        if (HuffmanFormat::blockHasCodeTable(block.type, payload, payload_size)) {
+            table_payload = payload;
+            table_payload_size = payload_size;
+            table_copy = payload_copy;
         }
     }
-    return decoded_chars_count;
+    while (!pending.empty()) {
+        emitOldest();
+    }
+    stats_.blocks = num_blocks;
+    stats_.bytes_in = reader.position();
+    return num_blocks;
 }
 
-void HuffmanDecompressor::decompress(const std::string& input_filepath, const std::string& output_filepath) {
-    std::ifstream ifp(input_filepath, std::ios::binary);
-    if (!ifp.is_open()) {
+const HuffmanDictionary* HuffmanDecompressor::findDictionary(const HuffmanFormat::FileHeader& file_header) const {
+    if (!(file_header.flags & HuffmanFormat::kFlagDictionary)) {
+        return nullptr;
+    }
+    for (const std::shared_ptr<const HuffmanDictionary>& dictionary : options_.dictionaries) {
+        if (dictionary != nullptr && dictionary->id() == file_header.dictionary_id) {
+            return dictionary.get();
+        }
+    }
+    throw std::runtime_error("Error: archive requires dictionary " + std::to_string(file_header.dictionary_id) + " which was not provided");
+}
+
+void HuffmanDecompressor::finishStats(double total_seconds) {
+    stats_.timings.total = total_seconds;
+    stats_.bits_per_symbol = stats_.bytes_out > 0 ? 8.0 * static_cast<double>(stats_.bytes_in) / static_cast<double>(stats_.bytes_out) : 0.0;
+    if (stats_callback_) {
+        stats_callback_(stats_);
+    }
+}
+
+void HuffmanDecompressor::decompressChunked(ByteSource& input, ByteSink& output, const HuffmanFormat::FileHeader& file_header, bool strict) {
+    PhaseClock total_clock;
+    const uint64_t first_block_offset = HuffmanFormat::fileHeaderSize(file_header);
+
+    // 有块索引且输入可定位时由尾部得知原始总长度, 输出端支持预留时一次预留全部输出, 各块直接解码到其中。
+    // 索引损坏时不影响按块顺序解压, 仍逐块写出; 校验时索引损坏即报错
+    unsigned char* direct = nullptr;
+    size_t direct_size = 0;
+    HuffmanFormat::Footer footer;
+    bool indexed = false;
+    try {
+        indexed = HuffmanFormat::readBlockIndex(input, file_header, index_, footer);
+    } catch (const std::runtime_error&) {
+        if (strict) {
+            throw;
+        }
+    }
+    if ((file_header.flags & HuffmanFormat::kFlagBlockIndex) && input.size() != ByteSource::kUnknownSize && !input.seek(first_block_offset)) {
+        throw std::runtime_error("Error: input is not seekable");
+    }
+    if (indexed && footer.total_raw_size > 0 && footer.total_raw_size <= SIZE_MAX) {
+        direct_size = static_cast<size_t>(footer.total_raw_size);
+        direct = output.reserve(direct_size);
+    }
+
+    // emit 只捕获一个引用, 能放进 std::function 的内部存储, 不分配内存
+    struct EmitState {
+        ByteSink& output;
+        const unsigned char* direct;
+        uint64_t decoded_length;
+    } emit_state{output, direct, 0};
+    uint64_t& decoded_actual_length = emit_state.decoded_length;
+    size_t num_blocks = 0;
+    try {
+        num_blocks = decodeBlocks(input, first_block_offset, file_header, SIZE_MAX, 0, direct, direct_size, [&emit_state](const unsigned char* block, size_t n) {
+            if (emit_state.direct == nullptr) {
+                emit_state.output.write(block, n);
+            }
+            emit_state.decoded_length += n;
+        });
+        if ((direct != nullptr || (strict && indexed)) && decoded_actual_length != footer.total_raw_size) {
+            throw std::runtime_error("Error: block index is corrupted");
+        }
+    } catch (...) {
+        if (direct != nullptr) {
+            output.commit(static_cast<size_t>(decoded_actual_length)); // 与逐块写出一致, 保留出错之前按顺序解码的块
+        }
+        throw;
+    }
+    if (direct != nullptr) {
+        output.commit(direct_size);
+    }
+    output.flush();
+
+    // 块索引与尾部不经过块读取器, 输入大小已知时以它为准
+    if (input.size() != ByteSource::kUnknownSize) {
+        stats_.bytes_in = input.size();
+    }
+    stats_.bytes_out = decoded_actual_length;
+    finishStats(total_clock.lap());
+    if (options_.quiet) {
+        return;
+    }
+    *report_ << "解压缩文件成功！" << std::endl;
+    *report_ << "数据块数: " << num_blocks << std::endl;
+    *report_ << "解压缩后文件长度: " << decoded_actual_length << " 字节" << std::endl << std::endl;
+}
+
+size_t HuffmanDecompressor::decompressRange(ByteSource& input, uint64_t offset, uint64_t length, ByteSink& output) {
+    PhaseClock total_clock;
+    stats_ = CompressionStats();
+    uint64_t range_start_offset = 0;
+
+    // 1. 读取并校验文件头
+    unsigned char prefix[HuffmanFormat::kFileHeaderSize];
+    if (!input.seek(0)) {
+        throw std::runtime_error("Error: input is not seekable");
+    }
+    input.readExact(prefix, sizeof(prefix));
+    if (!HuffmanFormat::isChunkedHeader(prefix, sizeof(prefix))) {
+        throw std::runtime_error("Error: range access requires a chunked archive");
+    }
+    HuffmanFormat::FileHeader file_header = HuffmanFormat::parseFileHeader(prefix);
+    readDictionaryId(input, file_header);
+
+    // 2. 读取块索引, 没有索引时逐块读取块头重建
+    std::vector<HuffmanFormat::IndexEntry> index;
+    HuffmanFormat::Footer footer;
+    if (!HuffmanFormat::readBlockIndex(input, file_header, index, footer)) {
+        const uint64_t first_block_offset = HuffmanFormat::fileHeaderSize(file_header);
+        if (!input.seek(first_block_offset)) {
+            throw std::runtime_error("Error: input is not seekable");
+        }
+        HuffmanFormat::BlockStreamReader reader(input, first_block_offset);
+        while (true) {
+            HuffmanFormat::IndexEntry entry;
+            entry.offset = reader.position();
+            HuffmanFormat::BlockHeader block = HuffmanFormat::readBlockHeader(reader, file_header);
+            if (block.type == HuffmanFormat::kBlockEnd) {
+                break;
+            }
+            entry.raw_size = static_cast<uint32_t>(block.raw_size);
+            index.push_back(entry);
+            reader.skip(block.payload_size);
+        }
+    }
+
+    // 3. 找出与范围相交的块: block_starts[i] 为第 i 块在原始数据中的起点
+    std::vector<uint64_t> block_starts(index.size() + 1, 0);
+    for (size_t i = 0; i < index.size(); ++i) {
+        block_starts[i + 1] = block_starts[i] + index[i].raw_size;
+    }
+    uint64_t range_end = std::min(block_starts.back(), offset + std::min(length, UINT64_MAX - offset));
+    if (offset >= range_end) {
+        finishStats(total_clock.lap());
+        return 0;
+    }
+    size_t first = static_cast<size_t>(std::upper_bound(block_starts.begin(), block_starts.end(), offset) - block_starts.begin()) - 1;
+    size_t last = static_cast<size_t>(std::upper_bound(block_starts.begin(), block_starts.end(), range_end - 1) - block_starts.begin()) - 1;
+
+    // 4. 第一块沿用之前的编码表时, 向前找到最近一个自带编码表的块
+    auto blockTableKind = [&](uint64_t block_offset) {
+        if (!input.seek(block_offset)) {
+            throw std::runtime_error("Error: input is not seekable");
+        }
+        HuffmanFormat::BlockStreamReader reader(input, block_offset);
+        HuffmanFormat::BlockHeader block = HuffmanFormat::readBlockHeader(reader, file_header);
+        if (block.type != HuffmanFormat::kBlockHuffman && block.type != HuffmanFormat::kBlockHuffman4) {
+            return -1;
+        }
+        return static_cast<int>(reader.takeByte());
+    };
+    uint64_t table_offset = 0;
+    if (blockTableKind(index[first].offset) == HuffmanFormat::kTableRepeat) {
+        size_t i = first;
+        int kind;
+        do {
+            if (i == 0) {
+                throw std::runtime_error("Error: block reuses a code table that has not been read");
+            }
+            kind = blockTableKind(index[--i].offset);
+        } while (kind != HuffmanFormat::kTableExplicit && kind != HuffmanFormat::kTableCanonical);
+        table_offset = index[i].offset;
+    }
+
+    // 5. 只解码相交的块, 写出与范围重叠的部分
+    if (!input.seek(index[first].offset)) {
+        throw std::runtime_error("Error: input is not seekable");
+    }
+    range_start_offset = index[first].offset;
+    size_t current = first;
+    size_t written = 0;
+    decodeBlocks(input, index[first].offset, file_header, last - first + 1, table_offset, nullptr, 0, [&](const unsigned char* block, size_t n) {
+        if (n != index[current].raw_size) {
+            throw std::runtime_error("Error: block index does not match block header");
+        }
+        uint64_t lo = std::max(offset, block_starts[current]);
+        uint64_t hi = std::min(range_end, block_starts[current] + n);
+        output.write(block + (lo - block_starts[current]), static_cast<size_t>(hi - lo));
+        written += static_cast<size_t>(hi - lo);
+        current++;
+    });
+    if (current != last + 1) {
+        throw std::runtime_error("Error: archive is truncated");
+    }
+    output.flush();
+
+    stats_.bytes_in -= range_start_offset; // 只计入实际读取的块
+    stats_.bytes_out = written;
+    finishStats(total_clock.lap());
+    return written;
+}
+
+size_t HuffmanDecompressor::decompressRange(const std::string& input_filepath, uint64_t offset, uint64_t length, std::vector<unsigned char>& out) {
+    MappedFileSource mapped_input;
+    BufferedFileSource buffered_input;
+    ByteSource* input = openFileSource(input_filepath, mapped_input, buffered_input);
+    if (input == nullptr) {
+        throw std::runtime_error("Error: fail to open file: " + input_filepath);
+    }
+    VectorSink output(out);
+    return decompressRange(*input, offset, length, output);
+}
+
+size_t HuffmanDecompressor::decompressRange(const void* data, size_t size, uint64_t offset, uint64_t length, std::vector<unsigned char>& out) {
+    static const unsigned char kEmpty[1] = {0};
+    MemorySource input(size > 0 ? static_cast<const unsigned char*>(data) : kEmpty, size);
+    VectorSink output(out);
+    return decompressRange(input, offset, length, output);
+}
+
+uint64_t HuffmanDecompressor::verify(ByteSource& input) {
+    PhaseClock total_clock;
+    stats_ = CompressionStats();
+    unsigned char prefix[HuffmanFormat::kFileHeaderSize];
+    size_t got = 0;
+    size_t n;
+    while (got < sizeof(prefix) && (n = input.read(prefix + got, sizeof(prefix) - got)) > 0) {
+        got += n;
+    }
+
+    // 没有校验和时只能完整解码一遍, 输出直接丢弃
+    bool chunked = HuffmanFormat::isChunkedHeader(prefix, got);
+    if (!chunked || !(prefix[5] & HuffmanFormat::kFlagChecksum)) {
+        // 旧格式的文件头不完整时 decompress 按空文件处理, 校验时视为截断
+        if (!chunked && got > 0 && input.size() != ByteSource::kUnknownSize && input.size() < 2 * sizeof(long)) {
+            throw std::runtime_error("Error: archive is truncated");
+        }
+        if (!input.seek(0)) {
+            throw std::runtime_error("Error: input is not seekable");
+        }
+        NullSink sink;
+        const bool quiet = options_.quiet;
+        options_.quiet = true;
+        try {
+            decompressImpl(input, sink, true);
+        } catch (...) {
+            options_.quiet = quiet;
+            throw;
+        }
+        options_.quiet = quiet;
+        return sink.tell();
+    }
+
+    // 有校验和时顺序读取各块比对校验和, 不解码
+    HuffmanFormat::FileHeader file_header = HuffmanFormat::parseFileHeader(prefix);
+    readDictionaryId(input, file_header);
+    HuffmanFormat::BlockStreamReader reader(input, HuffmanFormat::fileHeaderSize(file_header));
+    std::vector<HuffmanFormat::IndexEntry> blocks;
+    uint64_t total_raw_size = 0;
+    while (true) {
+        HuffmanFormat::IndexEntry entry;
+        entry.offset = reader.position();
+        HuffmanFormat::BlockHeader block = HuffmanFormat::readBlockHeader(reader, file_header);
+        if (block.type == HuffmanFormat::kBlockEnd) {
+            break;
+        }
+        checkBlockChecksum(file_header, block, reader.take(static_cast<size_t>(block.payload_size)));
+        entry.raw_size = static_cast<uint32_t>(block.raw_size);
+        blocks.push_back(entry);
+        total_raw_size += block.raw_size;
+    }
+
+    // 块索引紧跟结束块, 必须与实际的块一一对应
+    if (file_header.flags & HuffmanFormat::kFlagBlockIndex) {
+        const uint64_t index_offset = reader.position();
+        const unsigned char* index = reader.take(blocks.size() * HuffmanFormat::kIndexEntrySize + HuffmanFormat::kFooterSize);
+        HuffmanFormat::Footer footer = HuffmanFormat::parseFooter(index + blocks.size() * HuffmanFormat::kIndexEntrySize);
+        bool valid = footer.total_raw_size == total_raw_size && footer.index_offset == index_offset && footer.block_count == blocks.size();
+        for (size_t i = 0; valid && i < blocks.size(); ++i) {
+            valid = HuffmanFormat::loadLE64(index + i * HuffmanFormat::kIndexEntrySize) == blocks[i].offset &&
+                    HuffmanFormat::loadLE32(index + i * HuffmanFormat::kIndexEntrySize + 8) == blocks[i].raw_size;
+        }
+        if (!valid) {
+            throw std::runtime_error("Error: block index is corrupted");
+        }
+    }
+    if (input.size() != ByteSource::kUnknownSize && reader.position() != input.size()) {
+        throw std::runtime_error("Error: unexpected data after the end of the archive");
+    }
+
+    stats_.bytes_in = reader.position();
+    stats_.bytes_out = total_raw_size;
+    stats_.blocks = blocks.size();
+    stats_.threads = 1;
+    finishStats(total_clock.lap());
+    return total_raw_size;
+}
+
+uint64_t HuffmanDecompressor::verify(const std::string& input_filepath) {
+    MappedFileSource mapped_input;
+    BufferedFileSource buffered_input;
+    ByteSource* input = openFileSource(input_filepath, mapped_input, buffered_input);
+    if (input == nullptr) {
         throw std::runtime_error("Error: fail to open file: " + input_filepath);
     }
+    return verify(*input);
+}
 
+uint64_t HuffmanDecompressor::verify(const void* data, size_t size) {
+    static const unsigned char kEmpty[1] = {0};
+    MemorySource input(size > 0 ? static_cast<const unsigned char*>(data) : kEmpty, size);
+    return verify(input);
+}
 
-    std::ofstream ofp(output_filepath, std::ios::binary);
-    if (!ofp.is_open()) {
-        throw std::runtime_error("fail to decompress fiel, can not create output file: " + output_filepath);
+void HuffmanDecompressor::decompress(ByteSource& input, ByteSink& output) {
+    decompressImpl(input, output, false);
+}
+
+void HuffmanDecompressor::decompressImpl(ByteSource& input, ByteSink& output, bool strict) {
+    stats_ = CompressionStats();
+    // 0. 根据前8字节区分分块格式与旧格式
+    unsigned char prefix[HuffmanFormat::kFileHeaderSize];
+    size_t got = 0;
+    size_t n;
+    while (got < sizeof(prefix) && (n = input.read(prefix + got, sizeof(prefix) - got)) > 0) {
+        got += n;
+    }
+    if (HuffmanFormat::isChunkedHeader(prefix, got)) {
+        HuffmanFormat::FileHeader file_header = HuffmanFormat::parseFileHeader(prefix);
+        readDictionaryId(input, file_header);
+        decompressChunked(input, output, file_header, strict);
+        return;
     }
+    // 不足8字节而开头与分块格式的标识相符, 是截断的分块归档
+    if (got > 0 && got < sizeof(prefix) && std::memcmp(prefix, HuffmanFormat::kMagic, std::min(got, sizeof(HuffmanFormat::kMagic))) == 0) {
+        throw std::runtime_error("Error: archive is truncated");
+    }
+    if (!input.seek(0)) {
+        throw std::runtime_error("Error: input is not seekable");
+    }
+    PhaseClock total_clock;
+    PhaseClock clock;
+    stats_.threads = 1;
 
     // 1. 读取文件头部信息
     long original_file_length = 0;
     long huffman_table_start_pos = 0;
-    readFileHeader(ifp, original_file_length, huffman_table_start_pos);
+    if (!readFileHeader(input, original_file_length, huffman_table_start_pos)) {
+        if (!options_.quiet) {
+            std::cerr << "Huffman encoding table is empty or read failed, unable to decompress" << std::endl;
+        }
+        return;
+    }
+    if (input.size() != ByteSource::kUnknownSize && static_cast<uint64_t>(huffman_table_start_pos) > input.size()) {
+        throw std::runtime_error("Error: invalid Huffman table position");
+    }
 
     // 2. 读取哈夫曼编码表
-    long num_chars_in_table = readHuffmanTable(ifp, huffman_table_start_pos);
+    long num_chars_in_table = readHuffmanTable(input, huffman_table_start_pos);
+    if (strict && num_chars_in_table <= 0 && original_file_length != 0) {
+        throw std::runtime_error("Error: Huffman table is corrupted");
+    }
     if (num_chars_in_table <= 0) {
-        std::cerr << "Huffman encoding table is empty or read failed, unable to decompress" << std::endl;
-        ifp.close(); ofp.close(); return;
+        if (!options_.quiet) {
+            std::cerr << "Huffman encoding table is empty or read failed, unable to decompress" << std::endl;
+        }
+        return;
+    }
+    uint64_t table_end_pos = static_cast<uint64_t>(huffman_table_start_pos) + sizeof(long);
+    for (long i = 0; i < num_chars_in_table; ++i) {
+        table_end_pos += 2 + (codewords_[i].length + CHAR_BIT - 1) / CHAR_BIT;
     }
 
-    // 3. 对哈夫曼编码表进行排序 (按编码长度，以便解码时优先匹配短编码)
-    sortHuffmanCodesByLength(num_chars_in_table);
+    // 3. 由哈夫曼编码表生成查找表
+    buildDecodeTable(num_chars_in_table);
+    stats_.timings.table_read = clock.lap();
 
     // 4. 解码并写入数据
-    long decoded_actual_length = decodeAndWriteData(ifp, ofp, original_file_length, num_chars_in_table);
-
-    ifp.close();
-    ofp.close();
+    long decoded_actual_length = decodeAndWriteData(input, output, original_file_length, huffman_table_start_pos, strict);
+    output.flush();
+    if (strict && decoded_actual_length != original_file_length) {
+        throw std::runtime_error("Error: decoded length does not match the header. File is corrupted.");
+    }
+    stats_.timings.decode = clock.lap();
 
-    std::cout << "解压缩文件成功！" << std::endl;
-    std::cout << "原始文件长度: " << original_file_length << " 字节" << std::endl;
-    std::cout << "解压缩后文件长度: " << decoded_actual_length << " 字节" << std::endl;
+    stats_.bytes_in = input.size() != ByteSource::kUnknownSize ? input.size() : table_end_pos;
+    stats_.bytes_out = static_cast<uint64_t>(decoded_actual_length);
+    stats_.blocks = 1;
+    finishStats(total_clock.lap());
+    if (options_.quiet) {
+        return;
+    }
+    *report_ << "解压缩文件成功！" << std::endl;
+    *report_ << "原始文件长度: " << original_file_length << " 字节" << std::endl;
+    *report_ << "解压缩后文件长度: " << decoded_actual_length << " 字节" << std::endl;
     if (decoded_actual_length == original_file_length) {
-        std::cout << "解压缩文件与原文件相同！" << std::endl << std::endl;
+        *report_ << "解压缩文件与原文件相同！" << std::endl << std::endl;
     } else {
-        std::cout << "解压缩文件与原文件不符！" << std::endl << std::endl;
+        *report_ << "解压缩文件与原文件不符！" << std::endl << std::endl;
     }
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "HuffmanDictionary.h"
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "Histogram.h"
+#include "HuffmanFormat.h"
+#include "HuffmanTreeBuilder.h"
+
+static const unsigned char kDictionaryMagic[4] = {'T', 'R', 'H', 'D'};
+static const unsigned char kDictionaryVersion = 1;
+
+HuffmanDictionary HuffmanDictionary::train(const std::vector<std::string_view>& samples, uint32_t id, unsigned max_code_length) {
+    uint64_t counts[256] = {0};
+    for (std::string_view sample : samples) {
+        countBytes(reinterpret_cast<const unsigned char*>(sample.data()), sample.size(), counts);
+    }
+    return fromCounts(counts, id, max_code_length);
+}
+
+HuffmanDictionary HuffmanDictionary::fromCounts(const uint64_t* counts, uint32_t id, unsigned max_code_length) {
+    if (max_code_length < 8 || max_code_length > 64) {
+        throw std::runtime_error("Error: dictionary code length limit must be within 8..64");
+    }
+    // 每个字节的频率加1, 保证全部256个字节值都有编码
+    uint64_t smoothed[256];
+    for (int c = 0; c < 256; ++c) {
+        smoothed[c] = counts[c] + 1;
+    }
+    HuffmanTreeBuilder builder;
+    HuffmanCodeword codewords[256];
+    size_t count = builder.buildCodewords(smoothed, static_cast<int>(max_code_length), codewords);
+    unsigned char lengths[256];
+    for (size_t i = 0; i < count; ++i) {
+        lengths[codewords[i].symbol] = codewords[i].length;
+    }
+
+    if (id == 0) {
+        // FNV-1a 散列编码长度向量, 0 保留不用
+        id = 2166136261u;
+        for (unsigned char length : lengths) {
+            id = (id ^ length) * 16777619u;
+        }
+        id = id == 0 ? 1 : id;
+    }
+    HuffmanDictionary dictionary;
+    dictionary.build(lengths, id);
+    return dictionary;
+}
+
+void HuffmanDictionary::build(const unsigned char* lengths, uint32_t id) {
+    HuffmanCodeword codewords[256];
+    for (int c = 0; c < 256; ++c) {
+        codewords[c].symbol = static_cast<unsigned short>(c);
+        codewords[c].length = lengths[c];
+    }
+    assignCanonicalCodes(codewords, 256);
+    encode_table_.build(codewords, 256);
+    decode_table_.build(codewords, 256);
+    std::memcpy(lengths_, lengths, sizeof(lengths_));
+    id_ = id;
+}
+
+std::vector<unsigned char> HuffmanDictionary::serialize() const {
+    std::vector<unsigned char> out(kSerializedSize);
+    std::memcpy(out.data(), kDictionaryMagic, sizeof(kDictionaryMagic));
+    out[4] = kDictionaryVersion;
+    HuffmanFormat::storeLE32(out.data() + 5, id_);
+    std::memcpy(out.data() + 9, lengths_, sizeof(lengths_));
+    return out;
+}
+
+HuffmanDictionary HuffmanDictionary::deserialize(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    if (size != kSerializedSize || std::memcmp(bytes, kDictionaryMagic, sizeof(kDictionaryMagic)) != 0) {
+        throw std::runtime_error("Error: not a Huffman dictionary");
+    }
+    if (bytes[4] != kDictionaryVersion) {
+        throw std::runtime_error("Error: unsupported dictionary version " + std::to_string(bytes[4]));
+    }
+    HuffmanDictionary dictionary;
+    try {
+        dictionary.build(bytes + 9, HuffmanFormat::loadLE32(bytes + 5));
+    } catch (const std::runtime_error&) {
+        throw std::runtime_error("Error: Huffman dictionary is corrupted");
+    }
+    return dictionary;
+}
@@ -0,0 +1,55 @@
+#include "HuffmanEncodeTable.h"
+#include <algorithm>
+
+void HuffmanEncodeTable::build(const HuffmanCodeword* codewords, size_t count) {
+    std::fill(code_, code_ + 256, 0);
+    std::fill(length_, length_ + 256, 0);
+    max_length_ = 0;
+    for (size_t i = 0; i < count; ++i) {
+        unsigned char byte = static_cast<unsigned char>(codewords[i].symbol);
+        code_[byte] = codewords[i].code;
+        length_[byte] = codewords[i].length;
+        max_length_ = std::max(max_length_, static_cast<int>(codewords[i].length));
+    }
+}
+
+// 编码核心, 按每次刷新前放入的编码数在编译期特化, 内层循环完全展开。
+// 刷新后寄存器最多剩7位, 需保证 7 + CodesPerFlush * 最长编码不超过64; 返回编码的字节数 (CodesPerFlush 的倍数)
+template <int CodesPerFlush>
+static size_t encodeRounds(const uint64_t* code, const unsigned char* length, const unsigned char* in, size_t n, BitWriter& writer) {
+    // 在局部副本上编码: 写出的字节不会与 writer 的成员重叠, 位寄存器可以留在寄存器中
+    BitWriter bits = writer;
+    size_t i = 0;
+    for (; i + CodesPerFlush <= n; i += CodesPerFlush) {
+        for (int k = 0; k < CodesPerFlush; ++k) {
+            bits.put(code[in[i + k]], length[in[i + k]]);
+        }
+        bits.flush();
+    }
+    writer = bits;
+    return i;
+}
+
+void HuffmanEncodeTable::encode(const unsigned char* in, size_t n, BitWriter& writer) const {
+    // 只有一种符号时编码长度为0, 不产生任何位
+    if (max_length_ == 0) {
+        return;
+    }
+
+    // 按最长编码决定每次刷新前能放入几个编码, 超过56位的编码只能逐个拆开写
+    size_t i = 0;
+    switch (max_length_ <= 56 ? std::min(57 / max_length_, 8) : 0) {
+    case 8: i = encodeRounds<8>(code_, length_, in, n, writer); break;
+    case 7: i = encodeRounds<7>(code_, length_, in, n, writer); break;
+    case 6: i = encodeRounds<6>(code_, length_, in, n, writer); break;
+    case 5: i = encodeRounds<5>(code_, length_, in, n, writer); break;
+    case 4: i = encodeRounds<4>(code_, length_, in, n, writer); break;
+    case 3: i = encodeRounds<3>(code_, length_, in, n, writer); break;
+    case 2: i = encodeRounds<2>(code_, length_, in, n, writer); break;
+    case 1: i = encodeRounds<1>(code_, length_, in, n, writer); break;
+    default: break;
+    }
+    for (; i < n; ++i) {
+        writer.putLong(code_[in[i]], length_[in[i]]);
+    }
+}
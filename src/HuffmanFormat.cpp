@@ -0,0 +1,1187 @@
+#include "HuffmanFormat.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "AnsCodec.h"
+#include "Histogram.h"
+#include "Huffman.h"
+#include "HuffmanContextModel.h"
+#include "HuffmanDictionary.h"
+#include "HuffmanEncodeTable.h"
+#include "HuffmanTreeBuilder.h"
+#include "LzCodec.h"
+
+namespace HuffmanFormat {
+
+void writeVarint(std::vector<unsigned char>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+size_t varintSize(uint64_t value) {
+    size_t n = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        n++;
+    }
+    return n;
+}
+
+bool isChunkedHeader(const unsigned char* data, size_t size) {
+    return size >= kFileHeaderSize && std::memcmp(data, kMagic, sizeof(kMagic)) == 0 && data[7] == kHeaderTerminator;
+}
+
+void writeFileHeader(std::vector<unsigned char>& out, const FileHeader& header) {
+    out.insert(out.end(), kMagic, kMagic + sizeof(kMagic));
+    out.push_back(header.version);
+    out.push_back(header.flags);
+    out.push_back(header.block_size_log2);
+    out.push_back(kHeaderTerminator);
+    if (header.flags & kFlagDictionary) {
+        unsigned char id[kDictionaryIdSize];
+        storeLE32(id, header.dictionary_id);
+        out.insert(out.end(), id, id + sizeof(id));
+    }
+}
+
+FileHeader parseFileHeader(const unsigned char* data) {
+    if (!isChunkedHeader(data, kFileHeaderSize)) {
+        throw std::runtime_error("Error: not a chunked Huffman archive");
+    }
+    FileHeader header;
+    header.version = data[4];
+    header.flags = data[5];
+    header.block_size_log2 = data[6];
+    if (header.version != kVersion) {
+        throw std::runtime_error("Error: unsupported archive version " + std::to_string(header.version));
+    }
+    if (header.flags & ~(kFlagBlockIndex | kFlagDictionary | kFlagChecksum)) {
+        throw std::runtime_error("Error: unsupported archive flags");
+    }
+    if (header.block_size_log2 > kMaxBlockSizeLog2) {
+        throw std::runtime_error("Error: archive header is corrupted");
+    }
+    return header;
+}
+
+void writeIndex(std::vector<unsigned char>& out, const std::vector<IndexEntry>& index, const Footer& footer) {
+    size_t pos = out.size();
+    out.resize(pos + index.size() * kIndexEntrySize + kFooterSize);
+    unsigned char* p = out.data() + pos;
+    for (const IndexEntry& entry : index) {
+        storeLE64(p, entry.offset);
+        storeLE32(p + 8, entry.raw_size);
+        p += kIndexEntrySize;
+    }
+    storeLE64(p, footer.total_raw_size);
+    storeLE64(p + 8, footer.index_offset);
+    storeLE32(p + 16, footer.block_count);
+    std::memcpy(p + 20, kFooterMagic, sizeof(kFooterMagic));
+}
+
+Footer parseFooter(const unsigned char* data) {
+    if (std::memcmp(data + 20, kFooterMagic, sizeof(kFooterMagic)) != 0) {
+        throw std::runtime_error("Error: archive has no block index");
+    }
+    Footer footer;
+    footer.total_raw_size = loadLE64(data);
+    footer.index_offset = loadLE64(data + 8);
+    footer.block_count = loadLE32(data + 16);
+    return footer;
+}
+
+// 编码表最多占用的字节数: 表类型 + 字符数 + 每个字符最多 2 + 8 字节
+static const size_t kMaxCodeTableSize = 2 + 256 * (2 + 8);
+
+size_t maxBlockSize(size_t size) {
+    // 块头 + 编码表 + 交错位流的长度表 + 不超过原始长度的位流 (每个位流最多补1字节)
+    const size_t kBlockHeaderSize = 1 + 10 + 10;
+    const size_t kTableSize = kMaxCodeTableSize;
+    const size_t kJumpTableSize = 4 * (kInterleavedStreams - 1);
+    return kBlockHeaderSize + kTableSize + kJumpTableSize + size + kInterleavedStreams;
+}
+
+size_t blockHeaderLength(const unsigned char* block) {
+    const unsigned char* p = block + 1;
+    for (int varint = 0; varint < 2; ++varint) {
+        while (*p++ & 0x80) {
+        }
+    }
+    return static_cast<size_t>(p - block);
+}
+
+unsigned char blockSizeLog2(size_t block_size) {
+    if (block_size == 0 || block_size > (static_cast<size_t>(1) << kMaxBlockSizeLog2)) {
+        throw std::runtime_error("Error: invalid block size " + std::to_string(block_size));
+    }
+    unsigned char log2 = 0;
+    while ((static_cast<size_t>(1) << log2) < block_size) {
+        ++log2;
+    }
+    return log2;
+}
+
+// 编码表写入 out (至少 kMaxCodeTableSize 字节), 返回写入的字节数; codewords 须已按 table_kind 对应的规则分配好编码
+static size_t writeCodeTable(unsigned char* out, const HuffmanCodeword* codewords, size_t count, TableKind table_kind) {
+    unsigned char* p = out;
+    *p++ = table_kind;
+    if (table_kind == kTableCanonical) {
+        int lengths[256]; // -1 表示字符未出现
+        std::fill(lengths, lengths + 256, -1);
+        for (size_t i = 0; i < count; ++i) {
+            lengths[codewords[i].symbol] = codewords[i].length;
+        }
+        for (int symbol = 0; symbol < 256;) {
+            if (lengths[symbol] >= 0) {
+                *p++ = static_cast<unsigned char>(lengths[symbol++]);
+                continue;
+            }
+            int run = 0;
+            while (symbol < 256 && lengths[symbol] < 0 && run < 128) {
+                ++symbol;
+                ++run;
+            }
+            *p++ = static_cast<unsigned char>(0x80 + run - 1);
+        }
+        return static_cast<size_t>(p - out);
+    }
+
+    *p++ = static_cast<unsigned char>(count - 1);
+    for (size_t i = 0; i < count; ++i) {
+        const HuffmanCodeword& cw = codewords[i];
+        *p++ = static_cast<unsigned char>(cw.symbol);
+        *p++ = cw.length;
+        for (int shift = (cw.length + 7) / 8 * 8 - 8; shift >= 0; shift -= 8) {
+            // 编码左对齐到整字节, 低位补0
+            uint64_t aligned = cw.code << ((8 - cw.length % 8) % 8);
+            *p++ = static_cast<unsigned char>(aligned >> shift);
+        }
+    }
+    return static_cast<size_t>(p - out);
+}
+
+// 解析编码表, 返回字符数并让 p 指向位流开头
+static size_t parseCodeTable(const unsigned char*& p, const unsigned char* end, HuffmanCodeword* codewords) {
+    if (end - p < 1) {
+        throw std::runtime_error("Error: block is corrupted");
+    }
+    unsigned char table_kind = *p++;
+    size_t num_symbols = 0;
+
+    if (table_kind == kTableCanonical) {
+        for (int symbol = 0; symbol < 256;) {
+            if (p == end) {
+                throw std::runtime_error("Error: block is corrupted");
+            }
+            unsigned char entry = *p++;
+            if (entry & 0x80) {
+                symbol += (entry & 0x7F) + 1;
+            } else if (entry <= 64) {
+                codewords[num_symbols].symbol = static_cast<unsigned short>(symbol++);
+                codewords[num_symbols].length = entry;
+                num_symbols++;
+            } else {
+                throw std::runtime_error("Error: block is corrupted");
+            }
+        }
+        if (num_symbols == 0) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        assignCanonicalCodes(codewords, num_symbols);
+        return num_symbols;
+    }
+
+    if (table_kind != kTableExplicit || end - p < 1) {
+        throw std::runtime_error("Error: block is corrupted");
+    }
+    num_symbols = static_cast<size_t>(*p++) + 1;
+    for (size_t i = 0; i < num_symbols; ++i) {
+        if (end - p < 2) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        codewords[i].symbol = p[0];
+        codewords[i].length = p[1];
+        size_t code_bytes = (p[1] + 7) / 8;
+        p += 2;
+        if (codewords[i].length > 64 || static_cast<size_t>(end - p) < code_bytes) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        uint64_t aligned = 0;
+        for (size_t j = 0; j < code_bytes; ++j) {
+            aligned = (aligned << 8) | p[j];
+        }
+        codewords[i].code = codewords[i].length == 0 ? 0 : aligned >> (code_bytes * 8 - codewords[i].length);
+        p += code_bytes;
+    }
+    return num_symbols;
+}
+
+// 交错块中第 s 段在原始数据中的起点, s 取 0..kInterleavedStreams
+static size_t segmentStart(size_t size, int s) {
+    size_t segment = (size + kInterleavedStreams - 1) / kInterleavedStreams;
+    return std::min(size, segment * static_cast<size_t>(s));
+}
+
+static unsigned char* putVarint(unsigned char* p, uint64_t value) {
+    while (value >= 0x80) {
+        *p++ = static_cast<unsigned char>(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = static_cast<unsigned char>(value);
+    return p;
+}
+
+// 块头 (类型, 原始长度, 负载长度) 的字节数
+static size_t blockHeaderSize(size_t raw_size, size_t payload_size) {
+    return 1 + varintSize(raw_size) + varintSize(payload_size);
+}
+
+// 沿用一张现成的编码表 (字典或之前的块) 写出整块, 不建树也不写编码表。位流的长度要编码后才知道, 因此位流先写在预留的最大块头之后,
+// 再把块头写在它前面并整体前移。counts 为空时不统计频率, timings 为此前各阶段的耗时。编码结果比原始数据还长时撤销写入并返回 false
+static bool encodeWithSharedTable(const unsigned char* data, size_t size, std::vector<unsigned char>& out, const HuffmanEncodeTable& encode_table,
+                                  TableKind table_kind, bool interleaved, const uint64_t* counts, const PhaseTimings& timings, BlockEncodeStats* stats) {
+    PhaseClock clock;
+    const int num_streams = interleaved ? kInterleavedStreams : 1;
+    const size_t jump_table_size = interleaved ? 4 * (kInterleavedStreams - 1) : 0;
+    const size_t kMaxHeaderSize = 1 + 10 + 10 + 1 + 4 * (kInterleavedStreams - 1);
+
+    const size_t start = out.size();
+    out.resize(start + kMaxHeaderSize + encode_table.maxEncodedSize(size) + num_streams);
+    size_t stream_sizes[kInterleavedStreams] = {0};
+    size_t data_size = 0;
+    BitWriter writer;
+    for (int s = 0; s < num_streams; ++s) {
+        writer.reset(out.data() + start + kMaxHeaderSize + data_size);
+        size_t begin = interleaved ? segmentStart(size, s) : 0;
+        size_t end = interleaved ? segmentStart(size, s + 1) : size;
+        encode_table.encode(data + begin, end - begin, writer);
+        writer.finish();
+        stream_sizes[s] = writer.bytesWritten();
+        data_size += stream_sizes[s];
+    }
+    if (data_size > size) {
+        out.resize(start);
+        return false;
+    }
+
+    unsigned char header[kMaxHeaderSize];
+    unsigned char* p = header;
+    *p++ = interleaved ? kBlockHuffman4 : kBlockHuffman;
+    p = putVarint(p, size);
+    p = putVarint(p, 1 + jump_table_size + data_size);
+    *p++ = table_kind;
+    if (interleaved) {
+        for (int s = 0; s + 1 < kInterleavedStreams; ++s) {
+            storeLE32(p, static_cast<uint32_t>(stream_sizes[s]));
+            p += 4;
+        }
+    }
+    const size_t header_size = static_cast<size_t>(p - header);
+    std::memmove(out.data() + start + header_size, out.data() + start + kMaxHeaderSize, data_size);
+    std::memcpy(out.data() + start, header, header_size);
+    out.resize(start + header_size + data_size);
+
+    if (stats != nullptr) {
+        stats->payload_bits = 8 * static_cast<uint64_t>(data_size);
+        if (counts != nullptr) {
+            std::copy(counts, counts + 256, stats->counts);
+            stats->payload_bits = 0;
+            for (int c = 0; c < 256; ++c) {
+                stats->payload_bits += counts[c] * static_cast<uint64_t>(encode_table.length(static_cast<unsigned char>(c)));
+            }
+        } else {
+            std::fill(stats->counts, stats->counts + 256, 0);
+        }
+        stats->max_code_length = static_cast<unsigned>(encode_table.maxLength());
+        stats->timings = timings;
+        stats->timings.encode = clock.lap();
+        stats->block_type = interleaved ? kBlockHuffman4 : kBlockHuffman;
+        stats->table_kind = table_kind;
+    }
+    return true;
+}
+
+// 上下文块, 与 encodeWithSharedTable 一样先把负载写在预留的最大块头之后再整体前移。块长度不小于 best_size 时
+// 撤销写入并返回 false; counts 为整块的频率, 只用于填写统计信息
+static bool encodeContextBlock(const unsigned char* data, size_t size, std::vector<unsigned char>& out, const CompressionOptions& options,
+                               bool interleaved, size_t best_size, const uint64_t* counts, const PhaseTimings& timings, BlockEncodeStats* stats) {
+    thread_local HuffmanContextEncoder model; // 字节对频率表较大, 每个线程复用一个
+    PhaseClock clock;
+    PhaseTimings block_timings = timings;
+    const int num_streams = interleaved ? kInterleavedStreams : 1;
+    size_t starts[kInterleavedStreams + 1];
+    for (int s = 0; s <= num_streams; ++s) {
+        starts[s] = interleaved ? segmentStart(size, s) : (s == 0 ? 0 : size);
+    }
+    const uint64_t payload_bits = model.build(data, starts, num_streams, options.context_tables, options.max_code_length);
+    const int num_tables = model.numTables();
+    block_timings.tree_build += clock.lap();
+    // 只算位流就已经不短于其他写法时不必编码
+    if (1 + varintSize(size) + 2 + HuffmanContextModel::kContextMapSize + (payload_bits + 7) / 8 >= best_size) {
+        return false;
+    }
+
+    const size_t kMaxHeaderSize = 1 + 10 + 10;
+    const size_t jump_table_size = interleaved ? 4 * (kInterleavedStreams - 1) : 0;
+    const size_t max_tables_size = static_cast<size_t>(num_tables) * (1 + 256);
+    const size_t start = out.size();
+    out.resize(start + kMaxHeaderSize + 2 + HuffmanContextModel::kContextMapSize + max_tables_size + jump_table_size +
+               model.maxEncodedSize(size) + num_streams * (BitWriter::kSlack + 1));
+    unsigned char* payload = out.data() + start + kMaxHeaderSize;
+    unsigned char* p = payload;
+    *p++ = static_cast<unsigned char>(num_tables);
+    *p++ = static_cast<unsigned char>(num_streams);
+    for (int i = 0; i < HuffmanContextModel::kContextMapSize; ++i) {
+        *p++ = static_cast<unsigned char>(model.tableOf(static_cast<unsigned char>(2 * i)) | model.tableOf(static_cast<unsigned char>(2 * i + 1)) << 4);
+    }
+    for (int t = 0; t < num_tables; ++t) {
+        p += writeCodeTable(p, model.codewords(t), model.numCodewords(t), kTableCanonical);
+    }
+    unsigned char* jump_table = p;
+    p += jump_table_size;
+    block_timings.table_write += clock.lap();
+
+    BitWriter writer;
+    for (int s = 0; s < num_streams; ++s) {
+        writer.reset(p);
+        model.encode(data + starts[s], starts[s + 1] - starts[s], writer);
+        writer.finish();
+        if (interleaved && s + 1 < num_streams) {
+            storeLE32(jump_table + 4 * s, static_cast<uint32_t>(writer.bytesWritten()));
+        }
+        p += writer.bytesWritten();
+    }
+    const size_t payload_size = static_cast<size_t>(p - payload);
+    if (blockHeaderSize(size, payload_size) + payload_size >= best_size) {
+        out.resize(start);
+        return false;
+    }
+
+    unsigned char header[kMaxHeaderSize];
+    unsigned char* h = header;
+    *h++ = kBlockContext;
+    h = putVarint(h, size);
+    h = putVarint(h, payload_size);
+    const size_t header_size = static_cast<size_t>(h - header);
+    std::memmove(out.data() + start + header_size, payload, payload_size);
+    std::memcpy(out.data() + start, header, header_size);
+    out.resize(start + header_size + payload_size);
+
+    if (stats != nullptr) {
+        std::copy(counts, counts + 256, stats->counts);
+        stats->payload_bits = payload_bits;
+        stats->max_code_length = 0;
+        for (int t = 0; t < num_tables; ++t) {
+            for (size_t i = 0; i < model.numCodewords(t); ++i) {
+                stats->max_code_length = std::max<unsigned>(stats->max_code_length, model.codewords(t)[i].length);
+            }
+        }
+        stats->timings = block_timings;
+        stats->timings.encode = clock.lap();
+        stats->block_type = kBlockContext;
+        stats->table_kind = 0;
+    }
+    return true;
+}
+
+// 上下文块的解码; 不涉及沿用的编码表
+static void decodeContextBlock(const unsigned char* payload, size_t payload_size, unsigned char* out, size_t raw_size, PhaseTimings* timings) {
+    PhaseClock clock;
+    const unsigned char* p = payload;
+    const unsigned char* end = payload + payload_size;
+    if (payload_size < 2 + static_cast<size_t>(HuffmanContextModel::kContextMapSize)) {
+        throw std::runtime_error("Error: block is corrupted");
+    }
+    const int num_tables = *p++;
+    const int num_streams = *p++;
+    if (num_tables < 1 || num_tables > HuffmanContextModel::kMaxTables || (num_streams != 1 && num_streams != kInterleavedStreams)) {
+        throw std::runtime_error("Error: block is corrupted");
+    }
+    const unsigned char* context_map = p;
+    p += HuffmanContextModel::kContextMapSize;
+
+    HuffmanContextDecoder decoder;
+    for (int t = 0; t < num_tables; ++t) {
+        if (p == end || *p != kTableCanonical) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        HuffmanCodeword codewords[256];
+        size_t num_symbols = parseCodeTable(p, end, codewords);
+        decoder.buildTable(t, codewords, num_symbols);
+    }
+    decoder.setContextMap(context_map, num_tables);
+    double table_seconds = clock.lap();
+
+    if (num_streams == 1) {
+        BitReader reader(p, end, true);
+        decoder.decode(reader, out, raw_size);
+    } else {
+        const size_t jump_table_size = 4 * (kInterleavedStreams - 1);
+        if (static_cast<size_t>(end - p) < jump_table_size) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        const unsigned char* stream_begin = p + jump_table_size;
+        BitReader readers[kInterleavedStreams];
+        unsigned char* outs[kInterleavedStreams];
+        size_t counts[kInterleavedStreams];
+        for (int s = 0; s < kInterleavedStreams; ++s) {
+            const unsigned char* stream_end = end;
+            if (s + 1 < kInterleavedStreams) {
+                uint32_t stream_size = loadLE32(p + 4 * s);
+                if (stream_size > static_cast<size_t>(end - stream_begin)) {
+                    throw std::runtime_error("Error: block is corrupted");
+                }
+                stream_end = stream_begin + stream_size;
+            }
+            readers[s].reset(stream_begin, stream_end, true);
+            outs[s] = out + segmentStart(raw_size, s);
+            counts[s] = segmentStart(raw_size, s + 1) - segmentStart(raw_size, s);
+            stream_begin = stream_end;
+        }
+        decoder.decodeInterleaved(readers, outs, counts);
+    }
+    if (timings != nullptr) {
+        timings->table_read += table_seconds;
+        timings->decode += clock.lap();
+    }
+}
+
+// tANS 块, 与 encodeContextBlock 一样先把负载写在预留的最大块头之后再整体前移。块长度不小于 best_size 时
+// 撤销写入并返回 false; counts 为整块的频率
+static bool encodeAnsBlock(const unsigned char* data, size_t size, std::vector<unsigned char>& out, size_t best_size,
+                           const uint64_t* counts, const PhaseTimings& timings, BlockEncodeStats* stats) {
+    thread_local AnsEncoder encoder; // 状态表较大, 每个线程复用一个
+    PhaseClock clock;
+    PhaseTimings block_timings = timings;
+    const uint64_t estimated_bits = encoder.build(counts, size);
+    block_timings.tree_build += clock.lap();
+    // 估计的位流长度就已经不短于其他写法时不必编码
+    if (1 + varintSize(size) + 2 + (estimated_bits + 7) / 8 >= best_size) {
+        return false;
+    }
+
+    const size_t kMaxHeaderSize = 1 + 10 + 10;
+    const size_t start = out.size();
+    out.resize(start + kMaxHeaderSize + AnsCodec::kMaxTableSize + AnsEncoder::maxEncodedSize(size));
+    unsigned char* payload = out.data() + start + kMaxHeaderSize;
+    const size_t table_size = encoder.writeTable(payload);
+    block_timings.table_write += clock.lap();
+    const size_t payload_size = table_size + encoder.encode(data, size, payload + table_size);
+    if (blockHeaderSize(size, payload_size) + payload_size >= best_size) {
+        out.resize(start);
+        return false;
+    }
+
+    unsigned char header[kMaxHeaderSize];
+    unsigned char* h = header;
+    *h++ = kBlockAns;
+    h = putVarint(h, size);
+    h = putVarint(h, payload_size);
+    const size_t header_size = static_cast<size_t>(h - header);
+    std::memmove(out.data() + start + header_size, payload, payload_size);
+    std::memcpy(out.data() + start, header, header_size);
+    out.resize(start + header_size + payload_size);
+
+    if (stats != nullptr) {
+        std::copy(counts, counts + 256, stats->counts);
+        stats->payload_bits = 8 * static_cast<uint64_t>(payload_size - table_size);
+        stats->max_code_length = 0; // ANS 没有按字符的编码长度, 状态表的位数不能当作编码长度
+        stats->timings = block_timings;
+        stats->timings.encode = clock.lap();
+        stats->block_type = kBlockAns;
+        stats->table_kind = 0;
+    }
+    return true;
+}
+
+// tANS 块的解码; 不涉及沿用的编码表
+static void decodeAnsBlock(const unsigned char* payload, size_t payload_size, unsigned char* out, size_t raw_size, PhaseTimings* timings) {
+    thread_local AnsDecoder decoder;
+    PhaseClock clock;
+    const unsigned char* end = payload + payload_size;
+    const unsigned char* p = decoder.readTable(payload, end);
+    double table_seconds = clock.lap();
+    BitReader reader(p, end, true);
+    decoder.decode(reader, out, raw_size);
+    if (timings != nullptr) {
+        timings->table_read += table_seconds;
+        timings->decode += clock.lap();
+    }
+}
+
+// 负载中的 varint, 越过 end 时抛出 std::runtime_error
+static uint64_t parseVarint(const unsigned char*& p, const unsigned char* end) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        unsigned char byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Error: block is corrupted");
+}
+
+// LZ 块。各部分的长度都可以由频率精确算出, 不短于 best_size 时什么也不写并返回 false;
+// counts 为整块的频率, 只用于填写统计信息
+static bool encodeLzBlock(const unsigned char* data, size_t size, std::vector<unsigned char>& out, const CompressionOptions& options,
+                          size_t best_size, const uint64_t* counts, const PhaseTimings& timings, BlockEncodeStats* stats) {
+    // 匹配查找的哈希链与中间结果较大, 每个线程复用一份
+    thread_local LzMatchFinder finder;
+    thread_local LzSequenceEncoder sequence_encoder;
+    thread_local std::vector<LzSequence> sequences;
+    thread_local std::vector<unsigned char> literals;
+    PhaseClock clock;
+    PhaseTimings block_timings = timings;
+
+    // 1. 匹配查找, 把字面量收集到一起
+    sequences.clear();
+    const size_t trailing = finder.parse(data, size, static_cast<int>(options.lz_level), sequences);
+    if (sequences.empty()) {
+        return false;
+    }
+    literals.clear();
+    size_t pos = 0;
+    for (const LzSequence& s : sequences) {
+        literals.insert(literals.end(), data + pos, data + pos + s.literals);
+        pos += s.literals + s.match_length;
+    }
+    literals.insert(literals.end(), data + pos, data + pos + trailing);
+    const size_t num_literals = literals.size();
+    block_timings.histogram += clock.lap();
+
+    // 2. 字面量的编码表与位流长度, 与 encodeBlock 相同
+    const bool interleaved = options.streams == kInterleavedStreams && num_literals >= kMinInterleavedBlockSize;
+    const int num_streams = interleaved ? kInterleavedStreams : 1;
+    size_t literal_starts[kInterleavedStreams + 1];
+    uint64_t segment_counts[kInterleavedStreams][256] = {};
+    uint64_t literal_counts[256] = {0};
+    for (int s = 0; s <= num_streams; ++s) {
+        literal_starts[s] = interleaved ? segmentStart(num_literals, s) : (s == 0 ? 0 : num_literals);
+    }
+    for (int s = 0; s < num_streams; ++s) {
+        countBytes(literals.data() + literal_starts[s], literal_starts[s + 1] - literal_starts[s], segment_counts[s]);
+        for (int c = 0; c < 256; ++c) {
+            literal_counts[c] += segment_counts[s][c];
+        }
+    }
+    HuffmanTreeBuilder builder;
+    HuffmanCodeword literal_codewords[256];
+    size_t num_literal_symbols = 0;
+    unsigned char literal_table[kMaxCodeTableSize];
+    size_t literal_table_size = 0;
+    size_t stream_sizes[kInterleavedStreams] = {0};
+    size_t literal_data_size = 0;
+    uint64_t literal_bits = 0;
+    HuffmanEncodeTable literal_encode_table;
+    if (num_literals > 0) {
+        num_literal_symbols = builder.buildCodewords(literal_counts, static_cast<int>(options.max_code_length), literal_codewords);
+        literal_encode_table.build(literal_codewords, num_literal_symbols);
+        literal_table_size = writeCodeTable(literal_table, literal_codewords, num_literal_symbols, kTableCanonical);
+        for (int s = 0; s < num_streams; ++s) {
+            uint64_t bits = 0;
+            for (size_t i = 0; i < num_literal_symbols; ++i) {
+                bits += segment_counts[s][literal_codewords[i].symbol] * literal_codewords[i].length;
+            }
+            stream_sizes[s] = static_cast<size_t>((bits + 7) / 8);
+            literal_data_size += stream_sizes[s];
+            literal_bits += bits;
+        }
+    }
+
+    // 3. 序列的编码表与位流长度
+    const uint64_t sequence_bits = sequence_encoder.build(sequences.data(), sequences.size());
+    unsigned char token_table[kMaxCodeTableSize];
+    unsigned char distance_table[kMaxCodeTableSize];
+    const size_t token_table_size = writeCodeTable(token_table, sequence_encoder.tokenCodewords(), sequence_encoder.numTokenCodewords(), kTableCanonical);
+    const size_t distance_table_size =
+        writeCodeTable(distance_table, sequence_encoder.distanceCodewords(), sequence_encoder.numDistanceCodewords(), kTableCanonical);
+    const size_t sequence_data_size = static_cast<size_t>((sequence_bits + 7) / 8);
+    block_timings.tree_build += clock.lap();
+
+    const size_t jump_table_size = interleaved ? 4 * (kInterleavedStreams - 1) : 0;
+    size_t payload_size = varintSize(num_literals) + varintSize(sequences.size()) + token_table_size + distance_table_size + sequence_data_size;
+    if (num_literals > 0) {
+        payload_size += 1 + literal_table_size + jump_table_size + varintSize(literal_data_size) + literal_data_size;
+    }
+    if (blockHeaderSize(size, payload_size) + payload_size >= best_size) {
+        return false;
+    }
+
+    // 4. 依次写出, 位流紧挨着写, 后一个位流会覆盖前一个写入器的尾部余量
+    out.push_back(kBlockLz);
+    writeVarint(out, size);
+    writeVarint(out, payload_size);
+    writeVarint(out, num_literals);
+    writeVarint(out, sequences.size());
+    BitWriter writer;
+    if (num_literals > 0) {
+        out.push_back(static_cast<unsigned char>(num_streams));
+        out.insert(out.end(), literal_table, literal_table + literal_table_size);
+        for (int s = 0; s + 1 < num_streams; ++s) {
+            unsigned char size_bytes[4];
+            storeLE32(size_bytes, static_cast<uint32_t>(stream_sizes[s]));
+            out.insert(out.end(), size_bytes, size_bytes + 4);
+        }
+        writeVarint(out, literal_data_size);
+        size_t stream_pos = out.size();
+        out.resize(stream_pos + literal_data_size + BitWriter::kSlack);
+        for (int s = 0; s < num_streams; ++s) {
+            writer.reset(out.data() + stream_pos);
+            literal_encode_table.encode(literals.data() + literal_starts[s], literal_starts[s + 1] - literal_starts[s], writer);
+            writer.finish();
+            stream_pos += writer.bytesWritten();
+        }
+        out.resize(stream_pos);
+    }
+    out.insert(out.end(), token_table, token_table + token_table_size);
+    out.insert(out.end(), distance_table, distance_table + distance_table_size);
+    size_t sequence_pos = out.size();
+    out.resize(sequence_pos + LzSequenceEncoder::maxEncodedSize(sequences.size()));
+    writer.reset(out.data() + sequence_pos);
+    sequence_encoder.encode(sequences.data(), sequences.size(), writer);
+    writer.finish();
+    out.resize(sequence_pos + writer.bytesWritten());
+
+    if (stats != nullptr) {
+        std::copy(counts, counts + 256, stats->counts);
+        stats->payload_bits = literal_bits + sequence_bits;
+        stats->max_code_length = 0;
+        for (size_t i = 0; i < num_literal_symbols; ++i) {
+            stats->max_code_length = std::max<unsigned>(stats->max_code_length, literal_codewords[i].length);
+        }
+        stats->timings = block_timings;
+        stats->timings.encode = clock.lap();
+        stats->block_type = kBlockLz;
+        stats->table_kind = 0;
+    }
+    return true;
+}
+
+// LZ 块的解码: 先把字面量整段解码到缓冲区, 再执行序列; 不涉及沿用的编码表
+static void decodeLzBlock(const unsigned char* payload, size_t payload_size, unsigned char* out, size_t raw_size, PhaseTimings* timings) {
+    thread_local HuffmanDecodeTable literal_table;
+    thread_local std::vector<unsigned char> literals;
+    PhaseClock clock;
+    const unsigned char* p = payload;
+    const unsigned char* end = payload + payload_size;
+    const uint64_t num_literals = parseVarint(p, end);
+    const uint64_t num_sequences = parseVarint(p, end);
+    if (num_literals > raw_size || num_sequences == 0 || num_sequences > raw_size / LzCodec::kMinMatch) {
+        throw std::runtime_error("Error: block is corrupted");
+    }
+    // 字面量之后留16字节, 复制字面量时可以整段越界读取
+    literals.resize(static_cast<size_t>(num_literals) + 16);
+    double table_seconds = 0.0;
+    double decode_seconds = 0.0;
+
+    if (num_literals > 0) {
+        if (p == end) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        const int num_streams = *p++;
+        if (num_streams != 1 && num_streams != kInterleavedStreams) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        if (p == end || *p != kTableCanonical) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        HuffmanCodeword codewords[256];
+        size_t num_symbols = parseCodeTable(p, end, codewords);
+        literal_table.build(codewords, num_symbols);
+        const size_t jump_table_size = num_streams == kInterleavedStreams ? 4 * (kInterleavedStreams - 1) : 0;
+        if (static_cast<size_t>(end - p) < jump_table_size) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        const unsigned char* jump_table = p;
+        p += jump_table_size;
+        const uint64_t literal_data_size = parseVarint(p, end);
+        if (literal_data_size > static_cast<uint64_t>(end - p)) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        const unsigned char* literal_end = p + literal_data_size;
+        table_seconds += clock.lap();
+
+        if (num_streams == 1) {
+            BitReader reader(p, literal_end, true);
+            if (literal_table.decode(reader, literals.data(), static_cast<size_t>(num_literals)) != num_literals) {
+                throw std::runtime_error("Error: block is corrupted");
+            }
+        } else {
+            const unsigned char* stream_begin = p;
+            BitReader readers[kInterleavedStreams];
+            unsigned char* outs[kInterleavedStreams];
+            size_t counts[kInterleavedStreams];
+            for (int s = 0; s < kInterleavedStreams; ++s) {
+                const unsigned char* stream_end = literal_end;
+                if (s + 1 < kInterleavedStreams) {
+                    uint32_t stream_size = loadLE32(jump_table + 4 * s);
+                    if (stream_size > static_cast<size_t>(literal_end - stream_begin)) {
+                        throw std::runtime_error("Error: block is corrupted");
+                    }
+                    stream_end = stream_begin + stream_size;
+                }
+                readers[s].reset(stream_begin, stream_end, true);
+                outs[s] = literals.data() + segmentStart(static_cast<size_t>(num_literals), s);
+                counts[s] = segmentStart(static_cast<size_t>(num_literals), s + 1) - segmentStart(static_cast<size_t>(num_literals), s);
+                stream_begin = stream_end;
+            }
+            literal_table.decodeInterleaved(readers, outs, counts);
+        }
+        p = literal_end;
+        decode_seconds += clock.lap();
+    }
+
+    LzSequenceDecoder sequence_decoder;
+    for (int table = 0; table < 2; ++table) {
+        if (p == end || *p != kTableCanonical) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        HuffmanCodeword codewords[256];
+        size_t num_symbols = parseCodeTable(p, end, codewords);
+        if (table == 0) {
+            sequence_decoder.buildTokenTable(codewords, num_symbols);
+        } else {
+            sequence_decoder.buildDistanceTable(codewords, num_symbols);
+        }
+    }
+    table_seconds += clock.lap();
+    BitReader reader(p, end, true);
+    sequence_decoder.decode(reader, static_cast<size_t>(num_sequences), literals.data(), static_cast<size_t>(num_literals), out, raw_size);
+    decode_seconds += clock.lap();
+    if (timings != nullptr) {
+        timings->table_read += table_seconds;
+        timings->decode += decode_seconds;
+    }
+}
+
+// 原样块或游程块
+static void writeStoredBlock(const unsigned char* data, size_t size, std::vector<unsigned char>& out, unsigned char block_type) {
+    out.push_back(block_type);
+    writeVarint(out, size);
+    if (block_type == kBlockRle) {
+        writeVarint(out, 1);
+        out.push_back(data[0]);
+    } else {
+        writeVarint(out, size);
+        out.insert(out.end(), data, data + size);
+    }
+}
+
+size_t estimateRepeatBlockSize(const uint64_t* counts, size_t size, const HuffmanEncodeTable& previous, const CompressionOptions& options) {
+    if (previous.maxLength() == 0) {
+        return SIZE_MAX;
+    }
+    uint64_t bits = 0;
+    for (int c = 0; c < 256; ++c) {
+        if (counts[c] > 0) {
+            int length = previous.length(static_cast<unsigned char>(c));
+            if (length == 0) {
+                return SIZE_MAX; // 之前的编码表里没有这个字节
+            }
+            bits += counts[c] * static_cast<uint64_t>(length);
+        }
+    }
+    // 各位流分别补齐到整字节, 每多一个位流最多多出1字节
+    const bool interleaved = options.streams == kInterleavedStreams && size >= kMinInterleavedBlockSize;
+    const size_t extra_streams = interleaved ? kInterleavedStreams - 1 : 0;
+    size_t payload = 1 + 4 * extra_streams + static_cast<size_t>((bits + 7) / 8) + extra_streams;
+    return blockHeaderSize(size, payload) + payload;
+}
+
+void encodeBlock(const unsigned char* data, size_t size, std::vector<unsigned char>& out, const CompressionOptions& options,
+                 BlockEncodeStats* stats, const HuffmanEncodeTable* previous) {
+    const bool interleaved = options.streams == kInterleavedStreams && size >= kMinInterleavedBlockSize;
+    const int num_streams = interleaved ? kInterleavedStreams : 1;
+    if (options.dictionary != nullptr &&
+        encodeWithSharedTable(data, size, out, options.dictionary->encodeTable(), kTableDictionary, interleaved, nullptr, PhaseTimings(), stats)) {
+        return;
+    }
+    PhaseClock clock;
+    PhaseTimings timings;
+
+    // 1. 按段统计频率, 各段之和即整块的频率
+    uint64_t segment_counts[kInterleavedStreams][256] = {};
+    for (int s = 0; s < num_streams; ++s) {
+        size_t begin = interleaved ? segmentStart(size, s) : 0;
+        size_t end = interleaved ? segmentStart(size, s + 1) : size;
+        countBytes(data + begin, end - begin, segment_counts[s]);
+    }
+    uint64_t counts[256];
+    int distinct = 0;
+    for (int c = 0; c < 256; ++c) {
+        counts[c] = segment_counts[0][c] + segment_counts[1][c] + segment_counts[2][c] + segment_counts[3][c];
+        distinct += counts[c] > 0 ? 1 : 0;
+    }
+    timings.histogram = clock.lap();
+
+    auto fillStats = [&](unsigned char block_type, unsigned char table_kind, uint64_t payload_bits, unsigned max_code_length) {
+        if (stats != nullptr) {
+            std::copy(counts, counts + 256, stats->counts);
+            stats->payload_bits = payload_bits;
+            stats->max_code_length = max_code_length;
+            stats->timings = timings;
+            stats->block_type = block_type;
+            stats->table_kind = table_kind;
+        }
+    };
+
+    // 只有一种字节时写游程块, 不必建树
+    if (distinct == 1) {
+        writeStoredBlock(data, size, out, kBlockRle);
+        timings.encode = clock.lap();
+        fillStats(kBlockRle, 0, 0, 0);
+        return;
+    }
+
+    // 2. 建树求编码长度并分配规范编码
+    HuffmanTreeBuilder builder;
+    unsigned char lengths[256];
+    builder.buildLengths(counts, lengths);
+    timings.tree_build = clock.lap();
+    HuffmanCodeword codewords[256];
+    size_t num_symbols = HuffmanTreeBuilder::assignCodewords(counts, lengths, static_cast<int>(options.max_code_length), codewords);
+    TableKind table_kind = options.canonical_codes ? kTableCanonical : kTableExplicit;
+    HuffmanEncodeTable encode_table;
+    encode_table.build(codewords, num_symbols);
+    timings.code_generation = clock.lap();
+
+    // 3. 编码表先单独拼好; 各位流长度可以由频率精确算出, 于是块头可以先写
+    unsigned char table[kMaxCodeTableSize];
+    size_t table_size = writeCodeTable(table, codewords, num_symbols, table_kind);
+    size_t stream_sizes[kInterleavedStreams] = {0};
+    size_t data_size = 0;
+    uint64_t payload_bits = 0;
+    for (int s = 0; s < num_streams; ++s) {
+        uint64_t bits = 0;
+        for (size_t i = 0; i < num_symbols; ++i) {
+            bits += segment_counts[s][codewords[i].symbol] * codewords[i].length;
+        }
+        stream_sizes[s] = static_cast<size_t>((bits + 7) / 8);
+        data_size += stream_sizes[s];
+        payload_bits += bits;
+    }
+    timings.table_write = clock.lap();
+    size_t jump_table_size = interleaved ? 4 * (kInterleavedStreams - 1) : 0;
+
+    // 4. 比较新编码表、原样存储与沿用之前的编码表三种写法的长度, 都只需要频率。
+    //    tANS 块、LZ 块与上下文块的长度要实际编码或查找匹配才知道, 比之前的写法都短时先写出, 后面的写法更短时再撤销
+    const size_t payload_size = table_size + jump_table_size + data_size;
+    const size_t huffman_block_size = blockHeaderSize(size, payload_size) + payload_size;
+    const size_t raw_block_size = blockHeaderSize(size, size) + size;
+    size_t best_size = std::min(huffman_block_size, raw_block_size);
+    const size_t start = out.size();
+    bool written = false;
+    if (options.ans_coding && encodeAnsBlock(data, size, out, best_size, counts, timings, stats)) {
+        written = true;
+        best_size = out.size() - start;
+    }
+    const size_t lz_start = out.size();
+    if (options.lz_level > 0 && size >= kMinLzBlockSize && encodeLzBlock(data, size, out, options, best_size, counts, timings, stats)) {
+        out.erase(out.begin() + start, out.begin() + lz_start);
+        written = true;
+        best_size = out.size() - start;
+    }
+    const size_t context_start = out.size();
+    if (options.context_tables > 1 && size >= kMinContextBlockSize &&
+        encodeContextBlock(data, size, out, options, interleaved, best_size, counts, timings, stats)) {
+        out.erase(out.begin() + start, out.begin() + context_start);
+        written = true;
+        best_size = out.size() - start;
+    }
+    if (previous != nullptr && estimateRepeatBlockSize(counts, size, *previous, options) < best_size) {
+        // 沿用编码表的块先写在已写出的块之后, 成功时再删去已写出的块, 不需要另存一份
+        const size_t repeat_start = out.size();
+        if (encodeWithSharedTable(data, size, out, *previous, kTableRepeat, interleaved, counts, timings, stats)) {
+            out.erase(out.begin() + start, out.begin() + repeat_start);
+            return;
+        }
+    }
+    if (written) {
+        return;
+    }
+    if (raw_block_size <= huffman_block_size) {
+        writeStoredBlock(data, size, out, kBlockRaw);
+        timings.encode = clock.lap();
+        fillStats(kBlockRaw, 0, 8 * static_cast<uint64_t>(size), 8);
+        return;
+    }
+
+    out.push_back(interleaved ? kBlockHuffman4 : kBlockHuffman);
+    writeVarint(out, size);
+    writeVarint(out, payload_size);
+    out.insert(out.end(), table, table + table_size);
+    if (interleaved) {
+        unsigned char jump_table[4 * (kInterleavedStreams - 1)];
+        for (int s = 0; s + 1 < kInterleavedStreams; ++s) {
+            storeLE32(jump_table + 4 * s, static_cast<uint32_t>(stream_sizes[s]));
+        }
+        out.insert(out.end(), jump_table, jump_table + sizeof(jump_table));
+    }
+
+    // 5. 位流依次紧挨着写出, 后一个位流会覆盖前一个写入器的尾部余量
+    size_t pos = out.size();
+    out.resize(pos + data_size + BitWriter::kSlack);
+    BitWriter writer;
+    for (int s = 0; s < num_streams; ++s) {
+        writer.reset(out.data() + pos);
+        size_t begin = interleaved ? segmentStart(size, s) : 0;
+        size_t end = interleaved ? segmentStart(size, s + 1) : size;
+        encode_table.encode(data + begin, end - begin, writer);
+        writer.finish();
+        pos += writer.bytesWritten();
+    }
+    out.resize(pos);
+    timings.encode = clock.lap();
+
+    unsigned max_code_length = 0;
+    for (size_t i = 0; i < num_symbols; ++i) {
+        max_code_length = std::max<unsigned>(max_code_length, codewords[i].length);
+    }
+    fillStats(interleaved ? kBlockHuffman4 : kBlockHuffman, table_kind, payload_bits, max_code_length);
+    if (stats != nullptr) {
+        std::fill(stats->code_lengths, stats->code_lengths + 256, 0);
+        for (size_t i = 0; i < num_symbols; ++i) {
+            stats->code_lengths[codewords[i].symbol] = codewords[i].length;
+        }
+    }
+}
+
+void buildBlockTable(const unsigned char* payload, size_t payload_size, HuffmanDecodeTable& table) {
+    const unsigned char* p = payload;
+    HuffmanCodeword codewords[256];
+    size_t num_symbols = parseCodeTable(p, payload + payload_size, codewords);
+    table.build(codewords, num_symbols);
+}
+
+void decodeBlock(unsigned char block_type, const unsigned char* payload, size_t payload_size, unsigned char* out, size_t raw_size,
+                 HuffmanDecodeTable& table, bool& table_ready, PhaseTimings* timings, const HuffmanDictionary* dictionary) {
+    PhaseClock clock;
+    if (block_type == kBlockRaw || block_type == kBlockRle) {
+        if (payload_size != (block_type == kBlockRaw ? raw_size : 1)) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        if (block_type == kBlockRaw) {
+            std::memcpy(out, payload, raw_size);
+        } else {
+            std::memset(out, payload[0], raw_size);
+        }
+        if (timings != nullptr) {
+            timings->decode += clock.lap();
+        }
+        return;
+    }
+    if (block_type == kBlockContext) {
+        decodeContextBlock(payload, payload_size, out, raw_size, timings);
+        return;
+    }
+    if (block_type == kBlockLz) {
+        decodeLzBlock(payload, payload_size, out, raw_size, timings);
+        return;
+    }
+    if (block_type == kBlockAns) {
+        decodeAnsBlock(payload, payload_size, out, raw_size, timings);
+        return;
+    }
+
+    const unsigned char* p = payload;
+    const unsigned char* end = payload + payload_size;
+    const HuffmanDecodeTable* active = &table;
+    if (p == end) {
+        throw std::runtime_error("Error: block is corrupted");
+    }
+    if (*p == kTableDictionary) {
+        if (dictionary == nullptr) {
+            throw std::runtime_error("Error: block requires a dictionary");
+        }
+        active = &dictionary->decodeTable();
+        p++;
+    } else if (*p == kTableRepeat) {
+        if (!table_ready) {
+            throw std::runtime_error("Error: block reuses a code table that has not been read");
+        }
+        p++;
+    } else {
+        HuffmanCodeword codewords[256];
+        size_t num_symbols = parseCodeTable(p, end, codewords);
+        table_ready = false; // 构建失败时 table 不再可用
+        table.build(codewords, num_symbols);
+        table_ready = true;
+    }
+    double table_seconds = clock.lap();
+
+    if (block_type != kBlockHuffman4) {
+        BitReader reader(p, end, true);
+        if (active->decode(reader, out, raw_size) != raw_size) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        if (timings != nullptr) {
+            timings->table_read += table_seconds;
+            timings->decode += clock.lap();
+        }
+        return;
+    }
+
+    // 四路交错: 由长度表切出各个位流, 交错解码到各段
+    const size_t jump_table_size = 4 * (kInterleavedStreams - 1);
+    if (static_cast<size_t>(end - p) < jump_table_size) {
+        throw std::runtime_error("Error: block is corrupted");
+    }
+    const unsigned char* stream_begin = p + jump_table_size;
+    BitReader readers[kInterleavedStreams];
+    unsigned char* outs[kInterleavedStreams];
+    size_t counts[kInterleavedStreams];
+    for (int s = 0; s < kInterleavedStreams; ++s) {
+        const unsigned char* stream_end = end;
+        if (s + 1 < kInterleavedStreams) {
+            uint32_t stream_size = loadLE32(p + 4 * s);
+            if (stream_size > static_cast<size_t>(end - stream_begin)) {
+                throw std::runtime_error("Error: block is corrupted");
+            }
+            stream_end = stream_begin + stream_size;
+        }
+        readers[s].reset(stream_begin, stream_end, true);
+        outs[s] = out + segmentStart(raw_size, s);
+        counts[s] = segmentStart(raw_size, s + 1) - segmentStart(raw_size, s);
+        stream_begin = stream_end;
+    }
+    active->decodeInterleaved(readers, outs, counts);
+    if (timings != nullptr) {
+        timings->table_read += table_seconds;
+        timings->decode += clock.lap();
+    }
+}
+
+BlockStreamReader::BlockStreamReader(ByteSource& input, uint64_t start_offset)
+    : input_(input), position_(start_offset) {
+}
+
+const unsigned char* BlockStreamReader::take(size_t n) {
+    const unsigned char* result;
+    if (input_.data() != nullptr) {
+        if (position_ > input_.size() || n > input_.size() - position_) {
+            throw std::runtime_error("Error: unexpected end of input");
+        }
+        result = input_.data() + position_;
+    } else {
+        if (scratch_.size() < n) {
+            scratch_.resize(n);
+        }
+        input_.readExact(scratch_.data(), n);
+        result = scratch_.data();
+    }
+    position_ += n;
+    return result;
+}
+
+unsigned char BlockStreamReader::takeByte() {
+    return *take(1);
+}
+
+uint64_t BlockStreamReader::takeVarint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        unsigned char byte = takeByte();
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Error: archive is corrupted (bad varint)");
+}
+
+void BlockStreamReader::skip(uint64_t n) {
+    if (input_.data() != nullptr) {
+        if (position_ > input_.size() || n > input_.size() - position_) {
+            throw std::runtime_error("Error: unexpected end of input");
+        }
+    } else if (!input_.seek(position_ + n)) {
+        // 不支持重新定位时读出并丢弃
+        unsigned char discard[4096];
+        for (uint64_t left = n; left > 0;) {
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(left, sizeof(discard)));
+            input_.readExact(discard, chunk);
+            left -= chunk;
+        }
+    }
+    position_ += n;
+}
+
+BlockHeader readBlockHeader(BlockStreamReader& reader, const FileHeader& file_header) {
+    BlockHeader header;
+    header.type = reader.takeByte();
+    if (header.type == kBlockEnd) {
+        return header;
+    }
+    header.raw_size = reader.takeVarint();
+    header.payload_size = reader.takeVarint();
+    // 先校验长度, 避免损坏的块头导致过大的分配
+    const uint64_t max_block_size = static_cast<uint64_t>(1) << file_header.block_size_log2;
+    if (header.type > kBlockAns || header.raw_size == 0 || header.raw_size > max_block_size ||
+        header.payload_size > maxBlockSize(static_cast<size_t>(header.raw_size)) ||
+        (header.type == kBlockRaw && header.payload_size != header.raw_size) || (header.type == kBlockRle && header.payload_size != 1)) {
+        throw std::runtime_error("Error: block is corrupted");
+    }
+    if (file_header.flags & kFlagChecksum) {
+        header.checksum = loadLE32(reader.take(kChecksumSize));
+    }
+    return header;
+}
+
+bool readBlockIndex(ByteSource& input, const FileHeader& file_header, std::vector<IndexEntry>& index, Footer& footer) {
+    const uint64_t size = input.size();
+    if (!(file_header.flags & kFlagBlockIndex) || size == ByteSource::kUnknownSize) {
+        return false;
+    }
+    const uint64_t first_block_offset = fileHeaderSize(file_header);
+    if (size < first_block_offset + 1 + kFooterSize) {
+        throw std::runtime_error("Error: archive is truncated");
+    }
+
+    unsigned char footer_bytes[kFooterSize];
+    if (!input.seek(size - kFooterSize)) {
+        return false;
+    }
+    input.readExact(footer_bytes, kFooterSize);
+    footer = parseFooter(footer_bytes);
+    uint64_t index_size = static_cast<uint64_t>(footer.block_count) * kIndexEntrySize;
+    if (footer.index_offset < first_block_offset + 1 || footer.index_offset + index_size + kFooterSize != size) {
+        throw std::runtime_error("Error: block index is corrupted");
+    }
+
+    if (!input.seek(footer.index_offset)) {
+        return false;
+    }
+
+    // 索引项分批读入栈上的缓冲区, 不分配内存。块偏移必须递增且位于结束块之前, 原始长度之和必须等于总长度
+    const uint64_t max_block_size = static_cast<uint64_t>(1) << file_header.block_size_log2;
+    index.resize(footer.block_count);
+    uint64_t total_raw_size = 0;
+    uint64_t min_offset = first_block_offset;
+    unsigned char index_bytes[256 * kIndexEntrySize];
+    for (uint32_t batch = 0; batch < footer.block_count; batch += 256) {
+        const uint32_t batch_count = std::min<uint32_t>(256, footer.block_count - batch);
+        input.readExact(index_bytes, batch_count * kIndexEntrySize);
+        for (uint32_t i = batch; i < batch + batch_count; ++i) {
+            const unsigned char* entry = index_bytes + (i - batch) * kIndexEntrySize;
+            index[i].offset = loadLE64(entry);
+            index[i].raw_size = loadLE32(entry + 8);
+            if (index[i].offset < min_offset || index[i].offset >= footer.index_offset - 1 ||
+                index[i].raw_size == 0 || index[i].raw_size > max_block_size) {
+                throw std::runtime_error("Error: block index is corrupted");
+            }
+            min_offset = index[i].offset + 1;
+            total_raw_size += index[i].raw_size;
+        }
+    }
+    if (total_raw_size != footer.total_raw_size) {
+        throw std::runtime_error("Error: block index is corrupted");
+    }
+    return true;
+}
+
+}
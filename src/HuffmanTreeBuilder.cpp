@@ -0,0 +1,152 @@
+#include "HuffmanTreeBuilder.h"
+#include <algorithm>
+
+int HuffmanTreeBuilder::buildLengths(const uint64_t* counts, unsigned char* lengths) {
+    std::fill(lengths, lengths + 256, 0);
+    int n = 0;
+    for (int i = 0; i < 256; ++i) {
+        if (counts[i] > 0) {
+            nodes_[n++] = {counts[i], -1, i};
+        }
+    }
+    if (n <= 1) { // 0或1个字符不需要建树
+        return n;
+    }
+    std::sort(nodes_, nodes_ + n, [](const Node& a, const Node& b) {
+        return a.count != b.count ? a.count < b.count : a.symbol < b.symbol;
+    });
+
+    // 叶子队列为 [leaf, n), 内部节点队列为 [internal, next)
+    int leaf = 0;
+    int internal = n;
+    auto takeSmallest = [&](int next) {
+        if (leaf < n && (internal >= next || nodes_[leaf].count <= nodes_[internal].count)) {
+            return leaf++;
+        }
+        return internal++;
+    };
+    const int root = 2 * n - 2;
+    for (int next = n; next <= root; ++next) {
+        int a = takeSmallest(next);
+        int b = takeSmallest(next);
+        nodes_[next] = {nodes_[a].count + nodes_[b].count, -1, -1};
+        nodes_[a].parent = next;
+        nodes_[b].parent = next;
+    }
+
+    // 父节点的下标总是大于子节点, 从根向下一遍即可把父节点下标换成深度
+    nodes_[root].parent = 0;
+    for (int i = root - 1; i >= 0; --i) {
+        nodes_[i].parent = nodes_[nodes_[i].parent].parent + 1;
+    }
+    for (int i = 0; i < n; ++i) {
+        lengths[nodes_[i].symbol] = static_cast<unsigned char>(std::min(nodes_[i].parent, 255));
+    }
+    return n;
+}
+
+size_t HuffmanTreeBuilder::buildCodewords(const uint64_t* counts, int max_length, HuffmanCodeword* codewords) {
+    unsigned char lengths[256];
+    buildLengths(counts, lengths);
+    return assignCodewords(counts, lengths, max_length, codewords);
+}
+
+size_t HuffmanTreeBuilder::assignCodewords(const uint64_t* counts, const unsigned char* lengths, int max_length, HuffmanCodeword* codewords) {
+    size_t count = 0;
+    for (int i = 0; i < 256; ++i) {
+        if (counts[i] > 0) {
+            codewords[count].symbol = static_cast<unsigned short>(i);
+            codewords[count].length = lengths[i];
+            count++;
+        }
+    }
+    // 编码以64位整数保存, 不限制时也不能超过64位
+    if (max_length <= 0 || max_length > 64) {
+        max_length = 64;
+    }
+    if (!limitCodeLengths(codewords, count, counts, max_length)) {
+        assignCanonicalCodes(codewords, count);
+    }
+    return count;
+}
+
+size_t HuffmanTreeBuilder::buildLegacyCodewords(const uint64_t* counts, int max_length, HuffmanCodeword* codewords) {
+    if (max_length <= 0 || max_length > 64) {
+        max_length = 64;
+    }
+    int n = 0;
+    for (int i = 0; i < 256; ++i) {
+        if (counts[i] > 0) {
+            nodes_[n++] = {counts[i], -1, i};
+        }
+    }
+    // 与最初的实现以相同的初始顺序和比较函数调用 std::sort, 相同频率的字符排出的顺序也相同
+    std::sort(nodes_, nodes_ + n, [](const Node& a, const Node& b) {
+        return a.count > b.count;
+    });
+    if (n <= 1) { // 0或1个字符不需要建树, 唯一的字符编码长度为0
+        if (n == 1) {
+            codewords[0].symbol = static_cast<unsigned short>(nodes_[0].symbol);
+            codewords[0].length = 0;
+            codewords[0].code = 0;
+        }
+        return static_cast<size_t>(n);
+    }
+
+    // 列表中最靠前的最小叶子: 频率相同的一段从前往后取, 各段从频率最小 (最后) 的一段开始; 叶子总在内部节点之前,
+    // 与内部节点频率相同时先取叶子。内部节点按创建顺序排列且频率单调不减, 最小的总是最早创建的那个
+    int leaf_order[256];
+    int num_ordered = 0;
+    for (int end = n; end > 0;) {
+        int begin = end - 1;
+        while (begin > 0 && nodes_[begin - 1].count == nodes_[end - 1].count) {
+            --begin;
+        }
+        for (int i = begin; i < end; ++i) {
+            leaf_order[num_ordered++] = i;
+        }
+        end = begin;
+    }
+    unsigned char is_right[511];
+    int leaf = 0;
+    int internal = n;
+    auto takeSmallest = [&](int next) {
+        if (leaf < n && (internal >= next || nodes_[leaf_order[leaf]].count <= nodes_[internal].count)) {
+            return leaf_order[leaf++];
+        }
+        return internal++;
+    };
+    const int root = 2 * n - 2;
+    for (int next = n; next <= root; ++next) {
+        int a = takeSmallest(next);
+        int b = takeSmallest(next);
+        nodes_[next] = {nodes_[a].count + nodes_[b].count, -1, -1};
+        nodes_[a].parent = next;
+        nodes_[b].parent = next;
+        // 字节值较小的作左子节点, 相等时 (都是内部节点等) 后取出的作左子节点
+        int symbol_a = std::max(nodes_[a].symbol, 0);
+        int symbol_b = std::max(nodes_[b].symbol, 0);
+        is_right[a] = symbol_a < symbol_b ? 0 : 1;
+        is_right[b] = symbol_a < symbol_b ? 1 : 0;
+    }
+
+    // 父节点的下标总是大于子节点, 从根向下一遍求出各节点的编码
+    uint64_t codes[511];
+    int depths[511];
+    codes[root] = 0;
+    depths[root] = 0;
+    for (int i = root - 1; i >= 0; --i) {
+        int parent = nodes_[i].parent;
+        depths[i] = depths[parent] + 1;
+        if (depths[i] > max_length) {
+            return 0;
+        }
+        codes[i] = (codes[parent] << 1) | is_right[i];
+    }
+    for (int i = 0; i < n; ++i) {
+        codewords[i].symbol = static_cast<unsigned short>(nodes_[i].symbol);
+        codewords[i].length = static_cast<unsigned char>(depths[i]);
+        codewords[i].code = codes[i];
+    }
+    return static_cast<size_t>(n);
+}
@@ -0,0 +1,361 @@
+#include "LzCodec.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using LzCodec::kLengthBase;
+using LzCodec::kLengthExtraBits;
+using LzCodec::kMaxCodeLength;
+using LzCodec::kMinMatch;
+
+namespace {
+
+struct LevelParams {
+    int chain;       // 每个位置最多比较的候选数
+    bool lazy;       // 惰性匹配
+    size_t good;     // 惰性匹配时当前匹配已有这么长, 下一个位置只比较 chain / 4 个候选
+    size_t nice;     // 找到这么长的匹配就停止查找
+    int skip_shift;  // 连续 2^skip_shift 个位置没有匹配后加大步长, 不可压缩的数据因此很快跳过
+};
+
+const LevelParams kLevels[LzCodec::kMaxLevel + 1] = {
+    {0, false, 0, 0, 0},
+    {1, false, 0, 16, 4},
+    {2, false, 0, 32, 5},
+    {4, false, 0, 64, 6},
+    {8, true, 8, 64, 6},
+    {16, true, 8, 128, 7},
+    {32, true, 16, 128, 7},
+    {64, true, 16, 256, 8},
+    {128, true, 32, 256, 8},
+    {256, true, 32, 512, 8},
+};
+
+inline uint32_t load32(const unsigned char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t load64(const unsigned char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// a 与 b 的公共前缀长度, 最多 limit; 每次比较8字节
+inline size_t commonLength(const unsigned char* a, const unsigned char* b, size_t limit) {
+    size_t n = 0;
+    while (n + 8 <= limit) {
+        uint64_t diff = load64(a + n) ^ load64(b + n);
+        if (diff != 0) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return n + (__builtin_clzll(diff) >> 3);
+#else
+            return n + (__builtin_ctzll(diff) >> 3);
+#endif
+        }
+        n += 8;
+    }
+    while (n < limit && a[n] == b[n]) {
+        ++n;
+    }
+    return n;
+}
+
+// 读 n (0..30) 位附加值
+inline uint32_t readExtra(BitReader& reader, int n) {
+    uint32_t value = reader.peekBits(n);
+    reader.consume(n);
+    return value;
+}
+
+// 各距离码的最小距离与附加位数, 距离码0 (沿用上一个距离) 没有附加位
+struct DistanceCodeTable {
+    uint32_t base[LzCodec::kNumDistanceCodes];
+    unsigned char extra_bits[LzCodec::kNumDistanceCodes];
+    DistanceCodeTable() {
+        base[0] = 0;
+        extra_bits[0] = 0;
+        for (int code = 1; code < LzCodec::kNumDistanceCodes; ++code) {
+            base[code] = 1u << (code - 1);
+            extra_bits[code] = static_cast<unsigned char>(code - 1);
+        }
+    }
+};
+const DistanceCodeTable kDistanceCodes;
+
+// 每次复制16字节, 最多写到 dst + n 之后15字节、读到 src + n 之后15字节, 由调用方保证这些位置可用
+inline void wideCopy16(unsigned char* dst, const unsigned char* src, size_t n) {
+    unsigned char* end = dst + n;
+    do {
+        std::memcpy(dst, src, 16);
+        dst += 16;
+        src += 16;
+    } while (dst < end);
+}
+
+// 由 11 位以内的编码建立单级查找表 (长度 << 8 | 符号), 规则与 HuffmanContextDecoder 相同
+void buildFlatTable(uint16_t* entries, const HuffmanCodeword* codewords, size_t count) {
+    const size_t table_size = size_t(1) << kMaxCodeLength;
+    std::fill(entries, entries + table_size, static_cast<uint16_t>(0xFFFF));
+    if (count == 1 && codewords[0].length == 0) {
+        std::fill(entries, entries + table_size, static_cast<uint16_t>(codewords[0].symbol));
+        return;
+    }
+    uint64_t kraft = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (codewords[i].length == 0 || codewords[i].length > kMaxCodeLength) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        kraft += table_size >> codewords[i].length;
+    }
+    if (kraft > table_size) {
+        throw std::runtime_error("Error: block is corrupted");
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const HuffmanCodeword& cw = codewords[i];
+        size_t first = static_cast<size_t>(cw.code) << (kMaxCodeLength - cw.length);
+        std::fill(entries + first, entries + first + (table_size >> cw.length), static_cast<uint16_t>(cw.length << 8 | cw.symbol));
+    }
+}
+
+} // namespace
+
+size_t LzMatchFinder::parse(const unsigned char* data, size_t size, int level, std::vector<LzSequence>& sequences) {
+    const LevelParams& params = kLevels[std::min(std::max(level, 1), LzCodec::kMaxLevel)];
+    if (size < static_cast<size_t>(kMinMatch) + 1) {
+        return size;
+    }
+    head_.assign(static_cast<size_t>(1) << kHashBits, -1);
+    if (chain_.size() < size) {
+        chain_.resize(size);
+    }
+    int32_t* head = head_.data();
+    int32_t* chain = chain_.data();
+    const size_t last = size - kMinMatch; // 可以开始匹配的最后位置
+    uint32_t rep = 1;
+
+    // 查找 pos 处最长的匹配并把 pos 加入哈希链, 没有不短于 kMinMatch 的匹配时返回0
+    auto find = [&](size_t pos, int max_chain, uint32_t& distance) -> size_t {
+        const size_t limit = size - pos;
+        const uint32_t head4 = load32(data + pos);
+        size_t best = 0;
+        // 先试上一个距离, 结构化数据中同一距离常常连续出现, 而且编码只需一个距离码
+        if (pos >= rep && load32(data + pos - rep) == head4) {
+            best = commonLength(data + pos, data + pos - rep, limit);
+            distance = rep;
+        }
+        const uint32_t h = (head4 * 2654435761u) >> (32 - kHashBits);
+        int32_t candidate = head[h];
+        for (int depth = 0; candidate >= 0 && depth < max_chain && best < params.nice && best < limit; ++depth) {
+            const unsigned char* c = data + candidate;
+            if (c[best] == data[pos + best] && load32(c) == head4) {
+                size_t length = commonLength(data + pos, c, limit);
+                if (length > best) {
+                    best = length;
+                    distance = static_cast<uint32_t>(pos - static_cast<size_t>(candidate));
+                }
+            }
+            candidate = chain[candidate];
+        }
+        chain[pos] = head[h];
+        head[h] = static_cast<int32_t>(pos);
+        return best >= static_cast<size_t>(kMinMatch) ? best : 0;
+    };
+
+    size_t anchor = 0; // 还没有输出的字面量的起点
+    size_t pos = 0;
+    size_t misses = 0;
+    while (pos <= last) {
+        uint32_t distance = 0;
+        size_t length = find(pos, params.chain, distance);
+        if (length == 0) {
+            ++misses;
+            pos += 1 + (misses >> params.skip_shift);
+            continue;
+        }
+        misses = 0;
+        size_t searched = pos; // find 查过 (已加入哈希链) 的最后位置
+        while (params.lazy && pos + 1 <= last && length < params.nice) {
+            uint32_t next_distance = 0;
+            size_t next_length = find(pos + 1, length >= params.good ? std::max(params.chain / 4, 1) : params.chain, next_distance);
+            searched = pos + 1;
+            if (next_length <= length) {
+                break;
+            }
+            ++pos;
+            length = next_length;
+            distance = next_distance;
+        }
+
+        sequences.push_back({static_cast<uint32_t>(pos - anchor), static_cast<uint32_t>(length), distance});
+        rep = distance;
+        const size_t end = pos + length;
+        for (size_t p = searched + 1; p < end && p <= last; ++p) {
+            uint32_t h = (load32(data + p) * 2654435761u) >> (32 - kHashBits);
+            chain[p] = head[h];
+            head[h] = static_cast<int32_t>(p);
+        }
+        pos = end;
+        anchor = end;
+    }
+    return size - anchor;
+}
+
+uint64_t LzSequenceEncoder::build(const LzSequence* sequences, size_t count) {
+    std::fill(token_counts_, token_counts_ + 256, 0);
+    std::fill(distance_counts_, distance_counts_ + 256, 0);
+    uint64_t bits = 0;
+    uint32_t rep = 1;
+    for (size_t i = 0; i < count; ++i) {
+        const LzSequence& s = sequences[i];
+        unsigned ll = LzCodec::lengthCode(s.literals);
+        unsigned ml = LzCodec::lengthCode(s.match_length - kMinMatch);
+        token_counts_[ll << 4 | ml]++;
+        unsigned dc = s.distance == rep ? 0 : LzCodec::distanceCode(s.distance);
+        distance_counts_[dc]++;
+        bits += kLengthExtraBits[ll] + kLengthExtraBits[ml] + (dc > 0 ? dc - 1 : 0);
+        rep = s.distance;
+    }
+
+    num_token_codewords_ = builder_.buildCodewords(token_counts_, kMaxCodeLength, token_codewords_);
+    num_distance_codewords_ = builder_.buildCodewords(distance_counts_, kMaxCodeLength, distance_codewords_);
+    std::fill(token_entries_, token_entries_ + 256, 0);
+    std::fill(distance_entries_, distance_entries_ + 256, 0);
+    for (size_t i = 0; i < num_token_codewords_; ++i) {
+        const HuffmanCodeword& cw = token_codewords_[i];
+        token_entries_[cw.symbol] = static_cast<uint32_t>(cw.code << 4 | cw.length);
+        bits += token_counts_[cw.symbol] * cw.length;
+    }
+    for (size_t i = 0; i < num_distance_codewords_; ++i) {
+        const HuffmanCodeword& cw = distance_codewords_[i];
+        distance_entries_[cw.symbol] = static_cast<uint32_t>(cw.code << 4 | cw.length);
+        bits += distance_counts_[cw.symbol] * cw.length;
+    }
+    return bits;
+}
+
+void LzSequenceEncoder::encode(const LzSequence* sequences, size_t count, BitWriter& writer) const {
+    // 刷新后寄存器最多剩7位, 每组最多 11 + 30 或 30 + 11 位; 编码长度为0 (只有一种符号) 时不写
+    uint32_t rep = 1;
+    for (size_t i = 0; i < count; ++i) {
+        const LzSequence& s = sequences[i];
+        unsigned ll = LzCodec::lengthCode(s.literals);
+        unsigned ml = LzCodec::lengthCode(s.match_length - kMinMatch);
+        uint32_t entry = token_entries_[ll << 4 | ml];
+        if ((entry & 0xF) != 0) {
+            writer.put(entry >> 4, entry & 0xF);
+        }
+        if (kLengthExtraBits[ll] != 0) {
+            writer.put(s.literals - kLengthBase[ll], kLengthExtraBits[ll]);
+        }
+        writer.flush();
+
+        if (kLengthExtraBits[ml] != 0) {
+            writer.put(s.match_length - kMinMatch - kLengthBase[ml], kLengthExtraBits[ml]);
+        }
+        unsigned dc = s.distance == rep ? 0 : LzCodec::distanceCode(s.distance);
+        entry = distance_entries_[dc];
+        if ((entry & 0xF) != 0) {
+            writer.put(entry >> 4, entry & 0xF);
+        }
+        writer.flush();
+
+        if (dc > 1) {
+            writer.put(s.distance - (1u << (dc - 1)), static_cast<int>(dc - 1));
+            writer.flush();
+        }
+        rep = s.distance;
+    }
+}
+
+void LzSequenceDecoder::buildTokenTable(const HuffmanCodeword* codewords, size_t count) {
+    buildFlatTable(token_entries_, codewords, count);
+}
+
+void LzSequenceDecoder::buildDistanceTable(const HuffmanCodeword* codewords, size_t count) {
+    buildFlatTable(distance_entries_, codewords, count);
+    for (size_t i = 0; i < count; ++i) {
+        if (codewords[i].symbol >= LzCodec::kNumDistanceCodes) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+    }
+}
+
+void LzSequenceDecoder::decode(BitReader& reader, size_t count, const unsigned char* literals, size_t num_literals,
+                               unsigned char* out, size_t out_size) const {
+    size_t pos = 0;
+    size_t literal_pos = 0;
+    uint32_t rep = 1;
+    for (size_t n = 0; n < count; ++n) {
+        // 每次装载后最多消费 11 + 30 或 30 + 11 位, 装载本身很便宜, 每段之前都装载, 不必判断
+        reader.refill();
+        const uint16_t token = token_entries_[reader.peek(kMaxCodeLength)];
+        if (token == kInvalid) {
+            throw std::runtime_error("Error: invalid Huffman prefix. File might be corrupted or incomplete.");
+        }
+        reader.consume(token >> 8);
+        const unsigned ll = (token & 0xFF) >> 4;
+        const unsigned ml = token & 0xF;
+        const size_t literal_count = kLengthBase[ll] + readExtra(reader, kLengthExtraBits[ll]);
+
+        if (reader.available() < 41) {
+            reader.refill();
+        }
+        const size_t match_length = kLengthBase[ml] + readExtra(reader, kLengthExtraBits[ml]) + kMinMatch;
+        const uint16_t entry = distance_entries_[reader.peek(kMaxCodeLength)];
+        if (entry == kInvalid) {
+            throw std::runtime_error("Error: invalid Huffman prefix. File might be corrupted or incomplete.");
+        }
+        reader.consume(entry >> 8);
+
+        const unsigned dc = entry & 0xFF;
+        if (reader.available() < 30) {
+            reader.refill();
+        }
+        const uint32_t extra = readExtra(reader, kDistanceCodes.extra_bits[dc]);
+        const uint32_t distance = dc == 0 ? rep : kDistanceCodes.base[dc] + extra;
+        rep = distance;
+
+        if (literal_count > num_literals - literal_pos || literal_count + match_length > out_size - pos || distance > pos + literal_count) {
+            throw std::runtime_error("Error: block is corrupted");
+        }
+        unsigned char* dst = out + pos;
+        const unsigned char* src_literals = literals + literal_pos;
+        pos += literal_count + match_length;
+        literal_pos += literal_count;
+        if (out_size - pos >= 16) {
+            // 离输出末尾足够远: 字面量整段按16字节复制 (字面量缓冲区之后留有余量), 匹配按距离选择复制宽度
+            wideCopy16(dst, src_literals, literal_count);
+            dst += literal_count;
+            const unsigned char* src = dst - distance;
+            if (distance >= 16) {
+                wideCopy16(dst, src, match_length);
+            } else if (distance >= 8) {
+                // 每次8字节, 读取的位置总在已写出的部分之内
+                for (size_t i = 0; i < match_length; i += 8) {
+                    std::memcpy(dst + i, src + i, 8);
+                }
+            } else {
+                for (size_t i = 0; i < match_length; ++i) {
+                    dst[i] = src[i];
+                }
+            }
+        } else {
+            std::memcpy(dst, src_literals, literal_count);
+            dst += literal_count;
+            const unsigned char* src = dst - distance;
+            for (size_t i = 0; i < match_length; ++i) {
+                dst[i] = src[i];
+            }
+        }
+    }
+    if (reader.overrun()) {
+        throw std::runtime_error("Error: Huffman bitstream ended early. File might be corrupted or incomplete.");
+    }
+    if (num_literals - literal_pos != out_size - pos) {
+        throw std::runtime_error("Error: block is corrupted");
+    }
+    std::memcpy(out + pos, literals + literal_pos, num_literals - literal_pos);
+}
@@ -0,0 +1,152 @@
+// 预热之后, 复用同一个压缩器/解压器对象的单线程调用不应再分配堆内存。
+// 替换全局 operator new 统计分配次数, 各种选项组合下都重复调用并检查预热之后的分配次数为0
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include "HuffmanCompressor.h"
+#include "HuffmanDecompressor.h"
+
+static std::atomic<size_t> g_allocations{0};
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+static const int kWarmupCalls = 3;
+static const int kMeasuredCalls = 20;
+
+// 频率成几何分布的文本, 不限制时最长编码远超8位
+static std::vector<unsigned char> makeSkewedData(size_t size) {
+    std::vector<unsigned char> data(size);
+    uint32_t state = 12345;
+    for (size_t i = 0; i < size; ++i) {
+        state = state * 1103515245u + 12345u;
+        uint32_t r = state >> 8;
+        int symbol = 0;
+        while ((r & 1) && symbol < 40) {
+            r >>= 1;
+            symbol++;
+        }
+        data[i] = static_cast<unsigned char>('A' + symbol);
+    }
+    return data;
+}
+
+static std::vector<unsigned char> makeTextData(size_t size) {
+    static const char* const kWords[] = {"{\"id\": ", "\"name\": \"", "value", "\", ", "true", "false", "null", "}\n", "[1, 2, 3]"};
+    std::vector<unsigned char> data;
+    data.reserve(size);
+    uint32_t state = 1;
+    while (data.size() < size) {
+        state = state * 1664525u + 1013904223u;
+        const char* word = kWords[(state >> 16) % (sizeof(kWords) / sizeof(kWords[0]))];
+        for (const char* c = word; *c != '\0' && data.size() < size; ++c) {
+            data.push_back(static_cast<unsigned char>(*c));
+        }
+    }
+    return data;
+}
+
+// 同一对象反复压缩并解压 data, 返回预热之后的分配次数; 解压结果不一致时返回 SIZE_MAX
+static size_t measure(const CompressionOptions& options, const std::vector<unsigned char>& data) {
+    HuffmanCompressor compressor(options);
+    DecompressionOptions decompression_options;
+    decompression_options.threads = 1;
+    decompression_options.quiet = true;
+    HuffmanDecompressor decompressor(decompression_options);
+    std::vector<unsigned char> compressed;
+    std::vector<unsigned char> decompressed;
+    size_t allocations = 0;
+    for (int call = 0; call < kWarmupCalls + kMeasuredCalls; ++call) {
+        size_t before = g_allocations.load(std::memory_order_relaxed);
+        compressed.clear();
+        compressor.compress(data.data(), data.size(), compressed);
+        decompressed.clear();
+        decompressor.decompress(compressed.data(), compressed.size(), decompressed);
+        if (call >= kWarmupCalls) {
+            allocations += g_allocations.load(std::memory_order_relaxed) - before;
+        }
+        if (decompressed != data) {
+            return SIZE_MAX;
+        }
+    }
+    return allocations;
+}
+
+int main() {
+    struct Case {
+        std::string name;
+        CompressionOptions options;
+        const std::vector<unsigned char>* data;
+    };
+    const std::vector<unsigned char> small = makeTextData(64);
+    const std::vector<unsigned char> text = makeTextData(300 << 10);
+    const std::vector<unsigned char> skewed = makeSkewedData(200 << 10);
+
+    CompressionOptions legacy;
+    legacy.quiet = true;
+    CompressionOptions chunked = legacy;
+    chunked.format = ContainerFormat::Chunked;
+    chunked.threads = 1;
+    CompressionOptions limited = chunked;
+    limited.max_code_length = 8;
+    CompressionOptions legacy_limited = legacy;
+    legacy_limited.max_code_length = 8;
+    CompressionOptions repeat = chunked;
+    repeat.block_size = 16 << 10; // 多块: 后续块沿用之前的编码表
+    CompressionOptions repeat_limited = repeat;
+    repeat_limited.max_code_length = 9;
+    repeat_limited.streams = 1;
+    repeat_limited.canonical_codes = false;
+    CompressionOptions repeat_ans = repeat; // tANS 块先写出, 沿用编码表更短时撤销
+    repeat_ans.ans_coding = true;
+    CompressionOptions repeat_lz = repeat;
+    repeat_lz.lz_level = 3;
+    CompressionOptions context = chunked;
+    context.context_tables = 4;
+
+    std::vector<Case> cases = {
+        {"legacy small", legacy, &small},
+        {"legacy text", legacy, &text},
+        {"legacy max_code_length", legacy_limited, &skewed},
+        {"chunked small", chunked, &small},
+        {"chunked text", chunked, &text},
+        {"chunked max_code_length", limited, &skewed},
+        {"chunked table repeat", repeat, &text},
+        {"chunked table repeat max_code_length", repeat_limited, &skewed},
+        {"chunked table repeat ans", repeat_ans, &skewed},
+        {"chunked table repeat lz", repeat_lz, &text},
+        {"chunked context", context, &text},
+    };
+    int failures = 0;
+    for (const Case& c : cases) {
+        size_t allocations = measure(c.options, *c.data);
+        if (allocations == SIZE_MAX) {
+            std::printf("FAIL %s: round trip mismatch\n", c.name.c_str());
+            failures++;
+        } else if (allocations != 0) {
+            std::printf("FAIL %s: %zu allocations in %d calls after warm-up\n", c.name.c_str(), allocations, kMeasuredCalls);
+            failures++;
+        } else {
+            std::printf("ok   %s\n", c.name.c_str());
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
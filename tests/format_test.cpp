@@ -0,0 +1,459 @@
+// 格式测试: 各种块类型与选项组合的往返、旧格式与最初实现的逐字节兼容、decompressRange 在块边界处的结果,
+// 以及截断或损坏的归档、输入输出为同一文件时必须抛出 std::runtime_error。第一个参数为 tests/data 目录
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ByteIO.h"
+#include "HuffmanCompressor.h"
+#include "HuffmanDecompressor.h"
+#include "HuffmanDictionary.h"
+#include "HuffmanFormat.h"
+
+using Bytes = std::vector<unsigned char>;
+
+static int g_failures = 0;
+
+static void fail(const std::string& message) {
+    std::printf("FAIL %s\n", message.c_str());
+    g_failures++;
+}
+
+static Bytes readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    return Bytes(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// 线性同余生成器, 测试数据与平台无关
+class Random {
+public:
+    explicit Random(uint32_t seed) : state_(seed) {}
+    uint32_t next() {
+        state_ = state_ * 1664525u + 1013904223u;
+        return state_ >> 8;
+    }
+private:
+    uint32_t state_;
+};
+
+static const size_t kSegmentSize = 12 << 10;
+
+// 各段分别适合一种块类型: 文本 (LZ), 随机 (原样), 单一字节 (游程), 极偏斜 (tANS), 1阶相关 (上下文), 一般分布 (哈夫曼)
+static Bytes makeMixedData() {
+    Bytes data;
+    Random random(7);
+    static const char* const kWords[] = {"alpha ", "beta ", "gamma ", "delta\n", "{\"key\": ", "\"value\"}, "};
+    while (data.size() < kSegmentSize) {
+        for (const char* c = kWords[random.next() % 6]; *c != '\0'; ++c) {
+            data.push_back(static_cast<unsigned char>(*c));
+        }
+    }
+    for (size_t i = 0; i < kSegmentSize; ++i) {
+        data.push_back(static_cast<unsigned char>(random.next()));
+    }
+    data.insert(data.end(), kSegmentSize, 'x');
+    for (size_t i = 0; i < kSegmentSize; ++i) {
+        data.push_back(random.next() % 100 == 0 ? static_cast<unsigned char>('b' + random.next() % 8) : 'a');
+    }
+    unsigned char previous = 0;
+    for (size_t i = 0; i < 2 * kSegmentSize; ++i) {
+        previous = random.next() % 10 == 0 ? static_cast<unsigned char>(random.next() % 16) : static_cast<unsigned char>((previous * 5 + 3) % 16);
+        data.push_back(static_cast<unsigned char>('A' + previous));
+    }
+    for (size_t i = 0; i < kSegmentSize; ++i) {
+        uint32_t r = random.next();
+        int symbol = 0;
+        while ((r & 1) && symbol < 20) {
+            r >>= 1;
+            symbol++;
+        }
+        data.push_back(static_cast<unsigned char>('0' + symbol));
+    }
+    return data;
+}
+
+// 遍历分块归档中的各块, 记录出现过的块类型与编码表类型
+static void collectBlockKinds(const Bytes& archive, std::set<int>& block_types, std::set<int>& table_kinds) {
+    MemorySource input(archive.data(), archive.size());
+    HuffmanFormat::FileHeader header = HuffmanFormat::parseFileHeader(archive.data());
+    uint64_t offset = HuffmanFormat::fileHeaderSize(header);
+    HuffmanFormat::BlockStreamReader reader(input, offset);
+    while (true) {
+        HuffmanFormat::BlockHeader block = HuffmanFormat::readBlockHeader(reader, header);
+        if (block.type == HuffmanFormat::kBlockEnd) {
+            break;
+        }
+        block_types.insert(block.type);
+        const unsigned char* payload = reader.take(static_cast<size_t>(block.payload_size));
+        if ((block.type == HuffmanFormat::kBlockHuffman || block.type == HuffmanFormat::kBlockHuffman4) && block.payload_size > 0) {
+            table_kinds.insert(payload[0]);
+        }
+    }
+}
+
+struct Variant {
+    std::string name;
+    CompressionOptions options;
+};
+
+static std::vector<Variant> makeVariants(const std::shared_ptr<const HuffmanDictionary>& dictionary) {
+    std::vector<Variant> variants;
+    CompressionOptions legacy;
+    legacy.quiet = true;
+    variants.push_back({"legacy", legacy});
+    legacy.max_code_length = 9;
+    variants.push_back({"legacy max_code_length=9", legacy});
+
+    struct Coder {
+        const char* name;
+        unsigned lz_level;
+        bool ans_coding;
+        unsigned context_tables;
+        bool dictionary;
+    };
+    static const Coder kCoders[] = {
+        {"huffman", 0, false, 0, false},
+        {"lz", 5, false, 0, false},
+        {"ans", 0, true, 0, false},
+        {"context", 0, false, 4, false},
+        {"all", 3, true, 8, false},
+        {"dictionary", 0, false, 0, true},
+    };
+    for (const Coder& coder : kCoders) {
+        for (unsigned streams : {1u, 4u}) {
+            for (bool canonical : {true, false}) {
+                for (unsigned max_code_length : {0u, 8u, 11u}) {
+                    for (int flags = 0; flags < 4; ++flags) {
+                        CompressionOptions options;
+                        options.quiet = true;
+                        options.format = ContainerFormat::Chunked;
+                        options.block_size = 4096;
+                        options.streams = streams;
+                        options.canonical_codes = canonical;
+                        options.max_code_length = max_code_length;
+                        options.block_index = (flags & 1) != 0;
+                        options.block_checksums = (flags & 2) != 0;
+                        options.threads = (flags & 1) ? 4 : 1;
+                        options.lz_level = coder.lz_level;
+                        options.ans_coding = coder.ans_coding;
+                        options.context_tables = coder.context_tables;
+                        if (coder.dictionary) {
+                            options.dictionary = dictionary;
+                        }
+                        variants.push_back({std::string(coder.name) + " streams=" + std::to_string(streams) +
+                                                (canonical ? " canonical" : " explicit") + " max_code_length=" + std::to_string(max_code_length) +
+                                                (options.block_index ? " index" : "") + (options.block_checksums ? " checksums" : "") +
+                                                " threads=" + std::to_string(options.threads),
+                                            options});
+                    }
+                }
+            }
+        }
+    }
+    return variants;
+}
+
+// 各选项组合下压缩后以多种方式解压, 结果都应与原始数据相同; 同时统计分块归档中出现的块类型
+static void testRoundTrips(const Bytes& mixed) {
+    Bytes dictionary_sample(mixed.begin(), mixed.begin() + kSegmentSize);
+    std::string_view sample(reinterpret_cast<const char*>(dictionary_sample.data()), dictionary_sample.size());
+    auto dictionary = std::make_shared<const HuffmanDictionary>(HuffmanDictionary::train({sample}));
+    DecompressionOptions decompression_options;
+    decompression_options.quiet = true;
+    decompression_options.dictionaries.push_back(dictionary);
+    HuffmanDecompressor decompressor(decompression_options);
+
+    const std::vector<Bytes> inputs = {
+        Bytes(), Bytes(1, 'q'), Bytes(5000, 0), Bytes(mixed.begin(), mixed.begin() + 3000), mixed,
+    };
+    std::set<int> block_types;
+    std::set<int> table_kinds;
+    size_t round_trips = 0;
+    for (const Variant& variant : makeVariants(dictionary)) {
+        HuffmanCompressor compressor(variant.options);
+        for (const Bytes& input : inputs) {
+            const std::string name = variant.name + " size=" + std::to_string(input.size());
+            try {
+                Bytes archive;
+                compressor.compress(input.data(), input.size(), archive);
+                if (archive.size() > HuffmanCompressor::compressBound(input.size(), variant.options)) {
+                    fail(name + ": archive exceeds compressBound");
+                }
+                Bytes output;
+                decompressor.decompress(archive.data(), archive.size(), output);
+                if (output != input) {
+                    fail(name + ": round trip mismatch");
+                    continue;
+                }
+                if (!input.empty() && decompressor.verify(archive.data(), archive.size()) != input.size()) {
+                    fail(name + ": verify returned a wrong length");
+                }
+                Bytes direct(input.size() + 1);
+                if (!input.empty() && (decompressor.decompress(archive.data(), archive.size(), direct.data(), direct.size()) != input.size() ||
+                                       !std::equal(input.begin(), input.end(), direct.begin()))) {
+                    fail(name + ": decompress into a buffer mismatch");
+                }
+                if (variant.options.format == ContainerFormat::Chunked && !input.empty()) {
+                    collectBlockKinds(archive, block_types, table_kinds);
+                }
+                round_trips++;
+            } catch (const std::exception& e) {
+                fail(name + ": " + e.what());
+            }
+        }
+    }
+
+    static const std::pair<int, const char*> kBlockTypes[] = {
+        {HuffmanFormat::kBlockHuffman, "huffman"}, {HuffmanFormat::kBlockHuffman4, "huffman4"}, {HuffmanFormat::kBlockRaw, "raw"},
+        {HuffmanFormat::kBlockRle, "rle"}, {HuffmanFormat::kBlockContext, "context"}, {HuffmanFormat::kBlockLz, "lz"},
+        {HuffmanFormat::kBlockAns, "ans"},
+    };
+    for (const auto& type : kBlockTypes) {
+        if (block_types.count(type.first) == 0) {
+            fail(std::string("no round trip produced a ") + type.second + " block");
+        }
+    }
+    static const std::pair<int, const char*> kTableKinds[] = {
+        {HuffmanFormat::kTableExplicit, "explicit"}, {HuffmanFormat::kTableCanonical, "canonical"},
+        {HuffmanFormat::kTableDictionary, "dictionary"}, {HuffmanFormat::kTableRepeat, "repeat"},
+    };
+    for (const auto& kind : kTableKinds) {
+        if (table_kinds.count(kind.first) == 0) {
+            fail(std::string("no round trip produced a ") + kind.second + " code table");
+        }
+    }
+    std::printf("ok   %zu round trips\n", round_trips);
+}
+
+// 流式接口总是写出分块格式, 同样能够解压
+static void testStreams(const Bytes& mixed) {
+    CompressionOptions options;
+    options.quiet = true;
+    options.block_size = 4096;
+    HuffmanCompressor compressor(options);
+    std::istringstream in(std::string(mixed.begin(), mixed.end()));
+    std::ostringstream compressed;
+    compressor.compress(in, compressed);
+
+    DecompressionOptions decompression_options;
+    decompression_options.quiet = true;
+    HuffmanDecompressor decompressor(decompression_options);
+    std::istringstream archive(compressed.str());
+    std::ostringstream out;
+    decompressor.decompress(archive, out);
+    std::string result = out.str();
+    if (Bytes(result.begin(), result.end()) != mixed) {
+        fail("stream round trip mismatch");
+        return;
+    }
+    std::printf("ok   stream round trip\n");
+}
+
+// 旧格式的输出与最初的实现逐字节相同, 最初的实现写出的归档也能解压
+static void testLegacyCompatibility(const std::string& data_dir) {
+    static const char* const kFiles[] = {"text.txt", "fib.bin", "random.bin", "equal.bin", "single.bin", "tiny.txt"};
+    CompressionOptions options;
+    options.quiet = true;
+    HuffmanCompressor compressor(options);
+    DecompressionOptions decompression_options;
+    decompression_options.quiet = true;
+    HuffmanDecompressor decompressor(decompression_options);
+    for (const char* file : kFiles) {
+        const std::string path = data_dir + "/legacy/" + file;
+        Bytes input = readFile(path);
+        Bytes expected = readFile(path + ".torosamy");
+        Bytes archive;
+        compressor.compress(input.data(), input.size(), archive);
+        if (archive != expected) {
+            fail(std::string("legacy archive of ") + file + " differs from the baseline");
+        }
+        Bytes output;
+        decompressor.decompress(expected.data(), expected.size(), output);
+        if (output != input) {
+            fail(std::string("baseline archive of ") + file + " does not decompress to the input");
+        }
+    }
+    std::printf("ok   legacy compatibility\n");
+}
+
+// 范围的起点与终点落在块边界前后时, 结果都应等于原始数据的对应片段
+static void testDecompressRange(const Bytes& mixed) {
+    const size_t kBlockSize = 4096;
+    DecompressionOptions decompression_options;
+    decompression_options.quiet = true;
+    decompression_options.threads = 2;
+    HuffmanDecompressor decompressor(decompression_options);
+    for (bool block_index : {true, false}) {
+        CompressionOptions options;
+        options.quiet = true;
+        options.format = ContainerFormat::Chunked;
+        options.block_size = kBlockSize;
+        options.block_index = block_index;
+        HuffmanCompressor compressor(options);
+        Bytes archive;
+        compressor.compress(mixed.data(), mixed.size(), archive);
+
+        std::vector<std::pair<uint64_t, uint64_t>> ranges = {
+            {0, mixed.size()}, {0, UINT64_MAX}, {mixed.size() - 1, 10}, {mixed.size(), 5}, {mixed.size() + 100, 5}, {100, 0},
+        };
+        for (size_t boundary = kBlockSize; boundary < mixed.size(); boundary += kBlockSize) {
+            ranges.push_back({boundary - 1, 2});
+            ranges.push_back({boundary, 1});
+            ranges.push_back({boundary - 1, 1});
+            ranges.push_back({boundary, kBlockSize});
+            ranges.push_back({boundary - kBlockSize, kBlockSize});
+            ranges.push_back({boundary - 10, 3 * kBlockSize});
+        }
+        for (const auto& range : ranges) {
+            const uint64_t begin = std::min<uint64_t>(range.first, mixed.size());
+            const uint64_t end = std::min<uint64_t>(mixed.size(), range.first + std::min(range.second, UINT64_MAX - range.first));
+            Bytes expected(mixed.begin() + begin, mixed.begin() + std::max(begin, end));
+            Bytes output;
+            const std::string name = std::string(block_index ? "indexed" : "unindexed") + " range [" + std::to_string(range.first) +
+                                     ", +" + std::to_string(range.second) + ")";
+            try {
+                size_t written = decompressor.decompressRange(archive.data(), archive.size(), range.first, range.second, output);
+                if (written != expected.size() || output != expected) {
+                    fail(name + ": wrong data");
+                }
+            } catch (const std::exception& e) {
+                fail(name + ": " + e.what());
+            }
+        }
+    }
+    std::printf("ok   decompressRange\n");
+}
+
+// 截断在任何位置的归档, 校验都应抛出; 截断在块数据中的分块归档, 解压也应抛出。
+// 带校验和的分块归档中任何一个字节被改动, 校验都应抛出, 解压要么抛出要么仍得到原始数据
+static void testCorruptedInputs(const Bytes& mixed) {
+    DecompressionOptions decompression_options;
+    decompression_options.quiet = true;
+    HuffmanDecompressor decompressor(decompression_options);
+    auto throws = [](const auto& call) {
+        try {
+            call();
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    const Bytes input(mixed.begin(), mixed.begin() + 20000);
+
+    for (int format = 0; format < 3; ++format) {
+        CompressionOptions options;
+        options.quiet = true;
+        options.format = format == 0 ? ContainerFormat::Legacy : ContainerFormat::Chunked;
+        options.block_size = 4096;
+        options.block_checksums = format == 2;
+        HuffmanCompressor compressor(options);
+        Bytes archive;
+        compressor.compress(input.data(), input.size(), archive);
+        const std::string name = format == 0 ? "legacy" : format == 1 ? "chunked" : "chunked with checksums";
+
+        // 分块归档的结束块位于块索引之前, 截断在它之前的归档缺少块数据
+        size_t end_block = archive.size();
+        if (format != 0) {
+            HuffmanFormat::Footer footer = HuffmanFormat::parseFooter(archive.data() + archive.size() - HuffmanFormat::kFooterSize);
+            end_block = static_cast<size_t>(footer.index_offset) - 1;
+        }
+        // 空输入的压缩结果为空, 0字节不算截断
+        const size_t step = std::max<size_t>(1, archive.size() / 300);
+        for (size_t size = 1; size < archive.size(); size += step) {
+            if (!throws([&] { decompressor.verify(archive.data(), size); })) {
+                fail(name + " truncated to " + std::to_string(size) + " bytes: verify did not throw");
+            }
+            Bytes output;
+            if (format != 0 && size <= end_block && !throws([&] { decompressor.decompress(archive.data(), size, output); })) {
+                fail(name + " truncated to " + std::to_string(size) + " bytes: decompress did not throw");
+            }
+        }
+
+        if (format != 2) {
+            continue;
+        }
+        for (size_t pos = 0; pos < archive.size(); pos += step) {
+            Bytes corrupted = archive;
+            corrupted[pos] ^= 0x5A;
+            if (!throws([&] { decompressor.verify(corrupted.data(), corrupted.size()); })) {
+                fail(name + " with byte " + std::to_string(pos) + " corrupted: verify did not throw");
+            }
+            Bytes output;
+            if (!throws([&] { decompressor.decompress(corrupted.data(), corrupted.size(), output); }) && output != input) {
+                fail(name + " with byte " + std::to_string(pos) + " corrupted: decompress returned wrong data");
+            }
+        }
+    }
+    std::printf("ok   corrupted inputs\n");
+}
+
+// 输出路径指向输入文件时必须抛出异常, 而不是截断仍在映射中的输入
+static void testSameFile(const Bytes& mixed) {
+    const std::string path = "format_test_same_file.tmp";
+    const Bytes input(mixed.begin(), mixed.begin() + 20000);
+    CompressionOptions options;
+    options.quiet = true;
+    HuffmanCompressor compressor(options);
+    Bytes archive;
+    compressor.compress(input.data(), input.size(), archive);
+    DecompressionOptions decompression_options;
+    decompression_options.quiet = true;
+    HuffmanDecompressor decompressor(decompression_options);
+
+    for (int direction = 0; direction < 2; ++direction) {
+        const Bytes& content = direction == 0 ? input : archive;
+        const std::string name = direction == 0 ? "compress" : "decompress";
+        {
+            std::ofstream out(path, std::ios::binary);
+            out.write(reinterpret_cast<const char*>(content.data()), static_cast<std::streamsize>(content.size()));
+        }
+        bool threw = false;
+        try {
+            if (direction == 0) {
+                compressor.compress(path, path);
+            } else {
+                decompressor.decompress(path, path);
+            }
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        if (!threw) {
+            fail(name + " onto its own input did not throw");
+        }
+        if (readFile(path) != content) {
+            fail(name + " onto its own input modified the input");
+        }
+    }
+    std::remove(path.c_str());
+    std::printf("ok   same input and output file\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::fprintf(stderr, "usage: format_test <tests/data directory>\n");
+        return 2;
+    }
+    const Bytes mixed = makeMixedData();
+    try {
+        testRoundTrips(mixed);
+        testStreams(mixed);
+        testLegacyCompatibility(argv[1]);
+        testDecompressRange(mixed);
+        testCorruptedInputs(mixed);
+        testSameFile(mixed);
+    } catch (const std::exception& e) {
+        fail(std::string("unexpected exception: ") + e.what());
+    }
+    return g_failures == 0 ? 0 : 1;
+}